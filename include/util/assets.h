@@ -10,7 +10,24 @@
 #include <vector>
 #include <optional>
 #include <any>
+#include <algorithm>
+#include <cctype>
+#include <future>
+#include <list>
+#include <memory>
+#include <iomanip>
+#include <unordered_map>
+#include <cstring>
 #include <chrono> // for timing
+#include <functional>
+#include <map>
+#include <thread>
+
+#include <util/threadpool.h>
+#include <util/hdrimage.h>
+#include <util/registry.h>
+#include <util/texcompress.h>
+#include <util/texturecache.h>
 
 #include <util/model.h>
 
@@ -19,19 +36,40 @@ bool powerOf2(int n)
     return (n & (n - 1)) == 0; // see http://www.graphics.stanford.edu/~seander/bithacks.html or https://stackoverflow.com/questions/108318/whats-the-simplest-way-to-test-whether-a-number-is-a-power-of-2-in-c
 }
 
-// utility function for loading a 2D texture from file
+// CPU side of a texture: the decoded pixels of an image file (owned until uploaded or freed)
+struct DecodedImage
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int nrComponents = 0;
+    unsigned char *data = nullptr;
+};
+
+// utility function for decoding an image file on the CPU. Does not use OpenGL, so it is safe to call from worker threads.
+// The flip setting is applied per call (stb keeps it thread local) instead of through the global stb state, and
+// reset afterwards so later loads on the same (worker) thread do not inherit it.
 // ---------------------------------------------------
-unsigned int loadTexture(const char *path)
+DecodedImage decodeImage(const char *path, bool flipVertically)
+{
+    DecodedImage image;
+    image.path = path;
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    image.data = stbi_load(path, &image.width, &image.height, &image.nrComponents, 0);
+    stbi_set_flip_vertically_on_load_thread(false);
+    return image;
+}
+
+// utility function for uploading a decoded image into a new 2D texture (render thread only). Frees the pixel data.
+// ---------------------------------------------------
+unsigned int uploadTexture(DecodedImage &image)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    // stbi_set_flip_vertically_on_load(flipVertically);
-
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    const char *path = image.path.c_str();
+    int width = image.width, height = image.height, nrComponents = image.nrComponents;
+    unsigned char *data = image.data;
     if (data)
     {
         try
@@ -53,7 +91,7 @@ unsigned int loadTexture(const char *path)
             else
                 throw "Number of Channels not supported!";
 
-            glBindTexture(GL_TEXTURE_2D, textureID);
+            glState().BindTexture(GL_TEXTURE_2D, textureID);
             glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
             glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -76,23 +114,92 @@ unsigned int loadTexture(const char *path)
         std::cout << "Failed to load texture at path: " << path << std::endl;
         stbi_image_free(data);
     }
+    image.data = nullptr;
 
     return textureID;
 }
 
+// utility function for uploading a decoded .hdr image into a new GL_RGB16F texture (render thread only). No mipmaps,
+// environment maps are sampled at a single level (e.g., when they are projected onto a cube map).
+// ---------------------------------------------------
+unsigned int uploadHdrTexture(const HdrImage &image)
+{
+    if (!image.isValid())
+    {
+        std::cout << "Failed to load HDR texture at path: " << image.path << std::endl;
+        return 0;
+    }
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glState().BindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2); // rows of 6 byte pixels are not always a multiple of 4 bytes
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, image.width, image.height, 0, GL_RGB, GL_HALF_FLOAT, image.pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// utility function for loading a Radiance .hdr environment as a half float texture (see hdrimage.h), shared
+// through the global texture cache like loadTexture
+// ---------------------------------------------------
+unsigned int loadHdrTexture(const char *path, bool flipVertically = true)
+{
+    return textureCache().Acquire(path, textureVariant(flipVertically, TexUsage::Color, GL_CLAMP_TO_EDGE) | TEX_VARIANT_HDR, [&]
+                                  { return uploadHdrTexture(decodeHdrImage(path, flipVertically)); });
+}
+
+// utility function for loading a 2D texture from file. With textureCompressionEnabled the block compressed mip chain
+// is used (encoded and cached on the first load, see texcompress.h), the usage decides the block format.
+// Goes through the global texture cache: files with the same content share one texture, the caller holds a
+// reference (textureCache().Release). .hdr files become half float textures (loadHdrTexture).
+// ---------------------------------------------------
+unsigned int loadTexture(const char *path, bool flipVertically, TexUsage usage = TexUsage::Color)
+{
+    if (isHdrFile(path))
+        return loadHdrTexture(path, flipVertically);
+    return textureCache().Acquire(path, textureVariant(flipVertically, usage, GL_MIRRORED_REPEAT), [&]
+                                  {
+        if (textureCompressionEnabled)
+        {
+            CompressedTexture texture = loadCompressedTexture(path, flipVertically, usage);
+            if (unsigned int textureID = uploadCompressedTexture(texture, GL_MIRRORED_REPEAT))
+                return textureID;
+        }
+        DecodedImage image = decodeImage(path, flipVertically);
+        return uploadTexture(image); });
+}
+
+unsigned int loadTexture(const char *path)
+{
+    return loadTexture(path, false);
+}
+
+// checks the file extension for image formats that are loaded as textures
+// ---------------------------------------------------
+bool isImageFile(const std::string &path)
+{
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c)
+                   { return (char)std::tolower(c); });
+    return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "tga" || ext == "bmp" || ext == "psd" || ext == "gif";
+}
+
 typedef std::map<const std::string, std::string> CubeMapPaths;
 // utility function for loading a cube map texture from file
 // ---------------------------------------------------
-unsigned int loadCubemap(CubeMapPaths cubemap)
+unsigned int loadCubemap(CubeMapPaths cubemap, bool flipVertically = false)
 {
 
     unsigned int cubeTextureID;
     glGenTextures(1, &cubeTextureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTextureID);
+    glState().BindTexture(GL_TEXTURE_CUBE_MAP, cubeTextureID);
 
     std::string faces[6] = {"right", "left", "top", "bottom", "front", "back"};
 
-    // stbi_set_flip_vertically_on_load(true);
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
 
     int width, height, nrComponents;
     for (unsigned int i = 0; i < 6; i++)
@@ -110,6 +217,7 @@ unsigned int loadCubemap(CubeMapPaths cubemap)
             std::cout << "Cubemap texture failed to load for: " << faces[i] << std::endl;
         }
     }
+    stbi_set_flip_vertically_on_load_thread(false);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -128,11 +236,26 @@ typedef std::map<const std::string, std::any> AssetItemMap;
 typedef std::pair<const std::string, AssetItemMap> AssetGroup;
 typedef std::map<const std::string, AssetItemMap> Assets;
 
+// the usage of a texture from its name in an asset group: normal maps and the single channel material maps are
+// compressed differently from color textures (see TexUsage)
+// ---------------------------------------------------
+TexUsage textureUsageForName(const std::string &name)
+{
+    if (name == "normal")
+        return TexUsage::Normal;
+    if (name == "metallness" || name == "metallic" || name == "roughness" || name == "ao")
+        return TexUsage::Mask;
+    return TexUsage::Color;
+}
+
 // if textures should be flipped upside down use { TEX_FLIP, true }
 const std::string TEX_FLIP = "setting-flip-texture";
-
-// a std::map (global variable) that stores all the assets that need to be loaded (i.e., textures and models). Also makes sure that assets are only loaded once!
-std::map<const std::string, std::any> loadedAssets;
+// if the meshes of the group's models should be optimized at load time use { MESH_OPTIMIZE, true } (see meshopt.h)
+const std::string MESH_OPTIMIZE = "setting-optimize-mesh";
+// if levels of detail should be generated for the group's models use { MESH_LODS, true } (see meshsimplify.h)
+const std::string MESH_LODS = "setting-mesh-lods";
+// if .obj models of the group should be read by the parallel OBJ parser instead of Assimp use { MESH_FAST_OBJ, true } (see objparser.h)
+const std::string MESH_FAST_OBJ = "setting-fast-obj";
 
 // Helper class for textures
 class Tex
@@ -144,22 +267,502 @@ public:
     operator unsigned int() { return m_id; } // cast operator
 };
 
+// handles to loaded assets. Resolving them (AssetManager::Get) is an array access, no string lookup.
+typedef Handle<Tex> TexHandle;
+typedef Handle<Model> ModelHandle;
+
+// registries (global variables) that store all loaded textures and models exactly once, keyed by their file path.
+// Also makes sure that assets are only loaded once!
+AssetRegistry<Tex> loadedTextures;
+AssetRegistry<Model> loadedModels;
+
+// the registry key of a texture, the same image flipped or compressed for another usage is a different texture
+// ---------------------------------------------------
+std::string textureKey(const std::string &path, bool flipVertically, TexUsage usage = TexUsage::Color)
+{
+    std::string key = flipVertically ? path + "#flipped" : path;
+    if (usage == TexUsage::Normal)
+        key += "#normal";
+    else if (usage == TexUsage::Mask)
+        key += "#mask";
+    return key;
+}
+
+// the registry key of a model, differently processed meshes (MESH_PROCESS_* flags) are a different model
+// ---------------------------------------------------
+std::string modelKey(const std::string &path, uint32_t processing)
+{
+    return processing ? path + "#" + std::to_string(processing) : path;
+}
+
+// CPU side of a streamed texture, prepared on a worker thread (see AssetStreamer)
+struct StreamedImage
+{
+    uint64_t hash = 0;            // of the file content, the key of the texture cache
+    CompressedTexture compressed; // with textureCompressionEnabled: from the texture's cache file, or encoded
+    DecodedImage decoded;         // otherwise
+};
+
+// utility function for preparing a streamed texture: hashes the file and block compresses (or decodes) it like
+// loadTexture does. Does not use OpenGL, so it is safe to call from worker threads.
+// ---------------------------------------------------
+StreamedImage prepareStreamedImage(const std::string &path, bool flipVertically, TexUsage usage)
+{
+    StreamedImage image;
+    image.hash = hashFile(path);
+    if (textureCompressionEnabled)
+        image.compressed = loadCompressedTexture(path, flipVertically, usage);
+    if (!image.compressed.isValid())
+        image.decoded = decodeImage(path.c_str(), flipVertically);
+    return image;
+}
+
+// Loads textures and models in the background: decoding/importing runs on the worker pool, the uploads to
+// OpenGL are spread over several frames (call Update once per frame) so that no frame exceeds the byte budget.
+// Uncompressed texture data is copied into pixel buffer objects and transferred with glTexSubImage2D from there.
+// Textures end up in the global texture cache like the ones of loadTexture: content that is on the GPU already is
+// shared instead of uploaded again, and the registry entry holds one reference.
+// Requested assets are registered right away and resolve to a placeholder (1x1 texture, empty model) until
+// the real data is resident on the GPU.
+class AssetStreamer
+{
+public:
+    size_t frameBudget = 4 * 1024 * 1024; // bytes uploaded per Update()
+
+    ~AssetStreamer()
+    {
+        // wait for running jobs, they write into the job structs
+        for (auto &job : m_textureJobs)
+            if (job.preparing.valid())
+                job.preparing.wait();
+        for (auto &job : m_modelJobs)
+            if (job.loading.valid())
+                job.loading.wait();
+    }
+
+    // requests a 2D texture, returns immediately. placeholderColor (RGBA) is shown until the texture is resident.
+    // The usage decides the block format (see TexUsage), as for loadTexture.
+    TexHandle RequestTexture(const std::string &path, bool flipVertically, TexUsage usage = TexUsage::Color, uint32_t placeholderColor = 0xff808080)
+    {
+        TexHandle handle = loadedTextures.Find(textureKey(path, flipVertically, usage));
+        if (handle.isValid()) // loaded or requested before
+            return handle;
+
+        handle = loadedTextures.Add(textureKey(path, flipVertically, usage), Tex(placeholder(placeholderColor)));
+        m_textureJobs.emplace_back();
+        TextureJob &job = m_textureJobs.back();
+        job.handle = handle;
+        job.path = path;
+        job.flip = flipVertically;
+        job.variant = textureVariant(flipVertically, usage, GL_MIRRORED_REPEAT); // the same as loadTexture, so both share
+        job.preparing = workerPool().submit([path, flipVertically, usage]
+                                            { return prepareStreamedImage(path, flipVertically, usage); });
+        return handle;
+    }
+
+    // requests a model, returns immediately. The model is empty until all of its meshes are uploaded.
+    ModelHandle RequestModel(const std::string &path, uint32_t processing = 0)
+    {
+        ModelHandle handle = loadedModels.Find(modelKey(path, processing));
+        if (handle.isValid()) // loaded or requested before
+            return handle;
+
+        handle = loadedModels.Add(modelKey(path, processing), Model());
+        m_modelJobs.emplace_back();
+        ModelJob &job = m_modelJobs.back();
+        job.handle = handle;
+        job.loading = workerPool().submit([path, processing]
+                                          { return std::make_unique<Model>(path, false, false, true, processing); });
+        return handle;
+    }
+
+    bool IsResident(TexHandle handle) const
+    {
+        for (auto &job : m_textureJobs)
+            if (job.handle == handle)
+                return false;
+        return loadedTextures.IsValid(handle);
+    }
+
+    bool IsResident(ModelHandle handle) const
+    {
+        for (auto &job : m_modelJobs)
+            if (job.handle == handle)
+                return false;
+        return loadedModels.IsValid(handle);
+    }
+
+    // number of requests that are not resident yet
+    size_t Pending() const { return m_textureJobs.size() + m_modelJobs.size(); }
+
+    // advances all requests: picks up finished CPU work and uploads at most frameBudget bytes (render thread only)
+    void Update()
+    {
+        size_t budget = frameBudget;
+
+        for (auto job = m_modelJobs.begin(); job != m_modelJobs.end();)
+        {
+            if (job->state == Loading && job->loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                job->pending = job->loading.get();
+                job->state = Uploading;
+            }
+            if (job->state == Uploading && budget > 0)
+            {
+                for (auto &mesh : job->pending->meshes)
+                {
+                    if (!mesh.IsUploaded())
+                        budget -= mesh.UploadStep(budget);
+                    if (budget == 0)
+                        break;
+                }
+                if (job->pending->IsUploaded())
+                {
+                    if (Model *model = loadedModels.TryGet(job->handle))
+                        *model = std::move(*job->pending); // swap in the real model
+                    job = m_modelJobs.erase(job);
+                    continue;
+                }
+            }
+            ++job;
+        }
+
+        for (auto job = m_textureJobs.begin(); job != m_textureJobs.end();)
+        {
+            if (job->state == Loading && job->preparing.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                job->image = job->preparing.get();
+                // the same content may be on the GPU already (another path, or another loader): share it
+                unsigned int existing = textureCache().Acquire(job->path, job->variant, []
+                                                               { return 0u; }, job->image.hash);
+                if (existing != 0)
+                {
+                    finishTexture(*job, existing);
+                    job = m_textureJobs.erase(job);
+                    continue;
+                }
+                if (!job->image.compressed.isValid() && !beginTextureUpload(*job))
+                {
+                    job = m_textureJobs.erase(job); // keeps the placeholder
+                    continue;
+                }
+                job->state = Uploading;
+            }
+            if (job->state == Uploading && budget > 0)
+            {
+                if (job->image.compressed.isValid())
+                {
+                    // the whole mip chain at once, block compressed it is a fraction of the pixel data
+                    job->texture = uploadCompressedTexture(job->image.compressed, GL_MIRRORED_REPEAT);
+                    budget -= std::min(job->image.compressed.ByteSize(), budget);
+                    job->image.compressed = CompressedTexture();
+                    if (job->texture == 0) // format not supported by the driver, stream the pixels instead
+                    {
+                        job->image.decoded = decodeImage(job->path.c_str(), job->flip);
+                        if (!beginTextureUpload(*job))
+                            job = m_textureJobs.erase(job);
+                        else
+                            ++job;
+                        continue;
+                    }
+                }
+                else
+                {
+                    budget -= textureUploadStep(*job, budget);
+                    if (job->rowsUploaded < job->image.decoded.height)
+                    {
+                        ++job;
+                        continue;
+                    }
+                    glState().BindTexture(GL_TEXTURE_2D, job->texture);
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                }
+                finishTexture(*job, textureCache().Acquire(job->path, job->variant, [&]
+                                                           { return job->texture; }, job->image.hash));
+                job = m_textureJobs.erase(job);
+                continue;
+            }
+            ++job;
+        }
+    }
+
+    // true for the textures that stand in for requested ones (they are owned by the streamer)
+    bool IsPlaceholder(unsigned int textureID) const
+    {
+        for (auto &placeholder : m_placeholders)
+            if (placeholder.second == textureID)
+                return true;
+        return false;
+    }
+
+    // deletes the OpenGL objects of the streamer: placeholders, pixel buffers and textures that are still uploading.
+    // Call before the context is destroyed, the streamer usually outlives it (e.g., in a global AssetManager).
+    void ReleaseGpuResources()
+    {
+        for (auto &job : m_textureJobs)
+            deleteTexture(job.texture);
+        for (auto &placeholder : m_placeholders)
+            deleteTexture(placeholder.second);
+        m_placeholders.clear();
+        if (m_pbos[0] != 0)
+            glDeleteBuffers(PBO_COUNT, m_pbos);
+        std::fill(m_pbos, m_pbos + PBO_COUNT, 0u);
+        m_pboSize = 0;
+    }
+
+private:
+    enum JobState
+    {
+        Loading,  // decoding/importing on a worker thread
+        Uploading // CPU data ready, uploads in progress
+    };
+
+    struct TextureJob
+    {
+        TexHandle handle;
+        std::string path;
+        bool flip = false;
+        uint32_t variant = 0; // texture cache variant (see textureVariant)
+        JobState state = Loading;
+        unsigned int texture = 0; // the real texture while it is uploading
+        std::future<StreamedImage> preparing;
+        StreamedImage image;
+        GLenum format = GL_RGB;
+        int rowsUploaded = 0;
+    };
+
+    struct ModelJob
+    {
+        ModelHandle handle;
+        JobState state = Loading;
+        std::future<std::unique_ptr<Model>> loading;
+        std::unique_ptr<Model> pending;
+    };
+
+    std::list<TextureJob> m_textureJobs;
+    std::list<ModelJob> m_modelJobs;
+    std::map<uint32_t, unsigned int> m_placeholders;
+
+    static const int PBO_COUNT = 3;
+    unsigned int m_pbos[PBO_COUNT] = {};
+    size_t m_pboSize = 0;
+    int m_nextPbo = 0;
+
+    unsigned int placeholder(uint32_t color)
+    {
+        auto found = m_placeholders.find(color);
+        if (found != m_placeholders.end())
+            return found->second;
+
+        unsigned int id;
+        glGenTextures(1, &id);
+        glState().BindTexture(GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &color);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        m_placeholders[color] = id;
+        return id;
+    }
+
+    static void deleteTexture(unsigned int &textureID)
+    {
+        if (textureID == 0)
+            return;
+        glState().ForgetTexture(textureID);
+        glDeleteTextures(1, &textureID);
+        textureID = 0;
+    }
+
+    // swaps the texture (holding one texture cache reference) in for the placeholder and frees the CPU data.
+    // The texture uploaded by the job is deleted if the cache returned another one with the same content.
+    void finishTexture(TextureJob &job, unsigned int textureID)
+    {
+        if (job.texture != textureID)
+            deleteTexture(job.texture);
+        if (job.image.decoded.data)
+            stbi_image_free(job.image.decoded.data);
+        job.image.decoded.data = nullptr;
+        if (Tex *tex = loadedTextures.TryGet(job.handle))
+            *tex = Tex(textureID);
+        else
+            textureCache().Release(textureID);
+    }
+
+    // validates the decoded image (same rules as uploadTexture) and allocates the texture storage
+    bool beginTextureUpload(TextureJob &slot)
+    {
+        DecodedImage &image = slot.image.decoded;
+        const char *error = nullptr;
+        if (!image.data)
+            error = "could not decode the file";
+        else if (image.width <= 0 || image.height <= 0)
+            error = "Texture is 0 in at least one dimension!";
+        else if (!powerOf2(image.width) || !powerOf2(image.height))
+            error = "Texture is not power of 2!";
+        else if (image.nrComponents < 1 || image.nrComponents > 4 || image.nrComponents == 2)
+            error = "Number of Channels not supported!";
+        if (error)
+        {
+            std::cout << "Failed to stream texture " << image.path << " because: " << error << std::endl;
+            stbi_image_free(image.data);
+            image.data = nullptr;
+            return false;
+        }
+
+        slot.format = image.nrComponents == 1 ? GL_RED : (image.nrComponents == 3 ? GL_RGB : GL_RGBA);
+        glGenTextures(1, &slot.texture);
+        glState().BindTexture(GL_TEXTURE_2D, slot.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, slot.format, image.width, image.height, 0, slot.format, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        slot.rowsUploaded = 0;
+        return true;
+    }
+
+    // copies as many rows as the budget allows into the next PBO and transfers them into the texture
+    size_t textureUploadStep(TextureJob &slot, size_t budget)
+    {
+        DecodedImage &image = slot.image.decoded;
+        size_t rowBytes = (size_t)image.width * image.nrComponents;
+        int rows = (int)std::min<size_t>(std::max<size_t>(1, budget / rowBytes), image.height - slot.rowsUploaded);
+        size_t bytes = rows * rowBytes;
+
+        if (m_pbos[0] == 0 || bytes > m_pboSize)
+        {
+            if (m_pbos[0] != 0)
+                glDeleteBuffers(PBO_COUNT, m_pbos);
+            m_pboSize = std::max(bytes, frameBudget);
+            glGenBuffers(PBO_COUNT, m_pbos);
+            for (int i = 0; i < PBO_COUNT; i++)
+            {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbos[i]);
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, m_pboSize, nullptr, GL_STREAM_DRAW);
+            }
+        }
+
+        // rotate through the PBOs, so we do not wait for the transfer of the previous frame
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbos[m_nextPbo]);
+        m_nextPbo = (m_nextPbo + 1) % PBO_COUNT;
+        void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (dst)
+        {
+            std::memcpy(dst, image.data + slot.rowsUploaded * rowBytes, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glState().BindTexture(GL_TEXTURE_2D, slot.texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, slot.rowsUploaded, image.width, rows, slot.format, GL_UNSIGNED_BYTE, (void *)0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            slot.rowsUploaded += rows;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return std::min(bytes, budget);
+    }
+};
+
+// the handles of a preloaded group (see AssetManager::Preload), resolved once
+struct ResidentGroup
+{
+    ModelHandle model;                         // invalid if the group has no model
+    std::map<std::string, TexHandle> textures; // 2D textures by asset name
+
+    TexHandle Texture(const std::string &name) const
+    {
+        auto found = textures.find(name);
+        return found != textures.end() ? found->second : TexHandle();
+    }
+};
+
+// passed to the progress callback of AssetManager::Preload after each finished asset
+struct PreloadProgress
+{
+    size_t done = 0;
+    size_t total = 0;
+    std::string asset; // path (texture) or registry key (model) of the asset that just finished
+};
+
 class AssetManager
 {
 private:
     Assets m_assets;
     std::string m_active;
+    AssetStreamer m_streamer;
+    std::unordered_map<uint64_t, size_t> m_modelRequests; // per model (Handle::Id): how often it was requested (memory report)
+    std::map<std::string, ResidentGroup> m_resident;      // handles of the preloaded groups
+    const ResidentGroup *m_activeResident = nullptr;     // entry of the active group in m_resident, if any
+
+    // budget bookkeeping of a loaded 2D texture or model, indexed by the slot of its handle
+    struct Residency
+    {
+        TexHandle texture;                // one of the two handles is valid
+        ModelHandle model;
+        std::string path;                 // textures are loaded again from their file
+        bool flip = false;
+        TexUsage usage = TexUsage::Color;
+        size_t bytes = 0;                 // GPU bytes while resident, 0 until measured (see EndFrame)
+        uint64_t lastUsed = 0;            // frame of the last Get
+        bool evicted = false;
+    };
+    std::vector<Residency> m_textureResidency;
+    std::vector<Residency> m_modelResidency;
+    uint64_t m_frame = 1;
+    size_t m_residentBytes = 0;
+    size_t m_evictions = 0;
+
+    void trackTexture(TexHandle handle, const std::string &path, bool flip, TexUsage usage)
+    {
+        if (handle.index >= m_textureResidency.size())
+            m_textureResidency.resize(handle.index + 1);
+        Residency &residency = m_textureResidency[handle.index];
+        if (residency.texture == handle) // requested before
+            return;
+        residency = Residency();
+        residency.texture = handle;
+        residency.path = path;
+        residency.flip = flip;
+        residency.usage = usage;
+        residency.lastUsed = m_frame;
+    }
+
+    void trackModel(ModelHandle handle)
+    {
+        if (handle.index >= m_modelResidency.size())
+            m_modelResidency.resize(handle.index + 1);
+        Residency &residency = m_modelResidency[handle.index];
+        if (residency.model == handle)
+            return;
+        residency = Residency();
+        residency.model = handle;
+        residency.lastUsed = m_frame;
+    }
 
     // checks if there is a TEX_FLIP="setting-flip-texture" key in the group and check if it is boolean
     bool flipImagesForGroup(const std::string &group)
     {
-        auto g = m_assets.at(group);
+        auto &g = m_assets.at(group);
         if (g.find(TEX_FLIP) != g.end()) // key found
             return GetAsset<bool>(group, TEX_FLIP);
         else
             return false; // if key is not set we assume no flipping!
     }
 
+    // MESH_PROCESS_* flags from the MESH_OPTIMIZE, MESH_LODS and MESH_FAST_OBJ keys of the group (meshes are used as imported by default)
+    uint32_t meshProcessingForGroup(const std::string &group)
+    {
+        auto &g = m_assets.at(group);
+        uint32_t processing = 0;
+        if (g.find(MESH_OPTIMIZE) != g.end() && GetAsset<bool>(group, MESH_OPTIMIZE))
+            processing |= MESH_PROCESS_OPTIMIZE;
+        if (g.find(MESH_LODS) != g.end() && GetAsset<bool>(group, MESH_LODS))
+            processing |= MESH_PROCESS_LODS;
+        if (g.find(MESH_FAST_OBJ) != g.end() && GetAsset<bool>(group, MESH_FAST_OBJ))
+            processing |= MESH_PROCESS_FAST_OBJ;
+        return processing;
+    }
+
     bool GroupExists(const std::string &group)
     {
         if (m_assets.find(group) != m_assets.end()) // key found
@@ -184,26 +787,68 @@ private:
         }
     }
 
-    template <>
-    Model Convert(std::any &r)
+    void printOptimizationStats(const MeshOptStats &stats)
+    {
+        std::cout << "  mesh optimization: " << stats.triangles << " triangles, vertices " << stats.verticesBefore << " -> " << stats.verticesAfter
+                  << ", ACMR " << stats.AcmrBefore() << " -> " << stats.AcmrAfter()
+                  << ", overdraw " << stats.OverdrawBefore() << " -> " << stats.OverdrawAfter() << std::endl;
+    }
+
+    // triangles and error of each level of detail, summed up over all meshes
+    void printLods(const Model &model)
+    {
+        std::vector<size_t> triangles;
+        std::vector<float> errors;
+        for (auto &mesh : model.meshes)
+        {
+            for (size_t i = 0; i < mesh.lods.size(); i++)
+            {
+                if (i >= triangles.size())
+                {
+                    triangles.push_back(0);
+                    errors.push_back(0.0f);
+                }
+                triangles[i] += mesh.lods[i].indexCount / 3;
+                errors[i] = std::max(errors[i], mesh.lods[i].error);
+            }
+        }
+        std::cout << "  levels of detail:";
+        for (size_t i = 0; i < triangles.size(); i++)
+            std::cout << " [" << i << "] " << triangles[i] << " triangles (error " << errors[i] << ")";
+        std::cout << std::endl;
+    }
+
+    // loads (or looks up) a model; the registry owns the only instance
+    ModelHandle LoadModel(std::any &r, uint32_t processing)
     {
         try
         {
             auto path = std::any_cast<const char *>(r);
 
-            if (loadedAssets.count(path) <= 0) // not loaded yet (lazy init)
+            ModelHandle handle = loadedModels.Find(modelKey(path, processing));
+            if (!handle.isValid()) // not loaded yet (lazy init)
             {
                 std::cout << "Loading Model " << path << " ... ";
                 auto t1 = std::chrono::high_resolution_clock::now();
-                Model *m = new Model(path);
-                loadedAssets.insert(std::pair<const std::string, std::any>(path, *m));
+                handle = loadedModels.Add(modelKey(path, processing), Model(path, false, false, false, processing));
+                trackModel(handle);
                 auto t2 = std::chrono::high_resolution_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
-                std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
+                Model &m = loadedModels.Get(handle);
+                std::cout << "done (in " << (duration / 1000) << " milliseconds)";
+                if (m.loadedFromCache) // compare against the Assimp import that produced the cache
+                    std::cout << " from mesh cache, Assimp import took " << m.importMilliseconds << " milliseconds";
+                else if (meshCacheEnabled)
+                    std::cout << " with Assimp, mesh cache written";
+                std::cout << "." << std::endl;
+                if (processing & MESH_PROCESS_OPTIMIZE)
+                    printOptimizationStats(m.optimizationStats);
+                if (processing & MESH_PROCESS_LODS)
+                    printLods(m);
             }
-            auto m = std::any_cast<Model &>(loadedAssets.at(path));
-            return m;
+            m_modelRequests[handle.Id()]++;
+            return handle;
         }
         catch (const std::bad_any_cast &e)
         {
@@ -212,55 +857,143 @@ private:
         }
     }
 
-    template <>
-    Tex Convert(std::any &r)
+    // loads (or looks up) a texture; flipping is passed per request instead of through global stb state
+    TexHandle LoadTex(std::any &r, bool flipVertically, TexUsage usage)
     {
-        try
+        if (auto cubemap = std::any_cast<CubeMapPaths>(&r))
         { // handle 6 face cube maps
-            auto cubemap = std::any_cast<CubeMapPaths>(r);
-            auto uniquename = "cubemap_" + cubemap["front"];
+            auto uniquename = textureKey("cubemap_" + (*cubemap)["front"], flipVertically);
 
-            if (loadedAssets.count(uniquename) <= 0) // not loaded yet (lazy init)
+            TexHandle handle = loadedTextures.Find(uniquename);
+            if (!handle.isValid()) // not loaded yet (lazy init)
             {
                 std::cout << "Loading CubeMap " << uniquename << " ... ";
                 auto t1 = std::chrono::high_resolution_clock::now();
-                loadedAssets.insert(std::pair<const std::string, std::any>(uniquename, Tex(loadCubemap(cubemap))));
+                handle = loadedTextures.Add(uniquename, Tex(loadCubemap(*cubemap, flipVertically)));
                 auto t2 = std::chrono::high_resolution_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
                 std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
             }
-            auto c = std::any_cast<Tex>(loadedAssets.at(uniquename));
-            return c;
+            return handle;
         }
-        catch (const std::bad_any_cast) // if not a cube map
-        {
-            try
-            { // handle 2D textures
-                auto path = std::any_cast<const char *>(r);
 
-                if (loadedAssets.count(path) <= 0) // not loaded yet (lazy init)
-                {
-                    std::cout << "Loading Texture " << path << " ... ";
-                    auto t1 = std::chrono::high_resolution_clock::now();
-                    loadedAssets.insert(std::pair<const std::string, std::any>(path, Tex(loadTexture(path))));
-                    auto t2 = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+        try
+        { // handle 2D textures
+            auto path = std::any_cast<const char *>(r);
 
-                    std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
-                }
-                auto t = std::any_cast<Tex>(loadedAssets.at(path));
-                return t;
+            TexHandle handle = loadedTextures.Find(textureKey(path, flipVertically, usage));
+            if (!handle.isValid()) // not loaded yet (lazy init)
+            {
+                std::cout << "Loading Texture " << path << " ... ";
+                auto t1 = std::chrono::high_resolution_clock::now();
+                handle = loadedTextures.Add(textureKey(path, flipVertically, usage), Tex(loadTexture(path, flipVertically, usage)));
+                trackTexture(handle, path, flipVertically, usage);
+                auto t2 = std::chrono::high_resolution_clock::now();
+                auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+                std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
             }
-            catch (const std::bad_any_cast &e)
+            return handle;
+        }
+        catch (const std::bad_any_cast &e)
+        {
+            std::cout << e.what() << '\n';
+            throw e;
+        }
+    }
+
+    // a 2D texture that is decoded (and block compressed, or read from the texture cache) on the worker pool
+    struct TextureLoad
+    {
+        const char *path;
+        bool flip;
+        TexUsage usage;
+        std::future<CompressedTexture> compressed; // with textureCompressionEnabled
+        std::future<DecodedImage> decoded;         // otherwise
+    };
+
+    struct TextureLoadStats
+    {
+        size_t compressedBytes = 0, uncompressedBytes = 0, fromCache = 0, count = 0;
+    };
+
+    // adds the 2D textures of a group that are neither loaded nor in loads yet
+    void collectTextureLoads(const std::string &group, std::list<TextureLoad> &loads)
+    {
+        bool flip = flipImagesForGroup(group);
+        for (auto &item : m_assets.at(group))
+        {
+            auto path = std::any_cast<const char *>(&item.second);
+            TexUsage usage = textureUsageForName(item.first);
+            if (path && isImageFile(*path) && !loadedTextures.Find(textureKey(*path, flip, usage)).isValid() &&
+                std::find_if(loads.begin(), loads.end(), [&](const TextureLoad &t)
+                             { return std::string(t.path) == *path && t.flip == flip && t.usage == usage; }) == loads.end())
             {
-                std::cout << e.what() << '\n';
-                throw e;
+                loads.emplace_back();
+                loads.back().path = *path;
+                loads.back().flip = flip;
+                loads.back().usage = usage;
             }
         }
     }
 
+    void startTextureLoad(TextureLoad &load)
+    {
+        if (textureCompressionEnabled)
+            load.compressed = workerPool().submit([path = load.path, usage = load.usage, flip = load.flip]
+                                                  { return loadCompressedTexture(path, flip, usage); });
+        else
+            load.decoded = workerPool().submit([path = load.path, flip = load.flip]
+                                               { return decodeImage(path, flip); });
+    }
+
+    bool textureLoadReady(const TextureLoad &load) const
+    {
+        if (load.compressed.valid())
+            return load.compressed.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        return load.decoded.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // uploads a texture load (waits for it if necessary) and registers the texture (render thread only)
+    void finishTextureLoad(TextureLoad &load, TextureLoadStats &stats)
+    {
+        unsigned int textureID;
+        uint32_t variant = textureVariant(load.flip, load.usage, GL_MIRRORED_REPEAT);
+        if (load.compressed.valid())
+        {
+            CompressedTexture texture = load.compressed.get();
+            textureID = textureCache().Acquire(load.path, variant, [&]
+                                               { return uploadCompressedTexture(texture, GL_MIRRORED_REPEAT); });
+            if (textureID == 0) // not decodable or format not supported by the driver
+                textureID = loadTexture(load.path, load.flip, load.usage);
+            stats.compressedBytes += texture.ByteSize();
+            stats.uncompressedBytes += texture.sourceBytes;
+            stats.fromCache += texture.fromCache ? 1 : 0;
+        }
+        else
+        {
+            DecodedImage image = load.decoded.get();
+            textureID = textureCache().Acquire(load.path, variant, [&]
+                                               { return uploadTexture(image); });
+            if (image.data) // the same content was loaded before, the pixels were not needed
+                stbi_image_free(image.data);
+        }
+        stats.count++;
+        trackTexture(loadedTextures.Add(textureKey(load.path, load.flip, load.usage), Tex(textureID)), load.path, load.flip, load.usage);
+    }
+
+    void printCompressionStats(const TextureLoadStats &stats, size_t textureCount)
+    {
+        if (stats.compressedBytes > 0)
+            std::cout << "  block compressed: " << std::fixed << std::setprecision(2) << stats.compressedBytes / (1024.0 * 1024.0) << " MB instead of "
+                      << stats.uncompressedBytes / (1024.0 * 1024.0) << " MB (RGBA8 with mips), " << stats.fromCache << " of " << textureCount
+                      << " from the texture cache" << std::defaultfloat << std::endl;
+    }
+
 public:
+    size_t gpuBudget = 512 * 1024 * 1024; // bytes of textures and mesh buffers to keep resident, see EndFrame
+
     AssetManager(const Assets assets) : m_assets{assets} { m_active = m_assets.begin()->first; }
 
     template <class T>
@@ -273,10 +1006,8 @@ public:
     template <>
     Tex GetAsset(const std::string &group, const std::string &name)
     {
-        // Optionally tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-        stbi_set_flip_vertically_on_load(flipImagesForGroup(group));
-
-        return Convert<Tex>(m_assets.at(group).at(name));
+        // Optionally tell stb_image.h to flip loaded texture's on the y-axis (per request, see decodeImage).
+        return Get(GetTextureHandle(group, name));
     }
 
     template <class T>
@@ -285,6 +1016,384 @@ public:
         return GetAsset<T>(m_active, name);
     }
 
+    // models are never copied: the reference points to the single instance in the registry
+    Model &GetModel(const std::string &group, const std::string &name) { return Get(GetModelHandle(group, name)); }
+    Model &GetActiveModel(const std::string &name) { return GetModel(m_active, name); }
+
+    // handles are resolved (and the asset loaded) once; afterwards use Get(handle), e.g. every frame
+    TexHandle GetTextureHandle(const std::string &group, const std::string &name)
+    {
+        return LoadTex(m_assets.at(group).at(name), flipImagesForGroup(group), textureUsageForName(name));
+    }
+    ModelHandle GetModelHandle(const std::string &group, const std::string &name)
+    {
+        return LoadModel(m_assets.at(group).at(name), meshProcessingForGroup(group));
+    }
+
+    // resolving a handle marks the asset as used in this frame; an evicted asset is loaded again right here
+    Tex &Get(TexHandle handle)
+    {
+        Tex &tex = loadedTextures.Get(handle);
+        if (handle.index < m_textureResidency.size() && m_textureResidency[handle.index].texture == handle)
+        {
+            Residency &residency = m_textureResidency[handle.index];
+            residency.lastUsed = m_frame;
+            if (residency.evicted)
+            {
+                tex = Tex(loadTexture(residency.path.c_str(), residency.flip, residency.usage));
+                residency.evicted = false;
+                residency.bytes = 0; // measured again by EndFrame
+            }
+        }
+        return tex;
+    }
+    Model &Get(ModelHandle handle)
+    {
+        Model &model = loadedModels.Get(handle);
+        if (handle.index < m_modelResidency.size() && m_modelResidency[handle.index].model == handle)
+        {
+            Residency &residency = m_modelResidency[handle.index];
+            residency.lastUsed = m_frame;
+            if (residency.evicted) // the CPU copy of the meshes was kept, only the buffers are created again
+            {
+                model.Upload();
+                residency.evicted = false;
+                residency.bytes = 0; // measured again by EndFrame (with the arena copy, if UseArena is called again)
+            }
+        }
+        return model;
+    }
+
+    // call once per frame after drawing. While the GPU bytes of all tracked textures and models exceed gpuBudget,
+    // the least recently used one that was not resolved (Get) in this frame is evicted. Handles stay valid,
+    // the next Get brings the asset back. Cube maps and assets that are still streaming in are never evicted.
+    // Registry entries that share one OpenGL texture (texture cache) are counted and evicted together, and a
+    // texture that is still referenced elsewhere (e.g., by a model's materials) is not evicted, it would free nothing.
+    void EndFrame()
+    {
+        struct Candidate
+        {
+            uint64_t lastUsed;
+            size_t bytes;
+            std::vector<Residency *> residencies; // all entries of the same texture, or one model
+        };
+        std::vector<Candidate> candidates;
+        std::unordered_map<unsigned int, size_t> textureCandidates; // OpenGL texture -> index in candidates
+        size_t resident = 0;
+        for (auto *table : {&m_textureResidency, &m_modelResidency})
+        {
+            for (auto &residency : *table)
+            {
+                if (residency.evicted || !(residency.texture.isValid() || residency.model.isValid()))
+                    continue;
+                if (residency.bytes == 0) // new (or reloaded) asset, measure it once it is resident
+                {
+                    // a texture that failed to stream keeps its placeholder, which belongs to the streamer
+                    if (residency.texture.isValid() && m_streamer.IsResident(residency.texture) &&
+                        !m_streamer.IsPlaceholder(*loadedTextures.TryGet(residency.texture)))
+                        residency.bytes = textureGpuBytes(*loadedTextures.TryGet(residency.texture));
+                    else if (residency.model.isValid() && m_streamer.IsResident(residency.model))
+                        residency.bytes = loadedModels.TryGet(residency.model)->GpuBytes();
+                    if (residency.bytes == 0)
+                        continue;
+                }
+                if (residency.texture.isValid())
+                {
+                    unsigned int textureID = *loadedTextures.TryGet(residency.texture);
+                    auto shared = textureCandidates.find(textureID);
+                    if (shared != textureCandidates.end()) // counted already
+                    {
+                        Candidate &candidate = candidates[shared->second];
+                        candidate.lastUsed = std::max(candidate.lastUsed, residency.lastUsed);
+                        candidate.residencies.push_back(&residency);
+                        continue;
+                    }
+                    textureCandidates[textureID] = candidates.size();
+                }
+                resident += residency.bytes;
+                candidates.push_back({residency.lastUsed, residency.bytes, {&residency}});
+            }
+        }
+
+        if (resident > gpuBudget)
+        {
+            std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                      { return a.lastUsed < b.lastUsed; });
+            for (auto &candidate : candidates)
+            {
+                if (resident <= gpuBudget || candidate.lastUsed >= m_frame)
+                    break;
+                Residency &first = *candidate.residencies.front();
+                if (first.texture.isValid())
+                {
+                    unsigned int textureID = *loadedTextures.TryGet(first.texture);
+                    if (textureCache().References(textureID) > candidate.residencies.size())
+                        continue;
+                    for (auto *residency : candidate.residencies)
+                    {
+                        Tex *tex = loadedTextures.TryGet(residency->texture);
+                        textureCache().Release(*tex); // deleted with the last reference
+                        *tex = Tex(0);
+                        residency->evicted = true;
+                    }
+                }
+                else
+                {
+                    loadedModels.TryGet(first.model)->ReleaseBuffers();
+                    first.evicted = true;
+                }
+                resident -= candidate.bytes;
+                m_evictions++;
+            }
+        }
+        m_residentBytes = resident;
+        m_frame++;
+    }
+
+    // GPU bytes of the tracked assets that are resident (as of the last EndFrame) and evictions so far
+    size_t ResidentBytes() const { return m_residentBytes; }
+    size_t Evictions() const { return m_evictions; }
+
+    // loads all 2D textures of a group that are not loaded yet: the images are decoded (and block compressed, or
+    // read from the texture cache) in parallel on the worker pool, only the uploads to OpenGL happen on the
+    // calling (render) thread.
+    void LoadTextures(const std::string &group)
+    {
+        if (!GroupExists(group))
+            return;
+        std::list<TextureLoad> loads;
+        collectTextureLoads(group, loads);
+        if (loads.empty())
+            return;
+
+        std::cout << "Loading " << loads.size() << " textures of group " << group << " in parallel ... ";
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (auto &load : loads)
+            startTextureLoad(load);
+        TextureLoadStats stats;
+        for (auto &load : loads)
+            finishTextureLoad(load, stats);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+        std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
+        printCompressionStats(stats, loads.size());
+    }
+
+    // loads all models and 2D textures of the groups at the same time: every model import and every texture
+    // decode is its own task on the worker pool, the calling (render) thread uploads whatever is finished.
+    // progress (optional) is called on the calling thread after each asset, e.g. to draw a loading screen.
+    // When Preload returns, everything is resident on the GPU and SetActiveGroup to one of these groups only
+    // swaps a pointer to the resolved handles (see ActiveResident).
+    void Preload(const std::vector<std::string> &groups, const std::function<void(const PreloadProgress &)> &progress = nullptr)
+    {
+        struct ModelLoad
+        {
+            std::string key;
+            std::future<std::unique_ptr<Model>> loading;
+        };
+        std::list<ModelLoad> models;
+        std::list<TextureLoad> textures;
+        for (auto &group : groups)
+        {
+            if (!GroupExists(group))
+                continue;
+            auto &items = m_assets.at(group);
+            auto model = items.find("model");
+            const char *const *path = model != items.end() ? std::any_cast<const char *>(&model->second) : nullptr;
+            if (path)
+            {
+                uint32_t processing = meshProcessingForGroup(group);
+                std::string key = modelKey(*path, processing);
+                if (!loadedModels.Find(key).isValid() &&
+                    std::find_if(models.begin(), models.end(), [&](const ModelLoad &m)
+                                 { return m.key == key; }) == models.end())
+                    models.push_back({key, workerPool().submit([path = std::string(*path), processing]
+                                                               { return std::make_unique<Model>(path, false, false, true, processing); })});
+            }
+            collectTextureLoads(group, textures);
+        }
+        for (auto &load : textures)
+            startTextureLoad(load);
+
+        PreloadProgress state;
+        state.total = models.size() + textures.size();
+        std::cout << "Preloading " << models.size() << " models and " << textures.size() << " textures of " << groups.size() << " groups ... ";
+        auto t1 = std::chrono::high_resolution_clock::now();
+        TextureLoadStats stats;
+        while (!models.empty() || !textures.empty())
+        {
+            bool finished = false;
+            for (auto load = models.begin(); load != models.end();)
+            {
+                if (load->loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                {
+                    ++load;
+                    continue;
+                }
+                std::unique_ptr<Model> model = load->loading.get();
+                model->Upload(); // the whole model at once, there is no frame to keep smooth
+                trackModel(loadedModels.Add(load->key, std::move(*model)));
+                state.asset = load->key;
+                state.done++;
+                if (progress)
+                    progress(state);
+                load = models.erase(load);
+                finished = true;
+            }
+            for (auto load = textures.begin(); load != textures.end();)
+            {
+                if (!textureLoadReady(*load))
+                {
+                    ++load;
+                    continue;
+                }
+                finishTextureLoad(*load, stats);
+                state.asset = load->path;
+                state.done++;
+                if (progress)
+                    progress(state);
+                load = textures.erase(load);
+                finished = true;
+            }
+            if (!finished)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+        std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
+        printCompressionStats(stats, stats.count);
+
+        // resolve the handles once, so a group switch does not need any lookups
+        for (auto &group : groups)
+        {
+            if (!GroupExists(group))
+                continue;
+            ResidentGroup resident;
+            for (auto &item : m_assets.at(group))
+            {
+                auto path = std::any_cast<const char *>(&item.second);
+                if (item.first == "model" && path)
+                    resident.model = GetModelHandle(group, item.first);
+                else if (path && (isImageFile(*path) || isHdrFile(*path)))
+                    resident.textures[item.first] = GetTextureHandle(group, item.first);
+            }
+            m_resident[group] = resident;
+        }
+        SetActiveGroup(m_active);
+    }
+
+    // the resolved handles of the active group if it was preloaded, otherwise nullptr
+    const ResidentGroup *ActiveResident() const { return m_activeResident; }
+
+    // streaming mode: requests return a handle right away, that resolves to a placeholder until the asset is
+    // resident. Call UpdateStreaming() once per frame to finish the requests within the streamer's byte budget.
+    TexHandle StreamTexture(const std::string &group, const std::string &name, uint32_t placeholderColor = 0xff808080)
+    {
+        auto path = std::any_cast<const char *>(m_assets.at(group).at(name));
+        TexUsage usage = textureUsageForName(name);
+        TexHandle handle = m_streamer.RequestTexture(path, flipImagesForGroup(group), usage, placeholderColor);
+        trackTexture(handle, path, flipImagesForGroup(group), usage);
+        return handle;
+    }
+
+    ModelHandle StreamModel(const std::string &group, const std::string &name)
+    {
+        auto path = std::any_cast<const char *>(m_assets.at(group).at(name));
+        ModelHandle handle = m_streamer.RequestModel(path, meshProcessingForGroup(group));
+        trackModel(handle);
+        m_modelRequests[handle.Id()]++;
+        return handle;
+    }
+
+    void UpdateStreaming() { m_streamer.Update(); }
+    AssetStreamer &Streamer() { return m_streamer; }
+
+    // frees the OpenGL objects of the streamer (placeholders, pixel buffers), call before the context is destroyed
+    void ReleaseGpuResources() { m_streamer.ReleaseGpuResources(); }
+
+    // prints the memory of the loaded assets, measured from the registries and the texture cache. Per group the
+    // model's CPU copy and GPU buffers and how often it was requested; the CPU bytes of a model that is not loaded
+    // are read from its mesh cache file (the report loads nothing). Bytes are counted once per instance: a model used
+    // by several groups and registry entries that share one OpenGL texture (same content) are reported as shared
+    // instead of resident again.
+    // "copied before" is what the former by-value GetAsset<Model> duplicated for the same use: the leaked
+    // new Model next to the stored copy, plus a full copy of the vertex and index arrays per request. Handles share
+    // the one instance of the registry, they copy nothing ("after").
+    void PrintMemoryReport()
+    {
+        std::cout << "Asset memory report" << std::endl;
+        std::cout << std::left << std::setw(12) << "group" << std::right << std::setw(14) << "CPU bytes" << std::setw(14) << "GPU bytes"
+                  << std::setw(10) << "requests" << std::setw(16) << "copied before" << std::setw(8) << "after" << std::endl;
+        std::unordered_map<uint64_t, size_t> modelGroups; // per model (Handle::Id): groups that use it
+        size_t copiedBefore = 0;
+        for (auto &group : GetGroups())
+        {
+            auto &items = m_assets.at(group);
+            auto item = items.find("model");
+            const char *const *path = item != items.end() ? std::any_cast<const char *>(&item->second) : nullptr;
+            if (!path)
+                continue;
+            ModelHandle handle = loadedModels.Find(modelKey(*path, meshProcessingForGroup(group)));
+            const Model *model = loadedModels.TryGet(handle);
+            size_t cpuBytes = model ? model->CpuBytes() : Model::CachedCpuBytes(*path, meshProcessingForGroup(group));
+            if (!model && cpuBytes == 0)
+            {
+                std::cout << std::left << std::setw(12) << group << std::right << std::setw(14) << "not loaded" << std::setw(14) << "-"
+                          << std::setw(10) << 0 << std::setw(16) << "-" << std::setw(8) << 0 << "  (no mesh cache yet)" << std::endl;
+                continue;
+            }
+            size_t requests = 0;
+            if (model)
+            {
+                modelGroups[handle.Id()]++;
+                auto found = m_modelRequests.find(handle.Id());
+                requests = found != m_modelRequests.end() ? found->second : 0;
+            }
+            size_t copied = cpuBytes * (1 + requests);
+            copiedBefore += copied;
+            std::cout << std::left << std::setw(12) << group << std::right << std::setw(14) << cpuBytes << std::setw(14);
+            if (model)
+                std::cout << model->GpuBytes();
+            else
+                std::cout << "-";
+            std::cout << std::setw(10) << requests << std::setw(16) << copied << std::setw(8) << 0 << (model ? "" : "  (not loaded, mesh cache)")
+                      << std::endl;
+        }
+
+        size_t modelCpuBytes = 0, modelGpuBytes = 0, modelSharedBytes = 0;
+        loadedModels.ForEach([&](ModelHandle handle, Model &model)
+                             {
+            modelCpuBytes += model.CpuBytes();
+            modelGpuBytes += model.GpuBytes();
+            auto groups = modelGroups.find(handle.Id());
+            if (groups != modelGroups.end())
+                modelSharedBytes += (groups->second - 1) * model.CpuBytes(); });
+
+        // registry entries per OpenGL texture. Cube maps are not 2D textures, evicted entries have no texture.
+        std::unordered_map<unsigned int, size_t> textureEntries;
+        loadedTextures.ForEach([&](TexHandle handle, Tex &tex)
+                               {
+            if ((unsigned int)tex != 0 && loadedTextures.Key(handle).rfind("cubemap_", 0) != 0)
+                textureEntries[tex]++; });
+        size_t textureBytes = 0, textureSharedBytes = 0;
+        for (auto &entry : textureEntries)
+        {
+            size_t bytes = textureGpuBytes(entry.first);
+            textureBytes += bytes;
+            textureSharedBytes += (entry.second - 1) * bytes;
+        }
+
+        std::cout << "models: " << loadedModels.Size() << " loaded, " << modelCpuBytes << " bytes CPU, " << modelGpuBytes << " bytes GPU, "
+                  << modelSharedBytes << " bytes shared between groups" << std::endl;
+        std::cout << "model copies: " << copiedBefore << " bytes duplicated by by-value GetAsset<Model> before, 0 bytes with handles"
+                  << std::endl;
+        std::cout << "textures: " << loadedTextures.Size() << " loaded as " << textureEntries.size() << " OpenGL 2D textures, " << textureBytes
+                  << " bytes GPU, " << textureSharedBytes << " bytes shared by entries with the same content" << std::endl;
+        std::cout << "texture cache: " << textureCache().Size() << " OpenGL textures by content, " << textureCache().SharedRequests()
+                  << " requests shared an existing texture" << std::endl;
+    }
+
     std::vector<std::string> GetGroups() const
     {
         std::vector<std::string> keys;
@@ -301,6 +1410,8 @@ public:
         if (!GroupExists(group))
             return;
         m_active = group;
+        auto resident = m_resident.find(group);
+        m_activeResident = resident != m_resident.end() ? &resident->second : nullptr;
     }
 
     void SetActiveGroup(const int id) { SetActiveGroup(GetGroups().at(id)); }
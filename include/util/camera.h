@@ -5,7 +5,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <util/culling.h>
+
 #include <vector>
+#include <algorithm>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
 enum Camera_Movement {
@@ -66,6 +69,12 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // returns the world space planes of the view volume for the given projection matrix (see culling.h)
+    Frustum GetFrustum(const glm::mat4 &projection) const
+    {
+        return Frustum::FromMatrix(projection * glm::lookAt(Position, Position + Front, Up));
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
@@ -109,7 +118,14 @@ public:
         if (Zoom < 1.0f)
             Zoom = 1.0f;
         if (Zoom > 90.0f)
-            Zoom = 90.0f; 
+            Zoom = 90.0f;
+    }
+
+    // returns how many pixels a world space length covers at the given distance (vertical field of view = Zoom).
+    // Used for level of detail selection.
+    float ProjectedSize(float worldSize, float distance, float viewportHeight) const
+    {
+        return worldSize / std::max(distance, 1e-4f) * viewportHeight / (2.0f * tan(glm::radians(Zoom) * 0.5f));
     }
 
 private:
@@ -0,0 +1,216 @@
+#pragma once
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULL_SSE 1
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_AVX 1
+#endif
+
+// The six planes of a view frustum in world space (left, right, bottom, top, near, far). xyz is the normal, pointing
+// into the frustum, w the distance: a point p is inside if dot(xyz, p) + w >= 0 for all planes.
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    // extracts the planes from projection * view (Gribb/Hartmann), OpenGL clip space (-w <= z <= w)
+    static Frustum FromMatrix(const glm::mat4 &viewProjection)
+    {
+        Frustum frustum;
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        for (int i = 0; i < 3; i++)
+        {
+            frustum.planes[i * 2 + 0] = row[3] + row[i];
+            frustum.planes[i * 2 + 1] = row[3] - row[i];
+        }
+        for (auto &plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    // false if the box (center, half extent) is completely outside one of the planes
+    bool Intersects(const glm::vec3 &center, const glm::vec3 &extent) const
+    {
+        for (auto &plane : planes)
+        {
+            glm::vec3 normal(plane);
+            if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+// Axis aligned boxes and their bounding spheres, stored as structure of arrays: one array per coordinate, so four
+// (SSE) or eight (AVX) boxes are tested against a plane with a few instructions. Boxes are stored as center and
+// half extent; the sphere has the same center and encloses the box.
+class BoundsSoA
+{
+public:
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+
+    size_t Size() const { return centerX.size(); }
+
+    void Clear() { Resize(0); }
+
+    void Resize(size_t count)
+    {
+        for (auto *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius})
+            array->resize(count);
+    }
+
+    void Reserve(size_t count)
+    {
+        for (auto *array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius})
+            array->reserve(count);
+    }
+
+    // appends the box from min to max, returns its index
+    size_t Add(const glm::vec3 &min, const glm::vec3 &max)
+    {
+        Resize(Size() + 1);
+        Set(Size() - 1, min, max);
+        return Size() - 1;
+    }
+
+    void Set(size_t i, const glm::vec3 &min, const glm::vec3 &max)
+    {
+        glm::vec3 center = (min + max) * 0.5f;
+        glm::vec3 extent = (max - min) * 0.5f;
+        centerX[i] = center.x;
+        centerY[i] = center.y;
+        centerZ[i] = center.z;
+        extentX[i] = extent.x;
+        extentY[i] = extent.y;
+        extentZ[i] = extent.z;
+        radius[i] = glm::length(extent);
+    }
+
+    glm::vec3 Center(size_t i) const { return glm::vec3(centerX[i], centerY[i], centerZ[i]); }
+    glm::vec3 Extent(size_t i) const { return glm::vec3(extentX[i], extentY[i], extentZ[i]); }
+
+    // replaces the bounds with the boxes of local transformed by the matrix: the boxes stay axis aligned and
+    // enclose the transformed ones (J. Arvo), the spheres are scaled by the largest axis scale
+    void Transform(const BoundsSoA &local, const glm::mat4 &matrix)
+    {
+        Resize(local.Size());
+        glm::mat3 m(matrix);
+        glm::mat3 a(glm::abs(m[0]), glm::abs(m[1]), glm::abs(m[2]));
+        float scale = std::max(glm::length(m[0]), std::max(glm::length(m[1]), glm::length(m[2])));
+        for (size_t i = 0; i < local.Size(); i++)
+        {
+            glm::vec3 center = glm::vec3(matrix * glm::vec4(local.Center(i), 1.0f));
+            glm::vec3 extent = a * local.Extent(i);
+            centerX[i] = center.x;
+            centerY[i] = center.y;
+            centerZ[i] = center.z;
+            extentX[i] = extent.x;
+            extentY[i] = extent.y;
+            extentZ[i] = extent.z;
+            radius[i] = local.radius[i] * scale;
+        }
+    }
+
+    // replaces visible with the indices of the boxes that intersect the frustum, in ascending order. Returns their
+    // number. Eight boxes at a time with AVX, four with SSE, the rest one by one.
+    size_t Cull(const Frustum &frustum, std::vector<uint32_t> &visible) const
+    {
+        visible.clear();
+        size_t i = 0;
+#ifdef CULL_AVX
+        for (; i + 8 <= Size(); i += 8)
+            appendVisible(test8(frustum, i), i, visible);
+#endif
+#ifdef CULL_SSE
+        for (; i + 4 <= Size(); i += 4)
+            appendVisible(test4(frustum, i), i, visible);
+#endif
+        cullScalar(frustum, i, visible);
+        return visible.size();
+    }
+
+    // the same without SIMD, for comparison
+    size_t CullScalar(const Frustum &frustum, std::vector<uint32_t> &visible) const
+    {
+        visible.clear();
+        cullScalar(frustum, 0, visible);
+        return visible.size();
+    }
+
+private:
+    void cullScalar(const Frustum &frustum, size_t first, std::vector<uint32_t> &visible) const
+    {
+        for (size_t i = first; i < Size(); i++)
+            if (frustum.Intersects(Center(i), Extent(i)))
+                visible.push_back((uint32_t)i);
+    }
+
+    // adds first + j for every bit j of mask
+    static void appendVisible(int mask, size_t first, std::vector<uint32_t> &visible)
+    {
+        for (uint32_t j = 0; mask != 0; j++, mask >>= 1)
+            if (mask & 1)
+                visible.push_back((uint32_t)first + j);
+    }
+
+#ifdef CULL_SSE
+    // bit j is set if box first + j intersects the frustum (Frustum::Intersects for four boxes)
+    int test4(const Frustum &frustum, size_t first) const
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 cx = _mm_loadu_ps(&centerX[first]), cy = _mm_loadu_ps(&centerY[first]), cz = _mm_loadu_ps(&centerZ[first]);
+        __m128 ex = _mm_loadu_ps(&extentX[first]), ey = _mm_loadu_ps(&extentY[first]), ez = _mm_loadu_ps(&extentZ[first]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (auto &plane : frustum.planes)
+        {
+            __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+            // dot(n, c) + w + dot(|n|, e): the distance of the corner furthest along the normal
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(plane.w)));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                      _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+        return _mm_movemask_ps(inside);
+    }
+#endif
+
+#ifdef CULL_AVX
+    // the same for eight boxes
+    int test8(const Frustum &frustum, size_t first) const
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256 cx = _mm256_loadu_ps(&centerX[first]), cy = _mm256_loadu_ps(&centerY[first]), cz = _mm256_loadu_ps(&centerZ[first]);
+        __m256 ex = _mm256_loadu_ps(&extentX[first]), ey = _mm256_loadu_ps(&extentY[first]), ez = _mm256_loadu_ps(&extentZ[first]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (auto &plane : frustum.planes)
+        {
+            __m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+                                            _mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(plane.w)));
+            __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex), _mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)),
+                                         _mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        return _mm256_movemask_ps(inside);
+    }
+#endif
+};
+
+#endif
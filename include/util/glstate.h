@@ -0,0 +1,183 @@
+#pragma once
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <cstddef>
+#include <map>
+
+// Thin layer over the OpenGL state that render loops set again and again: the program in use, the bound vertex
+// array, the texture bindings of each unit, the framebuffers and enable bits (glEnable/glDisable). Every call
+// compares against the last value that was set and only reaches the driver if it differs. The functions take the
+// same arguments as the GL functions they replace.
+//
+// The cache only knows what went through it: code that changes this state with plain GL calls (e.g., a library)
+// has to restore it or call Invalidate() afterwards. Deleted objects have to be forgotten (Forget*), because
+// OpenGL may hand out their names again. ImGui's OpenGL3 backend restores everything it changes.
+class GLStateCache
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 32;
+
+    GLStateCache() { Invalidate(); }
+
+    void UseProgram(GLuint program)
+    {
+        if (cached(m_program, program))
+            return;
+        glUseProgram(program);
+    }
+
+    void BindVertexArray(GLuint vao)
+    {
+        if (cached(m_vertexArray, vao))
+            return;
+        glBindVertexArray(vao);
+    }
+
+    void ActiveTexture(GLenum unit)
+    {
+        if (cached(m_activeUnit, unit))
+            return;
+        glActiveTexture(unit);
+    }
+
+    // binds to the active unit like glBindTexture. 2D textures and cube maps are cached, other targets pass through.
+    void BindTexture(GLenum target, GLuint texture)
+    {
+        GLint *binding = textureBinding(m_activeUnit, target);
+        if (binding && cached(*binding, texture))
+            return;
+        if (!binding)
+            m_issued++;
+        glBindTexture(target, texture);
+    }
+
+    void BindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        if (target == GL_FRAMEBUFFER)
+        {
+            if (m_drawFramebuffer == (GLint)framebuffer && m_readFramebuffer == (GLint)framebuffer)
+            {
+                m_skipped++;
+                return;
+            }
+            m_drawFramebuffer = m_readFramebuffer = framebuffer;
+            m_issued++;
+            glBindFramebuffer(target, framebuffer);
+            return;
+        }
+        GLint &binding = target == GL_READ_FRAMEBUFFER ? m_readFramebuffer : m_drawFramebuffer;
+        if (cached(binding, framebuffer))
+            return;
+        glBindFramebuffer(target, framebuffer);
+    }
+
+    void Enable(GLenum capability) { Set(capability, true); }
+    void Disable(GLenum capability) { Set(capability, false); }
+    void Set(GLenum capability, bool enabled)
+    {
+        auto state = m_enabled.find(capability);
+        if (state != m_enabled.end() && state->second == enabled)
+        {
+            m_skipped++;
+            return;
+        }
+        m_enabled[capability] = enabled;
+        m_issued++;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    // objects that were deleted: a binding of them is reset like OpenGL does it
+    void ForgetProgram(GLuint program)
+    {
+        if (m_program == (GLint)program)
+            m_program = UNKNOWN;
+    }
+    void ForgetVertexArray(GLuint vao)
+    {
+        if (m_vertexArray == (GLint)vao)
+            m_vertexArray = 0;
+    }
+    void ForgetTexture(GLuint texture)
+    {
+        for (auto &unit : m_textures)
+            for (GLint &binding : unit)
+                if (binding == (GLint)texture)
+                    binding = 0;
+    }
+    void ForgetFramebuffer(GLuint framebuffer)
+    {
+        if (m_drawFramebuffer == (GLint)framebuffer)
+            m_drawFramebuffer = 0;
+        if (m_readFramebuffer == (GLint)framebuffer)
+            m_readFramebuffer = 0;
+    }
+
+    // forgets everything, the next call of each kind reaches the driver
+    void Invalidate()
+    {
+        m_program = m_vertexArray = m_activeUnit = m_drawFramebuffer = m_readFramebuffer = UNKNOWN;
+        for (auto &unit : m_textures)
+            unit[0] = unit[1] = UNKNOWN;
+        m_enabled.clear();
+    }
+
+    // call once per frame: the counts of the frame that just ended are kept for display
+    void EndFrame()
+    {
+        m_lastIssued = m_issued;
+        m_lastSkipped = m_skipped;
+        m_issued = m_skipped = 0;
+    }
+    size_t IssuedLastFrame() const { return m_lastIssued; }
+    size_t SkippedLastFrame() const { return m_lastSkipped; }
+
+private:
+    static const GLint UNKNOWN = -1;
+
+    GLint m_program, m_vertexArray, m_activeUnit, m_drawFramebuffer, m_readFramebuffer;
+    GLint m_textures[MAX_TEXTURE_UNITS][2]; // GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP
+    std::map<GLenum, bool> m_enabled;
+    size_t m_issued = 0, m_skipped = 0;
+    size_t m_lastIssued = 0, m_lastSkipped = 0;
+
+    // true (and counted as skipped) if the value is already set, otherwise remembers it and counts the call
+    bool cached(GLint &current, GLuint value)
+    {
+        if (current == (GLint)value)
+        {
+            m_skipped++;
+            return true;
+        }
+        current = (GLint)value;
+        m_issued++;
+        return false;
+    }
+
+    GLint *textureBinding(GLint unit, GLenum target)
+    {
+        int index = (int)unit - GL_TEXTURE0;
+        if (unit == UNKNOWN || index < 0 || index >= MAX_TEXTURE_UNITS)
+            return nullptr;
+        if (target == GL_TEXTURE_2D)
+            return &m_textures[index][0];
+        if (target == GL_TEXTURE_CUBE_MAP)
+            return &m_textures[index][1];
+        return nullptr;
+    }
+};
+
+// the cache of the render thread's context (created on first use)
+// ---------------------------------------------------
+GLStateCache &glState()
+{
+    static GLStateCache state;
+    return state;
+}
+
+#endif
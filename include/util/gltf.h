@@ -0,0 +1,500 @@
+#pragma once
+#ifndef GLTF_H
+#define GLTF_H
+
+#include <glm/glm.hpp>
+
+#include <util/json.h>
+#include <util/mappedfile.h>
+#include <util/mesh.h>
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// glTF 2.0 reader (.gltf + .bin or a single .glb). The JSON part is parsed, the binary buffers are memory-mapped
+// and accessors point straight into the mapping, so vertex data is read in place without intermediate copies.
+// Supported: triangle primitives with POSITION, NORMAL, TEXCOORD_0, TANGENT and indices, node transforms,
+// images in buffer views or external files. Not supported: data: URIs, sparse accessors, skins, morph targets.
+
+const uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+enum GltfComponentType
+{
+    GLTF_BYTE = 5120,
+    GLTF_UNSIGNED_BYTE = 5121,
+    GLTF_SHORT = 5122,
+    GLTF_UNSIGNED_SHORT = 5123,
+    GLTF_UNSIGNED_INT = 5125,
+    GLTF_FLOAT = 5126
+};
+
+// typed view of an accessor inside a mapped buffer
+struct GltfAccessor
+{
+    const uint8_t *data = nullptr;
+    size_t count = 0;
+    size_t stride = 0; // bytes from one element to the next
+    int componentType = 0;
+    int components = 0; // 1 (SCALAR) .. 4 (VEC4), 16 (MAT4)
+    bool normalized = false;
+
+    bool isValid() const { return data != nullptr; }
+
+    // component c of element i as float (normalized integers are mapped to [0, 1] or [-1, 1])
+    float get(size_t i, int c) const
+    {
+        const uint8_t *p = data + i * stride;
+        switch (componentType)
+        {
+        case GLTF_FLOAT:
+        {
+            float v;
+            std::memcpy(&v, p + c * 4, 4);
+            return v;
+        }
+        case GLTF_UNSIGNED_BYTE:
+            return normalized ? p[c] / 255.0f : (float)p[c];
+        case GLTF_BYTE:
+            return normalized ? std::max((int8_t)p[c] / 127.0f, -1.0f) : (float)(int8_t)p[c];
+        case GLTF_UNSIGNED_SHORT:
+        {
+            uint16_t v;
+            std::memcpy(&v, p + c * 2, 2);
+            return normalized ? v / 65535.0f : (float)v;
+        }
+        case GLTF_SHORT:
+        {
+            int16_t v;
+            std::memcpy(&v, p + c * 2, 2);
+            return normalized ? std::max(v / 32767.0f, -1.0f) : (float)v;
+        }
+        case GLTF_UNSIGNED_INT:
+        {
+            uint32_t v;
+            std::memcpy(&v, p + c * 4, 4);
+            return (float)v;
+        }
+        default:
+            return 0.0f;
+        }
+    }
+
+    // element i of an index accessor
+    unsigned int index(size_t i) const
+    {
+        const uint8_t *p = data + i * stride;
+        if (componentType == GLTF_UNSIGNED_BYTE)
+            return *p;
+        if (componentType == GLTF_UNSIGNED_SHORT)
+        {
+            uint16_t v;
+            std::memcpy(&v, p, 2);
+            return v;
+        }
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    // float vectors that are tightly packed can be copied as a whole
+    bool isPackedFloat(int expectedComponents) const
+    {
+        return componentType == GLTF_FLOAT && components == expectedComponents && stride == (size_t)expectedComponents * 4;
+    }
+};
+
+// utility function for the size of a glTF component type in bytes
+// ---------------------------------------------------
+size_t gltfComponentSize(int componentType)
+{
+    switch (componentType)
+    {
+    case GLTF_BYTE:
+    case GLTF_UNSIGNED_BYTE:
+        return 1;
+    case GLTF_SHORT:
+    case GLTF_UNSIGNED_SHORT:
+        return 2;
+    case GLTF_UNSIGNED_INT:
+    case GLTF_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+int gltfComponentCount(const std::string &type)
+{
+    if (type == "SCALAR")
+        return 1;
+    if (type == "VEC2")
+        return 2;
+    if (type == "VEC3")
+        return 3;
+    if (type == "VEC4" || type == "MAT2")
+        return 4;
+    if (type == "MAT3")
+        return 9;
+    if (type == "MAT4")
+        return 16;
+    return 0;
+}
+
+// utility function to check the file extension for glTF files (.gltf and .glb)
+// ---------------------------------------------------
+bool isGltfFile(const std::string &path)
+{
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    for (auto &c : ext)
+        c = (char)std::tolower((unsigned char)c);
+    return ext == "gltf" || ext == "glb";
+}
+
+// an opened glTF file: the parsed JSON and the mapped buffers
+class GltfFile
+{
+public:
+    bool open(const std::string &path)
+    {
+        m_directory = path.substr(0, path.find_last_of("/\\") + 1);
+        if (!m_file.open(path))
+            return fail(path, "cannot open the file");
+
+        const char *json = (const char *)m_file.data();
+        size_t jsonLength = m_file.size();
+        const uint8_t *glbBinary = nullptr;
+        size_t glbBinaryLength = 0;
+        const uint32_t *header = m_file.at<uint32_t>(0, 3);
+        if (header && header[0] == GLB_MAGIC)
+        {
+            // GLB: 12 byte header, then chunks (length, type, data), the first one is the JSON
+            if (header[1] != 2 || header[2] > m_file.size())
+                return fail(path, "unsupported GLB version");
+            size_t offset = 12;
+            json = nullptr;
+            while (const uint32_t *chunk = m_file.at<uint32_t>(offset, 2))
+            {
+                const uint8_t *chunkData = m_file.at<uint8_t>(offset + 8, chunk[0]);
+                if (!chunkData)
+                    return fail(path, "truncated GLB chunk");
+                if (chunk[1] == GLB_CHUNK_JSON && !json)
+                {
+                    json = (const char *)chunkData;
+                    jsonLength = chunk[0];
+                }
+                else if (chunk[1] == GLB_CHUNK_BIN && !glbBinary)
+                {
+                    glbBinary = chunkData;
+                    glbBinaryLength = chunk[0];
+                }
+                offset += 8 + ((chunk[0] + 3) & ~3u);
+            }
+            if (!json)
+                return fail(path, "GLB without JSON chunk");
+        }
+
+        if (!parseJson(json, jsonLength, m_json))
+            return fail(path, "invalid JSON");
+        if (m_json["asset"]["version"].asString().substr(0, 2) != "2.")
+            return fail(path, "only glTF 2.x is supported");
+
+        // buffers: the GLB binary chunk (buffer without uri) or external files, mapped as a whole
+        const JsonValue &buffers = m_json["buffers"];
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            const JsonValue &buffer = buffers[i];
+            size_t byteLength = (size_t)buffer["byteLength"].asNumber();
+            if (!buffer.has("uri"))
+            {
+                if (!glbBinary || glbBinaryLength < byteLength)
+                    return fail(path, "missing GLB binary chunk");
+                m_buffers.push_back({glbBinary, byteLength});
+                continue;
+            }
+            const std::string &uri = buffer["uri"].asString();
+            if (uri.compare(0, 5, "data:") == 0)
+                return fail(path, "data URIs are not supported");
+            m_bufferFiles.push_back(std::make_unique<MappedFile>());
+            if (!m_bufferFiles.back()->open(m_directory + uri) || m_bufferFiles.back()->size() < byteLength)
+                return fail(path, ("cannot map buffer " + uri).c_str());
+            m_buffers.push_back({m_bufferFiles.back()->data(), byteLength});
+        }
+        return true;
+    }
+
+    const JsonValue &json() const { return m_json; }
+    const std::string &directory() const { return m_directory; }
+
+    // bytes of the file and all buffers that are mapped (not necessarily resident)
+    size_t MappedBytes() const
+    {
+        size_t bytes = m_file.size();
+        for (auto &file : m_bufferFiles)
+            bytes += file->size();
+        return bytes;
+    }
+
+    // the accessor with the given index, invalid if it does not exist or points outside of its buffer
+    GltfAccessor accessor(int index) const
+    {
+        GltfAccessor result;
+        const JsonValue &a = m_json["accessors"][(size_t)index];
+        if (index < 0 || a.isNull() || a.has("sparse"))
+            return result;
+        int components = gltfComponentCount(a["type"].asString());
+        size_t componentSize = gltfComponentSize(a["componentType"].asInt());
+        size_t count = (size_t)a["count"].asNumber();
+        const uint8_t *data;
+        size_t size, stride;
+        if (components == 0 || componentSize == 0 || !bufferView(a["bufferView"].asInt(), data, size, stride))
+            return result;
+
+        size_t elementSize = components * componentSize;
+        size_t offset = (size_t)a["byteOffset"].asNumber();
+        if (stride == 0)
+            stride = elementSize;
+        if (count > 0 && (offset > size || (count - 1) * stride + elementSize > size - offset))
+            return result;
+
+        result.data = data + offset;
+        result.count = count;
+        result.stride = stride;
+        result.componentType = a["componentType"].asInt();
+        result.components = components;
+        result.normalized = a["normalized"].boolean;
+        return result;
+    }
+
+    // the encoded bytes of an image (PNG/JPEG): embedded in a buffer view, or an external file (then only
+    // externalPath is set, relative to the working directory)
+    bool image(int index, const uint8_t *&data, size_t &size, std::string &externalPath) const
+    {
+        const JsonValue &image = m_json["images"][(size_t)index];
+        data = nullptr;
+        size = 0;
+        externalPath.clear();
+        if (image.has("bufferView"))
+        {
+            size_t stride;
+            return bufferView(image["bufferView"].asInt(), data, size, stride);
+        }
+        const std::string &uri = image["uri"].asString();
+        if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+            return false;
+        externalPath = m_directory + uri;
+        return true;
+    }
+
+private:
+    MappedFile m_file;
+    std::vector<std::unique_ptr<MappedFile>> m_bufferFiles;
+    std::vector<std::pair<const uint8_t *, size_t>> m_buffers;
+    JsonValue m_json;
+    std::string m_directory;
+
+    bool fail(const std::string &path, const char *reason)
+    {
+        std::cout << "ERROR::GLTF:: " << path << ": " << reason << std::endl;
+        return false;
+    }
+
+    bool bufferView(int index, const uint8_t *&data, size_t &size, size_t &stride) const
+    {
+        const JsonValue &view = m_json["bufferViews"][(size_t)index];
+        int buffer = view["buffer"].asInt();
+        if (index < 0 || view.isNull() || buffer < 0 || (size_t)buffer >= m_buffers.size())
+            return false;
+        size_t offset = (size_t)view["byteOffset"].asNumber();
+        size = (size_t)view["byteLength"].asNumber();
+        stride = (size_t)view["byteStride"].asNumber();
+        if (offset > m_buffers[buffer].second || size > m_buffers[buffer].second - offset)
+            return false;
+        data = m_buffers[buffer].first + offset;
+        return true;
+    }
+};
+
+// the local transformation of a node (matrix, or translation * rotation * scale)
+// ---------------------------------------------------
+glm::mat4 gltfNodeTransform(const JsonValue &node)
+{
+    glm::mat4 result(1.0f);
+    if (node.has("matrix"))
+    {
+        const JsonValue &m = node["matrix"];
+        for (int column = 0; column < 4; column++)
+            for (int row = 0; row < 4; row++)
+                result[column][row] = (float)m[(size_t)(column * 4 + row)].asNumber(column == row ? 1.0 : 0.0);
+        return result;
+    }
+    const JsonValue &t = node["translation"], &r = node["rotation"], &s = node["scale"];
+    float x = (float)r[0].asNumber(0.0), y = (float)r[1].asNumber(0.0), z = (float)r[2].asNumber(0.0), w = (float)r[3].asNumber(1.0);
+    // rotation matrix of the unit quaternion (x, y, z, w), column major
+    glm::mat4 rotation(1.0f);
+    rotation[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w), 0.0f);
+    rotation[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w), 0.0f);
+    rotation[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y), 0.0f);
+    for (int c = 0; c < 3; c++)
+        rotation[c] *= (float)s[(size_t)c].asNumber(1.0);
+    rotation[3] = glm::vec4((float)t[0].asNumber(0.0), (float)t[1].asNumber(0.0), (float)t[2].asNumber(0.0), 1.0f);
+    return rotation;
+}
+
+// calls visit(mesh, worldTransform) for every node with a mesh in the default scene (depth first)
+// ---------------------------------------------------
+template <class F>
+void forEachGltfMesh(const GltfFile &file, F visit)
+{
+    const JsonValue &json = file.json();
+    const JsonValue &nodes = json["nodes"];
+    std::vector<int> roots;
+    const JsonValue &scene = json["scenes"][(size_t)std::max(0, json["scene"].asInt(0))];
+    for (size_t i = 0; i < scene["nodes"].size(); i++)
+        roots.push_back(scene["nodes"][i].asInt());
+    if (!json.has("scenes")) // no scene: all nodes that are nobody's child
+    {
+        std::vector<bool> isChild(nodes.size(), false);
+        for (size_t n = 0; n < nodes.size(); n++)
+            for (size_t c = 0; c < nodes[n]["children"].size(); c++)
+                if ((size_t)nodes[n]["children"][c].asInt() < isChild.size())
+                    isChild[nodes[n]["children"][c].asInt()] = true;
+        for (size_t n = 0; n < nodes.size(); n++)
+            if (!isChild[n])
+                roots.push_back((int)n);
+    }
+
+    std::vector<std::pair<int, glm::mat4>> stack;
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it)
+        stack.push_back({*it, glm::mat4(1.0f)});
+    size_t visited = 0;
+    while (!stack.empty() && visited++ < 4 * nodes.size() + 16) // bounded, in case of cyclic (invalid) files
+    {
+        auto [index, parent] = stack.back();
+        stack.pop_back();
+        const JsonValue &node = nodes[(size_t)index];
+        if (index < 0 || node.isNull())
+            continue;
+        glm::mat4 world = parent * gltfNodeTransform(node);
+        if (node.has("mesh"))
+            visit(json["meshes"][(size_t)node["mesh"].asInt()], world);
+        const JsonValue &children = node["children"];
+        for (size_t c = children.size(); c-- > 0;)
+            stack.push_back({children[c].asInt(), world});
+    }
+}
+
+// utility function for reading a triangle primitive into the Vertex/index arrays of a Mesh. The vertices are
+// gathered straight from the mapped accessors (transformed to world space) and tightly packed 32 bit indices are
+// copied as one block. Missing normals and tangents are computed.
+// ---------------------------------------------------
+bool readGltfPrimitive(const GltfFile &file, const JsonValue &primitive, const glm::mat4 &transform, vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    if (primitive["mode"].asInt(4) != 4) // TRIANGLES
+        return false;
+    const JsonValue &attributes = primitive["attributes"];
+    GltfAccessor positions = file.accessor(attributes["POSITION"].asInt());
+    GltfAccessor normals = file.accessor(attributes["NORMAL"].asInt());
+    GltfAccessor texCoords = file.accessor(attributes["TEXCOORD_0"].asInt());
+    GltfAccessor tangents = file.accessor(attributes["TANGENT"].asInt());
+    if (!positions.isValid() || positions.components != 3 || (normals.isValid() && normals.count != positions.count) ||
+        (texCoords.isValid() && texCoords.count != positions.count) || (tangents.isValid() && tangents.count != positions.count))
+        return false;
+
+    // indices
+    size_t vertexCount = positions.count;
+    if (primitive.has("indices"))
+    {
+        GltfAccessor index = file.accessor(primitive["indices"].asInt());
+        if (!index.isValid() || index.components != 1)
+            return false;
+        if (index.componentType == GLTF_UNSIGNED_INT && index.stride == 4)
+            indices.assign((const unsigned int *)index.data, (const unsigned int *)index.data + index.count);
+        else
+        {
+            indices.resize(index.count);
+            for (size_t i = 0; i < index.count; i++)
+                indices[i] = index.index(i);
+        }
+        for (unsigned int i : indices)
+            if (i >= vertexCount)
+                return false;
+    }
+    else
+    {
+        indices.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+            indices[i] = (unsigned int)i;
+    }
+    indices.resize(indices.size() - indices.size() % 3);
+
+    // vertices
+    vertices.resize(vertexCount);
+    bool packedPositions = positions.isPackedFloat(3), packedNormals = normals.isPackedFloat(3), packedTexCoords = texCoords.isPackedFloat(2);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        Vertex &v = vertices[i];
+        if (packedPositions)
+            std::memcpy(&v.Position, positions.data + i * 12, 12);
+        else
+            v.Position = glm::vec3(positions.get(i, 0), positions.get(i, 1), positions.get(i, 2));
+        if (packedNormals)
+            std::memcpy(&v.Normal, normals.data + i * 12, 12);
+        else if (normals.isValid())
+            v.Normal = glm::vec3(normals.get(i, 0), normals.get(i, 1), normals.get(i, 2));
+        else
+            v.Normal = glm::vec3(0.0f);
+        if (packedTexCoords)
+            std::memcpy(&v.TexCoords, texCoords.data + i * 8, 8);
+        else if (texCoords.isValid())
+            v.TexCoords = glm::vec2(texCoords.get(i, 0), texCoords.get(i, 1));
+        else
+            v.TexCoords = glm::vec2(0.0f);
+        if (tangents.isValid())
+        {
+            v.Tangent = glm::vec3(tangents.get(i, 0), tangents.get(i, 1), tangents.get(i, 2));
+            v.Bitangent = glm::cross(v.Normal, v.Tangent) * tangents.get(i, 3); // w: handedness
+        }
+    }
+
+    // node transformation (normals with the inverse transpose)
+    if (transform != glm::mat4(1.0f))
+    {
+        glm::mat3 linear = glm::mat3(transform);
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+        for (auto &v : vertices)
+        {
+            v.Position = glm::vec3(transform * glm::vec4(v.Position, 1.0f));
+            v.Normal = normalMatrix * v.Normal;
+            v.Tangent = linear * v.Tangent;
+            v.Bitangent = linear * v.Bitangent;
+        }
+    }
+
+    if (!normals.isValid()) // smooth normals from the area weighted face normals
+    {
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            glm::vec3 n = glm::cross(vertices[indices[i + 1]].Position - vertices[indices[i]].Position,
+                                     vertices[indices[i + 2]].Position - vertices[indices[i]].Position);
+            for (int k = 0; k < 3; k++)
+                vertices[indices[i + k]].Normal += n;
+        }
+    }
+    for (auto &v : vertices)
+    {
+        float length = glm::length(v.Normal);
+        v.Normal = length > 0.0f ? v.Normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+    if (!tangents.isValid())
+        computeTangents(vertices, indices);
+    return true;
+}
+
+#endif
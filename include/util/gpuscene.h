@@ -0,0 +1,330 @@
+#pragma once
+#ifndef GPUSCENE_H
+#define GPUSCENE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include <util/culling.h>
+#include <util/glstate.h>
+#include <util/material.h>
+#include <util/mesh.h>
+#include <util/mesharena.h>
+#include <util/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// GPU-driven rendering (OpenGL 4.3): the objects of a scene (a mesh of a MeshArena and a transform) are kept in a
+// shader storage buffer. Every frame a compute shader culls them against the frustum, and optionally against the
+// depth of the previous frame (HiZPyramid), and writes one DrawElementsIndirectCommand per object: one instance if
+// it is visible, none otherwise. The objects are sorted by material, so each material is drawn with a single
+// glMultiDrawElementsIndirect over its range of commands; the CPU neither tests nor touches the single objects.
+//
+// The shaders are gpucull.cs.glsl, hiz.cs.glsl and pbr.gpu.vs.glsl in excercise4. The vertex shader finds its
+// object through the per instance attribute GPU_OBJECT_ATTRIBUTE, which holds the object index (the command's
+// baseInstance), so no gl_DrawID or gl_BaseInstance (OpenGL 4.6) is needed.
+
+// the record glMultiDrawElementsIndirect reads per draw
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// an object as the shaders read it (std430, see gpucull.cs.glsl)
+struct GpuObject
+{
+    glm::mat4 model;
+    glm::vec4 boundsCenter; // model space, w unused
+    glm::vec4 boundsExtent; // half extent, w unused
+    GLuint count;           // indices of the mesh
+    GLuint firstIndex;      // in the arena
+    GLint baseVertex;
+    GLuint material;        // Material::ID
+};
+
+const GLuint GPU_OBJECT_ATTRIBUTE = 11; // location of the object index (after the instance attributes, see instancing.h)
+
+// shader storage buffer bindings of the scene
+const GLuint GPU_OBJECTS_BINDING = 0;
+const GLuint GPU_COMMANDS_BINDING = 1;
+
+// true if the context can run the GPU-driven path: compute shaders, shader storage buffers and multi-draw
+// indirect (OpenGL 4.3 core, see the version arguments of InitWindow)
+// ---------------------------------------------------
+bool gpuDrivenSupported()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool version = major > 4 || (major == 4 && minor >= 3);
+        supported = version && glDispatchCompute && glMultiDrawElementsIndirect && glBindBufferBase ? 1 : 0;
+    }
+    return supported == 1;
+}
+
+// The depth buffer of the last frame as a mip chain in which every texel holds the farthest depth of the texels it
+// covers. An object whose nearest depth is behind the farthest depth of all texels its screen rectangle touches is
+// hidden (gpucull.cs.glsl). The culling of a frame uses the depth of the frame before, so objects that come into
+// view behind a moving occluder can show up one frame late.
+class HiZPyramid
+{
+public:
+    HiZPyramid() {}
+    ~HiZPyramid() { release(); }
+
+    HiZPyramid(const HiZPyramid &) = delete;
+    HiZPyramid &operator=(const HiZPyramid &) = delete;
+
+    // copies the depth buffer of the default framebuffer and reduces it with the hiz.cs.glsl program (render thread
+    // only). Call after the scene is drawn.
+    void Build(Shader &downsample, int width, int height)
+    {
+        if (width <= 0 || height <= 0)
+            return;
+        if (width != m_width || height != m_height)
+            create(width, height);
+
+        // the copy has the format of the window's depth buffer (24 bit depth, 8 bit stencil, see InitWindow), a
+        // multisampled depth buffer is resolved by the blit
+        glState().BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glState().BindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        downsample.use();
+        glState().ActiveTexture(GL_TEXTURE0);
+        glState().BindTexture(GL_TEXTURE_2D, m_depth);
+        int levelWidth = width, levelHeight = height;
+        for (int level = 0; level < m_levels; level++)
+        {
+            // level 0 is read from the depth texture, the others from the level above
+            if (level > 0)
+                glBindImageTexture(0, m_pyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(1, m_pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            downsample.setInt("level", level);
+            glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            levelWidth = std::max(levelWidth / 2, 1);
+            levelHeight = std::max(levelHeight / 2, 1);
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    bool IsValid() const { return m_pyramid != 0; }
+    GLuint Texture() const { return m_pyramid; }
+
+private:
+    GLuint m_depth = 0, m_fbo = 0, m_pyramid = 0;
+    int m_width = 0, m_height = 0, m_levels = 0;
+
+    void create(int width, int height)
+    {
+        release();
+        m_width = width;
+        m_height = height;
+        m_levels = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+
+        glGenTextures(1, &m_depth);
+        glState().BindTexture(GL_TEXTURE_2D, m_depth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &m_fbo);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depth, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenTextures(1, &m_pyramid);
+        glState().BindTexture(GL_TEXTURE_2D, m_pyramid);
+        glTexStorage2D(GL_TEXTURE_2D, m_levels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    void release()
+    {
+        if (m_pyramid == 0)
+            return;
+        glState().ForgetFramebuffer(m_fbo);
+        glDeleteFramebuffers(1, &m_fbo);
+        glState().ForgetTexture(m_depth);
+        glState().ForgetTexture(m_pyramid);
+        glDeleteTextures(1, &m_depth);
+        glDeleteTextures(1, &m_pyramid);
+        m_depth = m_fbo = m_pyramid = 0;
+        m_width = m_height = m_levels = 0;
+    }
+};
+
+// The objects of a GPU-driven frame, see the top of this file. Objects are added once (Clear, Add) and uploaded on
+// the next Cull; every frame then only costs a dispatch and one multi-draw per material.
+class GpuScene
+{
+public:
+    unsigned int drawCalls = 0; // multi-draws issued by the last Draw
+
+    GpuScene() {}
+    ~GpuScene()
+    {
+        if (m_objectBuffer == 0)
+            return;
+        glDeleteBuffers(1, &m_objectBuffer);
+        glDeleteBuffers(1, &m_commandBuffer);
+        glDeleteBuffers(1, &m_indexBuffer);
+    }
+
+    GpuScene(const GpuScene &) = delete;
+    GpuScene &operator=(const GpuScene &) = delete;
+
+    void Clear()
+    {
+        m_objects.clear();
+        m_materials.clear();
+        m_dirty = true;
+    }
+
+    // adds a mesh of the arena (at full resolution) with its transform. The mesh has to stay alive while the
+    // scene is drawn, its material is bound for its bucket.
+    void Add(const Mesh &mesh, const MeshArena::Range &range, const glm::mat4 &model)
+    {
+        GpuObject object;
+        object.model = model;
+        object.boundsCenter = glm::vec4(mesh.boundsMin + mesh.boundsExtent * 0.5f, 1.0f);
+        object.boundsExtent = glm::vec4(mesh.boundsExtent * 0.5f, 0.0f);
+        object.count = (GLuint)mesh.lods[0].indexCount;
+        object.firstIndex = range.firstIndex + (GLuint)mesh.lods[0].indexOffset;
+        object.baseVertex = range.baseVertex;
+        object.material = mesh.material.ID();
+        m_objects.push_back(object);
+        m_materials.push_back(&mesh.material);
+    }
+
+    size_t Size() const { return m_objects.size(); }
+    size_t Buckets() const { return m_buckets.size(); }
+
+    // writes the draw commands of the frame with the gpucull.cs.glsl program. viewProjection and hiZ are only
+    // needed for occlusion culling (hiZ nullptr: frustum culling only).
+    void Cull(Shader &cullShader, const Frustum &frustum, const glm::mat4 &viewProjection, const HiZPyramid *hiZ = nullptr)
+    {
+        if (m_dirty)
+            upload();
+        if (m_objects.empty())
+            return;
+        cullShader.use();
+        cullShader.setInt("objectCount", (int)m_objects.size());
+        glUniform4fv(cullShader.location("planes[0]"), 6, &frustum.planes[0][0]);
+        bool occlusion = hiZ && hiZ->IsValid();
+        cullShader.setBool("occlusionCulling", occlusion);
+        if (occlusion)
+        {
+            cullShader.setMat4("viewProjection", viewProjection);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, hiZ->Texture());
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_OBJECTS_BINDING, m_objectBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_COMMANDS_BINDING, m_commandBuffer);
+        glDispatchCompute(((GLuint)m_objects.size() + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    }
+
+    // draws the commands of the last Cull from the arena, one glMultiDrawElementsIndirect per material. The shader
+    // (pbr.gpu.vs.glsl) has to be in use.
+    void Draw(Shader &shader, const MeshArena &arena)
+    {
+        drawCalls = 0;
+        if (m_objects.empty() || m_dirty)
+            return;
+        arena.Bind();
+        glBindBuffer(GL_ARRAY_BUFFER, m_indexBuffer);
+        glEnableVertexAttribArray(GPU_OBJECT_ATTRIBUTE);
+        glVertexAttribIPointer(GPU_OBJECT_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)0);
+        glVertexAttribDivisor(GPU_OBJECT_ATTRIBUTE, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_OBJECTS_BINDING, m_objectBuffer);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+        for (auto &bucket : m_buckets)
+        {
+            bucket.material->Bind(shader);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(bucket.first * sizeof(DrawElementsIndirectCommand)),
+                                        (GLsizei)bucket.count, 0);
+            drawCalls++;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        // the arena is also drawn without the scene, there the attribute would read past the buffer
+        glDisableVertexAttribArray(GPU_OBJECT_ATTRIBUTE);
+    }
+
+private:
+    struct Bucket
+    {
+        const Material *material;
+        size_t first, count; // range of the commands
+    };
+    std::vector<GpuObject> m_objects;
+    std::vector<const Material *> m_materials; // per object
+    std::vector<Bucket> m_buckets;
+    GLuint m_objectBuffer = 0, m_commandBuffer = 0, m_indexBuffer = 0;
+    bool m_dirty = true;
+
+    // sorts the objects by material and creates the buffers: objects, commands (written by the culling) and the
+    // object index of each command for GPU_OBJECT_ATTRIBUTE
+    void upload()
+    {
+        m_dirty = false;
+        std::vector<uint32_t> order(m_objects.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return m_objects[a].material < m_objects[b].material; });
+        std::vector<GpuObject> objects;
+        std::vector<const Material *> materials;
+        objects.reserve(order.size());
+        materials.reserve(order.size());
+        m_buckets.clear();
+        for (uint32_t i : order)
+        {
+            if (m_buckets.empty() || m_objects[i].material != objects.back().material)
+                m_buckets.push_back({m_materials[i], objects.size(), 0});
+            m_buckets.back().count++;
+            objects.push_back(m_objects[i]);
+            materials.push_back(m_materials[i]);
+        }
+        m_objects.swap(objects);
+        m_materials.swap(materials);
+        if (m_objects.empty())
+            return;
+
+        if (m_objectBuffer == 0)
+        {
+            glGenBuffers(1, &m_objectBuffer);
+            glGenBuffers(1, &m_commandBuffer);
+            glGenBuffers(1, &m_indexBuffer);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_objects.size() * sizeof(GpuObject), m_objects.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_objects.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        std::vector<GLuint> indices(m_objects.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        glBindBuffer(GL_ARRAY_BUFFER, m_indexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,321 @@
+#pragma once
+#ifndef HDRIMAGE_H
+#define HDRIMAGE_H
+
+#undef STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <util/mappedfile.h>
+#include <util/threadpool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HDR_SSE2 1
+#endif
+
+// Radiance .hdr (RGBE) reader for environment maps. The file is memory-mapped; a first pass walks the run length
+// headers to find where every scanline starts (only the counts are read, the pixel bytes are skipped), then the
+// scanlines are decoded in parallel on the worker pool. RGBE is converted to half floats four pixels at a time
+// (SSE2, scalar elsewhere), so the texture can be uploaded as GL_RGB16F: half the size of GL_RGB32F and no float
+// image in between. Files this reader does not handle (old style run length encoding) are read with stbi_loadf.
+
+// the decoded pixels of a .hdr file: RGB half floats, row by row (top row first unless flipped)
+struct HdrImage
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    std::vector<uint16_t> pixels;
+
+    bool isValid() const { return width > 0 && height > 0 && pixels.size() == (size_t)width * height * 3; }
+};
+
+// float to IEEE half with round to nearest even, overflow gives infinity (F. Giesen, float_to_half_fast3_rtne)
+// ---------------------------------------------------
+uint16_t floatToHalf(float value)
+{
+    uint32_t f;
+    std::memcpy(&f, &value, 4);
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+    uint16_t half;
+    if (f >= 0x47800000u) // too large for a half: infinity, or NaN
+        half = f > 0x7f800000u ? 0x7e00 : 0x7c00;
+    else if (f < 0x38800000u) // result is a subnormal (or zero): let the float adder do the rounding
+    {
+        float denormal, magic = 0.5f;
+        std::memcpy(&denormal, &f, 4);
+        denormal += magic;
+        uint32_t bits;
+        std::memcpy(&bits, &denormal, 4);
+        half = (uint16_t)(bits - 0x3f000000u);
+    }
+    else
+    {
+        uint32_t mantissaOdd = (f >> 13) & 1;
+        f += 0xc8000fffu; // rebias the exponent (15 - 127) and round
+        f += mantissaOdd;
+        half = (uint16_t)(f >> 13);
+    }
+    return half | (uint16_t)(sign >> 16);
+}
+
+#ifdef HDR_SSE2
+// four non-negative floats to halves (same rounding as floatToHalf), one per 32 bit lane
+// ---------------------------------------------------
+__m128i floatToHalf4(__m128 value)
+{
+    const __m128i maxFloat = _mm_set1_epi32(0x47800000);   // from here on infinity
+    const __m128i minNormal = _mm_set1_epi32(0x38800000);  // below this a subnormal half
+    const __m128 subnormalMagic = _mm_set1_ps(0.5f);
+    const __m128i normalBias = _mm_set1_epi32((int)0xc8000fffu);
+
+    __m128i bits = _mm_castps_si128(value);
+    __m128i regular = _mm_cmpgt_epi32(maxFloat, bits);
+    __m128i subnormal = _mm_cmpgt_epi32(minNormal, bits);
+
+    __m128i subnormalHalf = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(value, subnormalMagic)), _mm_castps_si128(subnormalMagic));
+    __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(bits, 31 - 13), 31); // -1 if odd
+    __m128i normalHalf = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(bits, normalBias), mantissaOdd), 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(subnormal, subnormalHalf), _mm_andnot_si128(subnormal, normalHalf));
+    return _mm_or_si128(_mm_and_si128(regular, finite), _mm_andnot_si128(regular, _mm_set1_epi32(0x7c00)));
+}
+
+// four bytes to four 32 bit lanes
+// ---------------------------------------------------
+__m128i loadBytes4(const uint8_t *p)
+{
+    uint32_t word;
+    std::memcpy(&word, p, 4);
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)word), zero), zero);
+}
+#endif
+
+// converts a scanline from planar RGBE (width bytes of each channel) to interleaved RGB halves.
+// A pixel is mantissa * 2^(exponent - 136) like in stb_image; exponent 0 is black.
+// ---------------------------------------------------
+void rgbeToHalf(const uint8_t *r, const uint8_t *g, const uint8_t *b, const uint8_t *e, int width, uint16_t *dst)
+{
+    int x = 0;
+#ifdef HDR_SSE2
+    const __m128i bias = _mm_set1_epi32(9); // 2^(e - 136) as float bits: (e - 136 + 127) << 23
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i exponent = _mm_sub_epi32(loadBytes4(e + x), bias);
+        // results that small (e <= 9, also e == 0) are far below the smallest half, they become 0
+        __m128i scaleBits = _mm_and_si128(_mm_slli_epi32(exponent, 23), _mm_cmpgt_epi32(exponent, _mm_setzero_si128()));
+        __m128 scale = _mm_castsi128_ps(scaleBits);
+
+        __m128i red = floatToHalf4(_mm_mul_ps(_mm_cvtepi32_ps(loadBytes4(r + x)), scale));
+        __m128i green = floatToHalf4(_mm_mul_ps(_mm_cvtepi32_ps(loadBytes4(g + x)), scale));
+        __m128i blue = floatToHalf4(_mm_mul_ps(_mm_cvtepi32_ps(loadBytes4(b + x)), scale));
+
+        // halves are at most 0x7c00, so the signed saturation of the pack never kicks in
+        alignas(16) uint16_t planar[16];
+        _mm_store_si128((__m128i *)planar, _mm_packs_epi32(red, green));
+        _mm_store_si128((__m128i *)(planar + 8), _mm_packs_epi32(blue, blue));
+        uint16_t *out = dst + x * 3;
+        for (int i = 0; i < 4; i++)
+        {
+            out[i * 3 + 0] = planar[i];
+            out[i * 3 + 1] = planar[4 + i];
+            out[i * 3 + 2] = planar[8 + i];
+        }
+    }
+#endif
+    for (; x < width; x++)
+    {
+        float scale = 0.0f;
+        if (e[x] > 9)
+        {
+            uint32_t scaleBits = (uint32_t)(e[x] - 9) << 23;
+            std::memcpy(&scale, &scaleBits, 4);
+        }
+        dst[x * 3 + 0] = floatToHalf(r[x] * scale);
+        dst[x * 3 + 1] = floatToHalf(g[x] * scale);
+        dst[x * 3 + 2] = floatToHalf(b[x] * scale);
+    }
+}
+
+// reads one header line of the mapped file, returns false at the end of the file
+// ---------------------------------------------------
+bool hdrHeaderLine(const MappedFile &file, size_t &offset, std::string &line)
+{
+    const uint8_t *begin = file.data() + offset;
+    const uint8_t *end = (const uint8_t *)std::memchr(begin, '\n', file.size() - offset);
+    if (!end)
+        return false;
+    line.assign((const char *)begin, end - begin);
+    offset += (end - begin) + 1;
+    return true;
+}
+
+// a scanline is run length encoded (new style) if it starts with 2, 2 and its width
+// ---------------------------------------------------
+bool hdrScanlineEncoded(const uint8_t *p, int width)
+{
+    return width >= 8 && width < 32768 && p[0] == 2 && p[1] == 2 && (p[2] & 0x80) == 0 && ((p[2] << 8) | p[3]) == width;
+}
+
+// walks over one scanline starting at offset (counts only) and returns the offset behind it, 0 if it is broken
+// or uses the old style encoding
+// ---------------------------------------------------
+size_t skipHdrScanline(const uint8_t *data, size_t size, size_t offset, int width)
+{
+    if (size - offset < 4)
+        return 0;
+    const uint8_t *p = data + offset;
+    if (!hdrScanlineEncoded(p, width)) // flat RGBE pixels
+    {
+        if (size - offset < (size_t)width * 4 || (p[0] == 1 && p[1] == 1 && p[2] == 1))
+            return 0;
+        return offset + (size_t)width * 4;
+    }
+    offset += 4;
+    for (int channel = 0; channel < 4; channel++)
+    {
+        for (int x = 0; x < width;)
+        {
+            if (offset >= size)
+                return 0;
+            int count = data[offset++];
+            size_t bytes = count > 128 ? 1 : count;
+            if (count > 128)
+                count -= 128;
+            if (count == 0 || count > width - x || size - offset < bytes)
+                return 0;
+            offset += bytes;
+            x += count;
+        }
+    }
+    return offset;
+}
+
+// decodes one validated scanline (see skipHdrScanline) into the four planes of planar (width bytes each)
+// ---------------------------------------------------
+void decodeHdrScanline(const uint8_t *p, int width, uint8_t *planar)
+{
+    if (!hdrScanlineEncoded(p, width))
+    {
+        for (int x = 0; x < width; x++)
+            for (int channel = 0; channel < 4; channel++)
+                planar[channel * width + x] = p[x * 4 + channel];
+        return;
+    }
+    p += 4;
+    for (int channel = 0; channel < 4; channel++)
+    {
+        uint8_t *out = planar + channel * width;
+        for (int x = 0; x < width;)
+        {
+            int count = *p++;
+            if (count > 128)
+            {
+                count -= 128;
+                std::memset(out + x, *p++, count);
+            }
+            else
+            {
+                std::memcpy(out + x, p, count);
+                p += count;
+            }
+            x += count;
+        }
+    }
+}
+
+// reads a .hdr file with stbi_loadf and converts it to halves (files with the old style encoding)
+// ---------------------------------------------------
+HdrImage decodeHdrImageStb(const std::string &path, bool flipVertically)
+{
+    HdrImage image;
+    image.path = path;
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    int components;
+    float *data = stbi_loadf(path.c_str(), &image.width, &image.height, &components, 3);
+    stbi_set_flip_vertically_on_load_thread(false);
+    if (!data)
+        return image;
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    for (size_t i = 0; i < image.pixels.size(); i++)
+        image.pixels[i] = floatToHalf(data[i]);
+    stbi_image_free(data);
+    return image;
+}
+
+// utility function for decoding a Radiance .hdr file to RGB halves. Does not use OpenGL, so it is safe to call
+// from worker threads. Returns an invalid image (see HdrImage::isValid) if the file cannot be read.
+// ---------------------------------------------------
+HdrImage decodeHdrImage(const std::string &path, bool flipVertically)
+{
+    HdrImage image;
+    image.path = path;
+    MappedFile file(path);
+    if (!file.isOpen())
+        return image;
+
+    size_t offset = 0;
+    std::string line;
+    if (!hdrHeaderLine(file, offset, line) || (line != "#?RADIANCE" && line != "#?RGBE"))
+        return image;
+    while (hdrHeaderLine(file, offset, line) && !line.empty())
+    {
+        if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+            return image; // XYZE is not supported (stb does not either)
+    }
+    int width = 0, height = 0;
+    if (!hdrHeaderLine(file, offset, line) || std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 ||
+        width <= 0 || height <= 0)
+        return image; // other orientations are not supported (stb does not either)
+
+    // where the scanlines start, the only part that has to run in order
+    std::vector<size_t> scanlines(height + 1);
+    scanlines[0] = offset;
+    for (int y = 0; y < height; y++)
+    {
+        scanlines[y + 1] = skipHdrScanline(file.data(), file.size(), scanlines[y], width);
+        if (scanlines[y + 1] == 0)
+            return decodeHdrImageStb(path, flipVertically);
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels.resize((size_t)width * height * 3);
+    const int rowsPerTask = 16;
+    parallelFor((height + rowsPerTask - 1) / rowsPerTask, [&](size_t task)
+                {
+        std::vector<uint8_t> planar((size_t)width * 4);
+        int first = (int)task * rowsPerTask;
+        int last = std::min(height, first + rowsPerTask);
+        for (int y = first; y < last; y++)
+        {
+            decodeHdrScanline(file.data() + scanlines[y], width, planar.data());
+            int row = flipVertically ? height - 1 - y : y;
+            rgbeToHalf(&planar[0], &planar[width], &planar[2 * (size_t)width], &planar[3 * (size_t)width], width,
+                       &image.pixels[(size_t)row * width * 3]);
+        } });
+    return image;
+}
+
+// checks the file extension for Radiance images
+// ---------------------------------------------------
+bool isHdrFile(const std::string &path)
+{
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c)
+                   { return (char)std::tolower(c); });
+    return ext == "hdr";
+}
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Per instance data of instanced draws. The attributes follow the vertex attributes of Mesh (locations 0-4):
+//
+//  layout (location = 5) in mat4 aInstanceModel;    // locations 5-8, one per column
+//  layout (location = 9) in vec4 aInstanceColor;    // pbr: albedo, light: color
+//  layout (location = 10) in vec4 aInstanceMaterial; // metallic, roughness, ao
+//
+// (see pbr.instanced.vs.glsl and light.instanced.vs.glsl in excercise4)
+struct InstanceData
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec4 color = glm::vec4(1.0f);
+    glm::vec4 material = glm::vec4(0.0f, 0.5f, 1.0f, 0.0f);
+};
+
+const GLuint INSTANCE_ATTRIBUTE = 5; // location of the first instance attribute
+
+// A vertex buffer holding the InstanceData of an instanced draw. Attach adds the instance attributes to the VAO
+// that is bound, they advance once per instance (glVertexAttribDivisor).
+class InstanceBuffer
+{
+public:
+    InstanceBuffer() {}
+    ~InstanceBuffer()
+    {
+        if (m_vbo != 0)
+            glDeleteBuffers(1, &m_vbo);
+    }
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // replaces the instances (render thread only). The buffer grows when needed, otherwise its storage is orphaned,
+    // so draws from the previous data that are still in flight do not stall the upload.
+    void Upload(const InstanceData *instances, size_t count)
+    {
+        if (m_vbo == 0)
+            glGenBuffers(1, &m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        m_capacity = std::max(m_capacity, count);
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        if (count > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_count = count;
+    }
+    void Upload(const std::vector<InstanceData> &instances) { Upload(instances.data(), instances.size()); }
+
+    // points the instance attributes of the bound VAO to this buffer. Called for every instanced draw: the
+    // attributes are part of the VAO, so another buffer may have been attached since.
+    void Attach() const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + column);
+            glVertexAttribPointer(INSTANCE_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void *)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_ATTRIBUTE + column, 1);
+        }
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + 4);
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE + 4, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, color));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE + 4, 1);
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + 5);
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE + 5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, material));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE + 5, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    size_t Count() const { return m_count; }
+    GLuint ID() const { return m_vbo; }
+
+private:
+    GLuint m_vbo = 0;
+    size_t m_count = 0, m_capacity = 0;
+};
+
+#endif
@@ -0,0 +1,322 @@
+#pragma once
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON reader (enough for glTF): parses a document into a tree of JsonValues. Numbers are doubles,
+// strings are unescaped (\uXXXX is written as UTF-8), object members keep their order. No writer.
+class JsonValue
+{
+public:
+    enum Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> items;                            // Array
+    std::vector<std::pair<std::string, JsonValue>> members; // Object
+
+    bool isNull() const { return type == Null; }
+    bool has(const char *key) const { return find(key) != nullptr; }
+    size_t size() const { return type == Array ? items.size() : members.size(); }
+
+    // object member, or a null value if there is none (so lookups can be chained)
+    const JsonValue &operator[](const char *key) const
+    {
+        const JsonValue *value = find(key);
+        return value ? *value : null();
+    }
+
+    // array item, or a null value if the index is out of range
+    const JsonValue &operator[](size_t index) const { return index < items.size() ? items[index] : null(); }
+    const JsonValue &operator[](int index) const { return index >= 0 ? (*this)[(size_t)index] : null(); }
+
+    double asNumber(double fallback = 0.0) const { return type == Number ? number : fallback; }
+    int asInt(int fallback = -1) const { return type == Number ? (int)number : fallback; }
+    const std::string &asString() const { return string; }
+
+    const JsonValue *find(const char *key) const
+    {
+        for (auto &member : members)
+            if (member.first == key)
+                return &member.second;
+        return nullptr;
+    }
+
+private:
+    static const JsonValue &null()
+    {
+        static const JsonValue value;
+        return value;
+    }
+};
+
+// recursive descent parser over a character range, see parseJson
+class JsonParser
+{
+public:
+    JsonParser(const char *begin, const char *end) : m_pos(begin), m_end(end) {}
+
+    bool parse(JsonValue &value)
+    {
+        if (!parseValue(value, 0))
+            return false;
+        skipSpace();
+        return m_pos == m_end;
+    }
+
+private:
+    static const int MAX_DEPTH = 256;
+    const char *m_pos;
+    const char *m_end;
+
+    void skipSpace()
+    {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\t' || *m_pos == '\n' || *m_pos == '\r'))
+            m_pos++;
+    }
+
+    bool consume(const char *literal)
+    {
+        size_t length = std::strlen(literal);
+        if ((size_t)(m_end - m_pos) < length || std::strncmp(m_pos, literal, length) != 0)
+            return false;
+        m_pos += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue &value, int depth)
+    {
+        skipSpace();
+        if (m_pos == m_end || depth > MAX_DEPTH)
+            return false;
+        switch (*m_pos)
+        {
+        case '{':
+            return parseObject(value, depth);
+        case '[':
+            return parseArray(value, depth);
+        case '"':
+            value.type = JsonValue::String;
+            return parseString(value.string);
+        case 't':
+            value.type = JsonValue::Bool;
+            value.boolean = true;
+            return consume("true");
+        case 'f':
+            value.type = JsonValue::Bool;
+            return consume("false");
+        case 'n':
+            return consume("null");
+        default:
+            return parseNumber(value);
+        }
+    }
+
+    bool parseObject(JsonValue &value, int depth)
+    {
+        value.type = JsonValue::Object;
+        m_pos++; // {
+        skipSpace();
+        if (m_pos < m_end && *m_pos == '}')
+        {
+            m_pos++;
+            return true;
+        }
+        while (true)
+        {
+            skipSpace();
+            std::string key;
+            if (m_pos == m_end || *m_pos != '"' || !parseString(key))
+                return false;
+            skipSpace();
+            if (m_pos == m_end || *m_pos++ != ':')
+                return false;
+            value.members.emplace_back(std::move(key), JsonValue());
+            if (!parseValue(value.members.back().second, depth + 1))
+                return false;
+            skipSpace();
+            if (m_pos == m_end)
+                return false;
+            char c = *m_pos++;
+            if (c == '}')
+                return true;
+            if (c != ',')
+                return false;
+        }
+    }
+
+    bool parseArray(JsonValue &value, int depth)
+    {
+        value.type = JsonValue::Array;
+        m_pos++; // [
+        skipSpace();
+        if (m_pos < m_end && *m_pos == ']')
+        {
+            m_pos++;
+            return true;
+        }
+        while (true)
+        {
+            value.items.emplace_back();
+            if (!parseValue(value.items.back(), depth + 1))
+                return false;
+            skipSpace();
+            if (m_pos == m_end)
+                return false;
+            char c = *m_pos++;
+            if (c == ']')
+                return true;
+            if (c != ',')
+                return false;
+        }
+    }
+
+    bool parseNumber(JsonValue &value)
+    {
+        // strtod needs a terminated string, numbers are short so copy them
+        char buffer[64];
+        size_t length = 0;
+        while (m_pos + length < m_end && length < sizeof(buffer) - 1 && std::strchr("+-0123456789.eE", m_pos[length]))
+            length++;
+        if (length == 0)
+            return false;
+        std::memcpy(buffer, m_pos, length);
+        buffer[length] = 0;
+        char *parsed;
+        value.type = JsonValue::Number;
+        value.number = std::strtod(buffer, &parsed);
+        m_pos += length;
+        return parsed == buffer + length;
+    }
+
+    static void appendUtf8(std::string &str, unsigned int codepoint)
+    {
+        if (codepoint < 0x80)
+            str += (char)codepoint;
+        else if (codepoint < 0x800)
+        {
+            str += (char)(0xC0 | (codepoint >> 6));
+            str += (char)(0x80 | (codepoint & 0x3F));
+        }
+        else if (codepoint < 0x10000)
+        {
+            str += (char)(0xE0 | (codepoint >> 12));
+            str += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+            str += (char)(0x80 | (codepoint & 0x3F));
+        }
+        else
+        {
+            str += (char)(0xF0 | (codepoint >> 18));
+            str += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+            str += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+            str += (char)(0x80 | (codepoint & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned int &value)
+    {
+        if (m_end - m_pos < 4)
+            return false;
+        value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = *m_pos++;
+            value <<= 4;
+            if (c >= '0' && c <= '9')
+                value |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                value |= c - 'A' + 10;
+            else
+                return false;
+        }
+        return true;
+    }
+
+    bool parseString(std::string &str)
+    {
+        m_pos++; // "
+        while (m_pos < m_end)
+        {
+            char c = *m_pos++;
+            if (c == '"')
+                return true;
+            if (c != '\\')
+            {
+                str += c;
+                continue;
+            }
+            if (m_pos == m_end)
+                return false;
+            c = *m_pos++;
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                str += c;
+                break;
+            case 'b':
+                str += '\b';
+                break;
+            case 'f':
+                str += '\f';
+                break;
+            case 'n':
+                str += '\n';
+                break;
+            case 'r':
+                str += '\r';
+                break;
+            case 't':
+                str += '\t';
+                break;
+            case 'u':
+            {
+                unsigned int codepoint;
+                if (!parseHex4(codepoint))
+                    return false;
+                if (codepoint >= 0xD800 && codepoint < 0xDC00) // surrogate pair
+                {
+                    unsigned int low;
+                    if (!consume("\\u") || !parseHex4(low) || low < 0xDC00 || low > 0xDFFF)
+                        return false;
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(str, codepoint);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+};
+
+// utility function for parsing a JSON document, returns false on syntax errors
+// ---------------------------------------------------
+bool parseJson(const char *text, size_t length, JsonValue &result)
+{
+    result = JsonValue();
+    JsonParser parser(text, text + length);
+    return parser.parse(result);
+}
+
+#endif
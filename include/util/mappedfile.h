@@ -0,0 +1,175 @@
+#pragma once
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <filesystem>
+
+// 64 bit FNV-1a hash, used to fingerprint source files and shader sources
+// ---------------------------------------------------
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// read-only memory mapping of a whole file. The mapping lives as long as the object.
+class MappedFile
+{
+public:
+    MappedFile() {}
+    MappedFile(const std::string &path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path)
+    {
+        close();
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        m_size = (size_t)size.QuadPart;
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping == NULL)
+        {
+            close();
+            return false;
+        }
+        m_data = (const unsigned char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        m_fd = ::open(path.c_str(), O_RDONLY);
+        if (m_fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(m_fd, &st) != 0 || st.st_size == 0)
+        {
+            close();
+            return false;
+        }
+        m_size = (size_t)st.st_size;
+        void *ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        m_data = (ptr == MAP_FAILED) ? nullptr : (const unsigned char *)ptr;
+#endif
+        if (!m_data)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_mapping = NULL;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data)
+            munmap((void *)m_data, m_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    bool isOpen() const { return m_data != nullptr; }
+    const unsigned char *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    // returns a typed pointer into the mapping, or nullptr if the range is outside of the file
+    template <class T>
+    const T *at(size_t offset, size_t count = 1) const
+    {
+        if (!m_data || offset > m_size || count * sizeof(T) > m_size - offset)
+            return nullptr;
+        return (const T *)(m_data + offset);
+    }
+
+private:
+    const unsigned char *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = NULL;
+#else
+    int m_fd = -1;
+#endif
+};
+
+// hashes the whole content of a file (0 if the file cannot be read)
+// ---------------------------------------------------
+uint64_t hashFile(const std::string &path)
+{
+    MappedFile file(path);
+    if (!file.isOpen())
+        return 0;
+    return hashBytes(file.data(), file.size());
+}
+
+// utility function to get the last write time of a file as a plain number (0 if it does not exist)
+// ---------------------------------------------------
+int64_t fileTimestamp(const std::string &path)
+{
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    return (int64_t)time.time_since_epoch().count();
+}
+
+// utility function for overwriting a value at offset in an existing file, e.g. a field of a cache header. The
+// file must not be mapped at the same time (Windows does not allow writing to a mapped file).
+// ---------------------------------------------------
+template <class T>
+bool patchFile(const std::string &path, size_t offset, const T &value)
+{
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file)
+        return false;
+    file.seekp((std::streamoff)offset);
+    file.write((const char *)&value, sizeof(T));
+    return (bool)file;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#pragma once
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/glstate.h>
+#include <util/shader.h>
+#include <util/texturecache.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct Texture
+{
+    unsigned int id;
+    std::string type;
+    std::string path;
+};
+
+// Locations of a fixed list of uniforms, looked up once per shader program (Shader::programSerial) and kept for a
+// few programs, so drawing with several shaders in turn does not look them up again. After a reload the new
+// program replaces the oldest entry.
+class UniformLocations
+{
+public:
+    static const size_t MAX_PROGRAMS = 4;
+
+    UniformLocations() {}
+    explicit UniformLocations(std::vector<std::string> names) : m_names(std::move(names)) {}
+
+    // one location per name (-1 for uniforms the program does not have)
+    const GLint *Resolve(const Shader &shader)
+    {
+        for (auto &program : m_programs)
+            if (program.serial == shader.programSerial)
+                return program.locations.data();
+
+        Program *program;
+        if (m_programs.size() < MAX_PROGRAMS)
+        {
+            m_programs.emplace_back();
+            program = &m_programs.back();
+        }
+        else
+        {
+            program = &m_programs[m_oldest];
+            m_oldest = (m_oldest + 1) % MAX_PROGRAMS;
+        }
+        program->serial = shader.programSerial;
+        program->locations.resize(m_names.size());
+        for (size_t i = 0; i < m_names.size(); i++)
+            program->locations[i] = shader.location(m_names[i]);
+        return program->locations.data();
+    }
+
+    size_t Size() const { return m_names.size(); }
+
+private:
+    struct Program
+    {
+        unsigned int serial = 0;
+        std::vector<GLint> locations;
+    };
+    std::vector<std::string> m_names;
+    std::vector<Program> m_programs;
+    size_t m_oldest = 0;
+};
+
+// The textures of a mesh as a binding table: texture i is bound to unit i and its sampler is named by its type and
+// number (texture_diffuse1, texture_diffuse2, texture_specular1, ...). The names are built once here and their
+// locations once per shader program, so Bind only walks arrays: no string work and no glGetUniformLocation per draw.
+class Material
+{
+public:
+    Material() {}
+    explicit Material(const std::vector<Texture> &textures)
+    {
+        std::vector<std::string> samplers;
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr = 1;
+        unsigned int heightNr = 1;
+        for (auto &texture : textures)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            std::string number;
+            if (texture.type == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (texture.type == "texture_specular")
+                number = std::to_string(specularNr++);
+            else if (texture.type == "texture_normal")
+                number = std::to_string(normalNr++);
+            else if (texture.type == "texture_height")
+                number = std::to_string(heightNr++);
+            samplers.push_back(texture.type + number);
+            m_textures.push_back(texture.id);
+        }
+        m_id = materialID(m_textures, samplers);
+        m_samplers = UniformLocations(std::move(samplers));
+    }
+
+    // binds the textures to consecutive units and sets the samplers of the shader (which has to be in use)
+    void Bind(const Shader &shader) const
+    {
+        if (m_textures.empty())
+            return;
+        const GLint *samplers = m_samplers.Resolve(shader);
+        for (size_t unit = 0; unit < m_textures.size(); unit++)
+        {
+            glState().ActiveTexture(GL_TEXTURE0 + (GLenum)unit);
+            glUniform1i(samplers[unit], (GLint)unit);
+            glState().BindTexture(GL_TEXTURE_2D, m_textures[unit]);
+        }
+    }
+
+    bool Empty() const { return m_textures.empty(); }
+    // number of the material: the same for all materials that bind the same textures to the same samplers (so
+    // binding one after the other can be skipped, see RenderQueue), 0 for materials without textures. Textures are
+    // identified by their content (texture cache, other textures by their name), so a name the driver reuses after
+    // a cached texture was freed does not make two materials equal.
+    unsigned int ID() const { return m_id; }
+
+private:
+    unsigned int m_id = 0;
+    std::vector<GLuint> m_textures; // by unit
+    mutable UniformLocations m_samplers; // locations are looked up on the first Bind with a program
+
+    static unsigned int materialID(const std::vector<GLuint> &textures, const std::vector<std::string> &samplers)
+    {
+        if (textures.empty())
+            return 0;
+        static std::map<std::string, unsigned int> ids;
+        static std::mutex idsMutex; // meshes may be created on worker threads
+        std::string key;
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            std::string content = textureCache().ContentKey(textures[i]);
+            key += (content.empty() ? "gl" + std::to_string(textures[i]) : content) + ":" + samplers[i] + ";";
+        }
+        std::lock_guard<std::mutex> lock(idsMutex);
+        auto found = ids.find(key);
+        if (found != ids.end())
+            return found->second;
+        unsigned int id = (unsigned int)ids.size() + 1;
+        ids[key] = id;
+        return id;
+    }
+};
+
+#endif
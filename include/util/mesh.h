@@ -5,11 +5,18 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <util/glstate.h>
+#include <util/instancing.h>
+#include <util/material.h>
 #include <util/shader.h>
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
 using namespace std;
 
 struct Vertex
@@ -26,13 +33,128 @@ struct Vertex
     glm::vec3 Bitangent;
 };
 
-struct Texture
+// quantized vertex (20 instead of 56 bytes), decoded in the vertex shader (see excercise4/pbr.vs.glsl).
+// The bitangent is not stored, the shader rebuilds it as cross(Normal, Tangent) * sign.
+struct CompactVertex
 {
-    unsigned int id;
-    string type;
-    string path;
+    uint16_t Position[4];  // unorm16 relative to the mesh AABB, w: bitangent sign (0 = -1, 65535 = +1)
+    int16_t Normal[2];     // octahedral encoded unit vector, snorm16
+    int16_t Tangent[2];    // octahedral encoded unit vector, snorm16
+    uint16_t TexCoords[2]; // half floats (texture coordinates may be outside of [0, 1])
 };
 
+// the vertex format a mesh uses on the GPU
+enum class VertexLayout
+{
+    Full,   // Vertex, all attributes as floats
+    Compact // CompactVertex
+};
+
+// octahedral encoding of a unit vector into [-1, 1]^2 (see "A Survey of Efficient Representations for Independent Unit Vectors")
+// ---------------------------------------------------
+glm::vec2 octEncode(glm::vec3 n)
+{
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum == 0.0f)
+        return glm::vec2(0.0f);
+    n /= sum;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f)
+        p = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+    return p;
+}
+
+int16_t quantizeSnorm16(float v) { return (int16_t)std::round(glm::clamp(v, -1.0f, 1.0f) * 32767.0f); }
+uint16_t quantizeUnorm16(float v) { return (uint16_t)std::round(glm::clamp(v, 0.0f, 1.0f) * 65535.0f); }
+
+// sets the vertex attribute pointers of the given layout for the bound VAO and GL_ARRAY_BUFFER
+// ---------------------------------------------------
+void setupVertexAttributes(VertexLayout layout)
+{
+    if (layout == VertexLayout::Compact)
+    {
+        // positions (w: bitangent sign) and texture coords, normals and tangents stay 2 component snorm (z = 0 in the shader)
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void *)offsetof(CompactVertex, Position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void *)offsetof(CompactVertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void *)offsetof(CompactVertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void *)offsetof(CompactVertex, Tangent));
+        return;
+    }
+
+    // set the vertex attribute pointers
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Bitangent));
+}
+
+// utility function for per vertex tangents and bitangents from the texture coordinates (for loaders that do not
+// provide them). Triangle tangents are accumulated, then orthogonalized against the normal; the bitangent keeps
+// the handedness of the texture mapping.
+// ---------------------------------------------------
+void computeTangents(vector<Vertex> &vertices, const vector<unsigned int> &indices)
+{
+    vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f)), bitangents(vertices.size(), glm::vec3(0.0f));
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const Vertex &v0 = vertices[indices[i]], &v1 = vertices[indices[i + 1]], &v2 = vertices[indices[i + 2]];
+        glm::vec3 e1 = v1.Position - v0.Position, e2 = v2.Position - v0.Position;
+        glm::vec2 d1 = v1.TexCoords - v0.TexCoords, d2 = v2.TexCoords - v0.TexCoords;
+        float det = d1.x * d2.y - d2.x * d1.y;
+        if (std::abs(det) < 1e-12f)
+            continue; // degenerate mapping
+        float r = 1.0f / det;
+        glm::vec3 t = (e1 * d2.y - e2 * d1.y) * r, b = (e2 * d1.x - e1 * d2.x) * r;
+        for (int k = 0; k < 3; k++)
+        {
+            tangents[indices[i + k]] += t;
+            bitangents[indices[i + k]] += b;
+        }
+    }
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        glm::vec3 n = vertices[v].Normal;
+        glm::vec3 t = tangents[v] - n * glm::dot(n, tangents[v]);
+        if (glm::dot(t, t) < 1e-20f) // no mapping: any vector perpendicular to the normal
+            t = glm::cross(n, std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+        t = glm::normalize(t);
+        float sign = glm::dot(glm::cross(n, t), bitangents[v]) < 0.0f ? -1.0f : 1.0f;
+        vertices[v].Tangent = t;
+        vertices[v].Bitangent = glm::cross(n, t) * sign;
+    }
+}
+
+// a level of detail of a mesh: a range of its index buffer (all levels share the vertices)
+struct MeshLod
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error; // geometric error in model units (0 for the full resolution)
+};
+
+// uniforms that decode the compact vertex layout, the same for all meshes
+// ---------------------------------------------------
+UniformLocations &vertexDecodeUniforms()
+{
+    static UniformLocations uniforms({"compactVertices", "posMin", "posExtent"});
+    return uniforms;
+}
+
 class Mesh
 {
 public:
@@ -40,98 +162,233 @@ public:
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
-    unsigned int VAO;
+    Material material; // binding table of the textures, built by the constructors
+    unsigned int VAO = 0;
+    // levels of detail, lods[0] is the full mesh. Lower levels are appended to indices.
+    vector<MeshLod> lods;
+    // GPU vertex format, change with SetLayout. Compact positions are relative to the AABB below.
+    VertexLayout layout = VertexLayout::Full;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsExtent = glm::vec3(1.0f);
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor. With upload = false no OpenGL call is made (e.g., when loading on a worker thread);
+    // the buffers are then created later by UploadStep on the render thread.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        material = Material(this->textures);
+        lods.push_back({0, (unsigned int)this->indices.size(), 0.0f});
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (upload)
+            setupMesh(this->vertices.data(), this->indices.data());
     }
 
-    // render the mesh
-    void Draw(Shader shader)
+    // constructor for data that is already laid out in GPU format (e.g., a memory-mapped mesh cache).
+    // The buffers are uploaded straight from the given memory; a CPU copy is kept in vertices/indices.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures, bool upload = true)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++)
+        this->vertices.assign(vertexData, vertexData + vertexCount);
+        this->indices.assign(indexData, indexData + indexCount);
+        this->textures = textures;
+        material = Material(this->textures);
+        lods.push_back({0, (unsigned int)this->indices.size(), 0.0f});
+        computeBounds();
+
+        if (upload)
+            setupMesh(vertexData, indexData);
+    }
+
+    // size of one vertex in the vertex buffer
+    size_t VertexSize() const { return layout == VertexLayout::Compact ? sizeof(CompactVertex) : sizeof(Vertex); }
+    // size of the vertex and index data in the GPU buffers in bytes
+    size_t ByteSize() const { return vertices.size() * VertexSize() + indices.size() * sizeof(unsigned int); }
+    // true once all data is in the GPU buffers
+    bool IsUploaded() const { return VAO != 0 && uploadedBytes == ByteSize(); }
+
+    // uploads the next piece of (at most budget bytes) of a mesh created with upload = false. The buffers are
+    // allocated on the first call. Returns the number of bytes uploaded (render thread only).
+    size_t UploadStep(size_t budget)
+    {
+        if (VAO == 0)
+        {
+            setupMesh(nullptr, nullptr);
+            uploadedBytes = 0;
+        }
+        size_t vertexBytes = vertices.size() * VertexSize();
+        size_t done = 0;
+        while (done < budget && uploadedBytes < ByteSize())
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // copy within the vertex buffer first, then within the index buffer
+            bool vertexPart = uploadedBytes < vertexBytes;
+            size_t offset = vertexPart ? uploadedBytes : uploadedBytes - vertexBytes;
+            size_t size = std::min(budget - done, (vertexPart ? vertexBytes : ByteSize() - vertexBytes) - offset);
+            const char *src = vertexPart ? (const char *)gpuVertexData() : (const char *)indices.data();
+            // GL_COPY_WRITE_BUFFER does not touch the element buffer binding of the currently bound VAO
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vertexPart ? VBO : EBO);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, src + offset);
+            uploadedBytes += size;
+            done += size;
         }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return done;
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // switches the GPU vertex format. The compact vertices are built from the CPU copy in vertices and an
+    // already uploaded mesh is uploaded again (render thread only, unless the mesh was not uploaded yet).
+    void SetLayout(VertexLayout newLayout)
+    {
+        if (newLayout == layout)
+            return;
+        bool wasUploaded = IsUploaded();
+        layout = newLayout;
+        if (layout == VertexLayout::Compact)
+            buildCompactVertices();
+        else
+            vector<CompactVertex>().swap(compactVertices);
+
+        if (VAO != 0)
+        {
+            ReleaseBuffers();
+            if (wasUploaded)
+                setupMesh(gpuVertexData(), indices.data());
+        }
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // deletes the GPU buffers; the CPU copy stays, so UploadStep can create them again (render thread only)
+    void ReleaseBuffers()
+    {
+        if (VAO == 0)
+            return;
+        glState().ForgetVertexArray(VAO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        uploadedBytes = 0;
+    }
+
+    // the coarsest level whose error stays below maxPixelError, when one model unit covers pixelsPerUnit pixels
+    unsigned int SelectLod(float pixelsPerUnit, float maxPixelError) const
+    {
+        unsigned int lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= maxPixelError)
+            lod++;
+        return lod;
+    }
+
+    // sets the decode parameters of the compact layout (ignored by shaders without these uniforms)
+    void SetDecodeUniforms(const Shader &shader) const
+    {
+        const GLint *decode = vertexDecodeUniforms().Resolve(shader);
+        glUniform1i(decode[0], layout == VertexLayout::Compact);
+        glUniform3fv(decode[1], 1, &boundsMin[0]);
+        glUniform3fv(decode[2], 1, &boundsExtent[0]);
+    }
+
+    // render the mesh (at the given level of detail)
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        material.Bind(shader);
+        SetDecodeUniforms(shader);
+
+        // draw mesh (the VAO stays bound, the state cache skips binding it again for the next draw of this mesh)
+        glState().BindVertexArray(VAO);
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        glDrawElements(GL_TRIANGLES, (GLsizei)level.indexCount, GL_UNSIGNED_INT, (void *)(level.indexOffset * sizeof(unsigned int)));
+    }
+
+    // render all instances of the buffer with one draw call (the shader reads the instance attributes, see instancing.h)
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances, unsigned int lod = 0)
+    {
+        if (instances.Count() == 0)
+            return;
+        material.Bind(shader);
+        SetDecodeUniforms(shader);
+
+        glState().BindVertexArray(VAO);
+        instances.Attach();
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)level.indexCount, GL_UNSIGNED_INT, (void *)(level.indexOffset * sizeof(unsigned int)),
+                                (GLsizei)instances.Count());
     }
 
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+    size_t uploadedBytes = 0;
+    vector<CompactVertex> compactVertices;
+
+    const void *gpuVertexData() const
+    {
+        return layout == VertexLayout::Compact ? (const void *)compactVertices.data() : (const void *)vertices.data();
+    }
+
+    // axis aligned bounding box of the vertices
+    void computeBounds()
+    {
+        glm::vec3 minPos(0.0f), maxPos(0.0f);
+        if (!vertices.empty())
+            minPos = maxPos = vertices[0].Position;
+        for (auto &v : vertices)
+        {
+            minPos = glm::min(minPos, v.Position);
+            maxPos = glm::max(maxPos, v.Position);
+        }
+        boundsMin = minPos;
+        boundsExtent = glm::max(maxPos - minPos, glm::vec3(1e-20f)); // no division by zero for flat meshes
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // quantizes vertices into compactVertices (positions relative to the AABB)
+    void buildCompactVertices()
+    {
+        compactVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &v = vertices[i];
+            CompactVertex &c = compactVertices[i];
+            glm::vec3 p = (v.Position - boundsMin) / boundsExtent;
+            bool rightHanded = glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent) >= 0.0f;
+            c.Position[0] = quantizeUnorm16(p.x);
+            c.Position[1] = quantizeUnorm16(p.y);
+            c.Position[2] = quantizeUnorm16(p.z);
+            c.Position[3] = rightHanded ? 65535 : 0;
+            glm::vec2 n = octEncode(v.Normal), t = octEncode(v.Tangent);
+            c.Normal[0] = quantizeSnorm16(n.x);
+            c.Normal[1] = quantizeSnorm16(n.y);
+            c.Tangent[0] = quantizeSnorm16(t.x);
+            c.Tangent[1] = quantizeSnorm16(t.y);
+            c.TexCoords[0] = glm::packHalf1x16(v.TexCoords.x);
+            c.TexCoords[1] = glm::packHalf1x16(v.TexCoords.y);
+        }
+    }
+
+    // initializes all the buffer objects/arrays, the attribute formats depend on the layout
+    void setupMesh(const void *vertexData, const unsigned int *indexData)
     {
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        glState().BindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * VertexSize(), vertexData, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Bitangent));
+        setupVertexAttributes(layout);
 
-        glBindVertexArray(0);
+        glState().BindVertexArray(0);
+        uploadedBytes = vertexData ? ByteSize() : 0;
     }
 };
 #endif
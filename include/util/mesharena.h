@@ -0,0 +1,202 @@
+#pragma once
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/mesh.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// One vertex buffer, one index buffer and one VAO that many meshes are sub-allocated from (full Vertex layout).
+// Meshes in the same arena can be drawn without switching the VAO, and several of them with a single
+// glMultiDrawElementsBaseVertex: the indices of each mesh stay relative to its first vertex (baseVertex).
+// Free gives the space of a mesh back and later allocations reuse it (first fit); the buffers grow (with a GPU
+// side copy) when they are full and never shrink.
+class MeshArena
+{
+public:
+    // location of a mesh in the arena
+    struct Range
+    {
+        GLint baseVertex = 0;
+        unsigned int firstIndex = 0;
+    };
+
+    MeshArena(size_t vertexCapacity = 256 * 1024, size_t indexCapacity = 1024 * 1024)
+        : m_vertexCapacity(vertexCapacity), m_indexCapacity(indexCapacity) {}
+
+    ~MeshArena()
+    {
+        if (m_vao == 0)
+            return;
+        glState().ForgetVertexArray(m_vao);
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ebo);
+    }
+
+    MeshArena(const MeshArena &) = delete;
+    MeshArena &operator=(const MeshArena &) = delete;
+
+    // copies the vertices and indices (all levels of detail) of a mesh into the arena (render thread only)
+    Range Allocate(const Mesh &mesh)
+    {
+        if (m_vao == 0)
+            create();
+        size_t vertexOffset = place(m_freeVertices, m_vertexCount, mesh.vertices.size());
+        size_t indexOffset = place(m_freeIndices, m_indexCount, mesh.indices.size());
+        size_t vertexCount = std::max(m_vertexCount, vertexOffset + mesh.vertices.size());
+        size_t indexCount = std::max(m_indexCount, indexOffset + mesh.indices.size());
+        reserve(vertexCount, indexCount);
+
+        Range range;
+        range.baseVertex = (GLint)vertexOffset;
+        range.firstIndex = (unsigned int)indexOffset;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * sizeof(Vertex), mesh.vertices.size() * sizeof(Vertex), mesh.vertices.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * sizeof(unsigned int), mesh.indices.size() * sizeof(unsigned int), mesh.indices.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        m_vertexCount = vertexCount;
+        m_indexCount = indexCount;
+        return range;
+    }
+
+    // gives the space of a mesh back: range is what Allocate returned for the (unchanged) mesh
+    void Free(const Range &range, const Mesh &mesh)
+    {
+        release(m_freeVertices, m_vertexCount, (size_t)range.baseVertex, mesh.vertices.size());
+        release(m_freeIndices, m_indexCount, range.firstIndex, mesh.indices.size());
+    }
+
+    void Bind() const { glState().BindVertexArray(m_vao); }
+    unsigned int VAO() const { return m_vao; }
+    // end of the used part of the buffers (freed ranges in between are counted)
+    size_t VertexCount() const { return m_vertexCount; }
+    size_t IndexCount() const { return m_indexCount; }
+    size_t ByteSize() const { return m_vertexCapacity * sizeof(Vertex) + m_indexCapacity * sizeof(unsigned int); }
+
+private:
+    unsigned int m_vao = 0, m_vbo = 0, m_ebo = 0;
+    size_t m_vertexCapacity, m_indexCapacity;
+    size_t m_vertexCount = 0, m_indexCount = 0;
+
+    // freed ranges (in vertices or indices), sorted by offset, neighbours merged
+    struct Block
+    {
+        size_t offset;
+        size_t count;
+    };
+    std::vector<Block> m_freeVertices, m_freeIndices;
+
+    // the offset for count elements: the first free block that is large enough, else the end of the used part
+    static size_t place(std::vector<Block> &free, size_t used, size_t count)
+    {
+        for (auto block = free.begin(); block != free.end(); ++block)
+        {
+            if (block->count < count)
+                continue;
+            size_t offset = block->offset;
+            block->offset += count;
+            block->count -= count;
+            if (block->count == 0)
+                free.erase(block);
+            return offset;
+        }
+        return used;
+    }
+
+    // adds a range to the free list; a free block at the end of the used part is given back to it
+    static void release(std::vector<Block> &free, size_t &used, size_t offset, size_t count)
+    {
+        if (count == 0)
+            return;
+        auto block = free.insert(std::lower_bound(free.begin(), free.end(), offset, [](const Block &b, size_t o)
+                                                  { return b.offset < o; }),
+                                 Block{offset, count});
+        if (block + 1 != free.end() && block->offset + block->count == (block + 1)->offset)
+        {
+            block->count += (block + 1)->count;
+            free.erase(block + 1);
+        }
+        if (block != free.begin() && (block - 1)->offset + (block - 1)->count == block->offset)
+        {
+            (block - 1)->count += block->count;
+            block = free.erase(block) - 1;
+        }
+        if (block->offset + block->count == used)
+        {
+            used = block->offset;
+            free.erase(block);
+        }
+    }
+
+    void create()
+    {
+        glGenVertexArrays(1, &m_vao);
+        createBuffers(m_vbo, m_ebo);
+        attach();
+    }
+
+    void createBuffers(unsigned int &vbo, unsigned int &ebo)
+    {
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_vertexCapacity * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // binds the buffers to the VAO
+    void attach()
+    {
+        glState().BindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+        setupVertexAttributes(VertexLayout::Full);
+        glState().BindVertexArray(0);
+    }
+
+    // grows the buffers (at least doubling them) and copies the allocated data over
+    void reserve(size_t vertexCount, size_t indexCount)
+    {
+        if (vertexCount <= m_vertexCapacity && indexCount <= m_indexCapacity)
+            return;
+        m_vertexCapacity = std::max(vertexCount, m_vertexCapacity * (vertexCount > m_vertexCapacity ? 2 : 1));
+        m_indexCapacity = std::max(indexCount, m_indexCapacity * (indexCount > m_indexCapacity ? 2 : 1));
+
+        unsigned int vbo, ebo;
+        createBuffers(vbo, ebo);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_vertexCount * sizeof(Vertex));
+        glBindBuffer(GL_COPY_READ_BUFFER, m_ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_indexCount * sizeof(unsigned int));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ebo);
+        m_vbo = vbo;
+        m_ebo = ebo;
+        attach();
+    }
+};
+
+// the arena shared by all models that opt in (created on first use, needs a current GL context).
+// It is never destroyed: its buffers go away with the context, a destructor at exit would call GL without one.
+// ---------------------------------------------------
+MeshArena &sharedMeshArena()
+{
+    static MeshArena *arena = new MeshArena();
+    return *arena;
+}
+
+#endif
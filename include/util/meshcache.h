@@ -0,0 +1,244 @@
+#pragma once
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <util/mesh.h>
+#include <util/mappedfile.h>
+#include <util/meshopt.h>
+#include <util/meshsimplify.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+// Binary mesh cache: next to every imported model file (e.g., helmet.obj) a helmet.obj.meshcache is written.
+// It stores the Vertex and index arrays exactly as they are passed to glBufferData, so later runs only
+// need to map the file and upload each mesh once. Bump MESH_CACHE_VERSION whenever the layout changes.
+//
+// file layout:  MeshCacheHeader | MeshCacheEntry[meshCount] | per mesh: Vertex[] , unsigned int[] , MeshLod[] , texture strings
+const uint32_t MESH_CACHE_VERSION = 3;
+const char MESH_CACHE_MAGIC[4] = {'R', 'T', 'G', 'M'};
+
+// processing done after the import (bit flags), meshes with different flags are cached in different files
+const uint32_t MESH_PROCESS_OPTIMIZE = 1; // optimizeMesh (weld, vertex cache, overdraw, vertex fetch)
+const uint32_t MESH_PROCESS_LODS = 2;     // generateLods (simplified levels appended to the index buffer)
+const uint32_t MESH_PROCESS_FAST_OBJ = 4; // .obj files are read by objparser.h instead of Assimp
+// the texture references of the materials are stored (the model was loaded with its textures). Without it the
+// texture lists are empty, so a cache written for a model without textures never serves one with textures.
+const uint32_t MESH_CACHE_TEXTURES = 8;
+
+// set to false to always import models through Assimp (the cache is then neither read nor written)
+bool meshCacheEnabled = true;
+
+struct MeshCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;  // sizeof(Vertex) when the cache was written, guards against struct changes
+    uint32_t meshCount;
+    uint32_t importFlags; // Assimp post-processing flags the meshes were imported with
+    uint32_t processFlags; // MESH_PROCESS_* flags and MESH_CACHE_TEXTURES
+    uint32_t importMilliseconds; // how long the original Assimp import took, for load-time comparisons
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime; // last write time of the source file
+    uint64_t sourceHash; // FNV-1a hash of the source file content
+    MeshOptStats optimizationStats; // results of optimizeMesh (all zero without MESH_PROCESS_OPTIMIZE)
+};
+
+struct MeshCacheEntry
+{
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount; // the MeshLod table follows the indices
+    uint64_t vertexOffset; // byte offsets from the beginning of the file
+    uint64_t indexOffset;
+    uint64_t textureOffset;
+};
+
+// utility function to get the cache file path of a model file
+// ---------------------------------------------------
+std::string meshCachePath(const std::string &sourcePath, uint32_t processFlags = 0)
+{
+    return sourcePath + ((processFlags & MESH_PROCESS_OPTIMIZE) ? ".optimized" : "") + ((processFlags & MESH_PROCESS_LODS) ? ".lods" : "") +
+           ((processFlags & MESH_PROCESS_FAST_OBJ) ? ".fastobj" : "") + ((processFlags & MESH_CACHE_TEXTURES) ? ".textures" : "") +
+           ".meshcache";
+}
+
+// read access to a memory-mapped mesh cache file
+class MeshCache
+{
+public:
+    // maps the cache of sourcePath and checks that it is still valid for the source file and import flags.
+    // The source file is only hashed if its timestamp changed (e.g., after a checkout), so an unchanged
+    // file with a new timestamp still hits the cache. The new timestamp is then written into the cache, so
+    // the file is hashed only once and not on every later run.
+    bool open(const std::string &sourcePath, uint32_t importFlags, uint32_t processFlags = 0)
+    {
+        std::string cachePath = meshCachePath(sourcePath, processFlags);
+        if (!m_file.open(cachePath))
+            return false;
+
+        m_header = m_file.at<MeshCacheHeader>(0);
+        if (!m_header || std::memcmp(m_header->magic, MESH_CACHE_MAGIC, 4) != 0 || m_header->version != MESH_CACHE_VERSION ||
+            m_header->vertexSize != sizeof(Vertex) || m_header->importFlags != importFlags ||
+            m_header->processFlags != processFlags)
+            return invalidate("outdated format");
+
+        std::error_code ec;
+        uint64_t sourceSize = (uint64_t)std::filesystem::file_size(sourcePath, ec);
+        if (ec || sourceSize != m_header->sourceSize)
+            return invalidate("source size changed");
+        int64_t sourceTime = fileTimestamp(sourcePath);
+        if (sourceTime != m_header->sourceTime)
+        {
+            if (hashFile(sourcePath) != m_header->sourceHash)
+                return invalidate("source content changed");
+            m_file.close();
+            patchFile(cachePath, offsetof(MeshCacheHeader, sourceTime), sourceTime);
+            if (!m_file.open(cachePath) || !(m_header = m_file.at<MeshCacheHeader>(0)))
+                return invalidate("truncated file");
+        }
+
+        m_entries = m_file.at<MeshCacheEntry>(sizeof(MeshCacheHeader), m_header->meshCount);
+        if (!m_entries)
+            return invalidate("truncated file");
+        for (uint32_t i = 0; i < m_header->meshCount; i++)
+        {
+            if (!vertices(i) || !indices(i) || !lods(i) || !m_file.at<char>(m_entries[i].textureOffset, 0))
+                return invalidate("truncated file");
+        }
+        return true;
+    }
+
+    uint32_t meshCount() const { return m_header->meshCount; }
+    uint32_t importMilliseconds() const { return m_header->importMilliseconds; }
+    const MeshCacheHeader &header() const { return *m_header; }
+    const MeshCacheEntry &entry(uint32_t i) const { return m_entries[i]; }
+    const Vertex *vertices(uint32_t i) const { return m_file.at<Vertex>(m_entries[i].vertexOffset, m_entries[i].vertexCount); }
+    const unsigned int *indices(uint32_t i) const { return m_file.at<unsigned int>(m_entries[i].indexOffset, m_entries[i].indexCount); }
+    const MeshLod *lods(uint32_t i) const { return m_file.at<MeshLod>(m_entries[i].indexOffset + m_entries[i].indexCount * sizeof(unsigned int), m_entries[i].lodCount); }
+
+    // texture references of a mesh as (type, path) pairs, the textures themselves are not cached
+    std::vector<std::pair<std::string, std::string>> textures(uint32_t i) const
+    {
+        std::vector<std::pair<std::string, std::string>> result;
+        size_t offset = m_entries[i].textureOffset;
+        for (uint32_t t = 0; t < m_entries[i].textureCount; t++)
+        {
+            std::string type, path;
+            if (!readString(offset, type) || !readString(offset, path))
+                break;
+            result.push_back({type, path});
+        }
+        return result;
+    }
+
+private:
+    MappedFile m_file;
+    const MeshCacheHeader *m_header = nullptr;
+    const MeshCacheEntry *m_entries = nullptr;
+
+    bool invalidate(const char *reason)
+    {
+        std::cout << "(mesh cache invalid: " << reason << ") ";
+        m_file.close();
+        return false;
+    }
+
+    bool readString(size_t &offset, std::string &str) const
+    {
+        const uint32_t *length = m_file.at<uint32_t>(offset);
+        if (!length)
+            return false;
+        const char *chars = m_file.at<char>(offset + sizeof(uint32_t), *length);
+        if (!chars)
+            return false;
+        str.assign(chars, *length);
+        offset += sizeof(uint32_t) + *length;
+        return true;
+    }
+};
+
+// utility function for writing the meshes of a freshly imported model into its cache file
+// ---------------------------------------------------
+bool writeMeshCache(const std::string &sourcePath, const std::vector<Mesh> &meshes, uint32_t importFlags, uint32_t importMilliseconds,
+                    uint32_t processFlags = 0, const MeshOptStats &optimizationStats = MeshOptStats())
+{
+    std::error_code ec;
+    MeshCacheHeader header;
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = (uint32_t)meshes.size();
+    header.importFlags = importFlags;
+    header.processFlags = processFlags;
+    header.reserved = 0;
+    header.optimizationStats = optimizationStats;
+    header.importMilliseconds = importMilliseconds;
+    header.sourceSize = (uint64_t)std::filesystem::file_size(sourcePath, ec);
+    header.sourceTime = fileTimestamp(sourcePath);
+    header.sourceHash = hashFile(sourcePath);
+    if (ec)
+        return false;
+
+    auto align = [](uint64_t offset) { return (offset + 15) & ~uint64_t(15); };
+
+    // first pass: compute the offsets of all arrays
+    std::vector<MeshCacheEntry> entries(meshes.size());
+    uint64_t offset = sizeof(MeshCacheHeader) + meshes.size() * sizeof(MeshCacheEntry);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        auto &e = entries[i];
+        e.vertexCount = (uint32_t)meshes[i].vertices.size();
+        e.indexCount = (uint32_t)meshes[i].indices.size();
+        e.textureCount = (uint32_t)meshes[i].textures.size();
+        e.lodCount = (uint32_t)meshes[i].lods.size();
+        e.vertexOffset = align(offset);
+        e.indexOffset = align(e.vertexOffset + e.vertexCount * sizeof(Vertex));
+        e.textureOffset = e.indexOffset + e.indexCount * sizeof(unsigned int) + e.lodCount * sizeof(MeshLod);
+        offset = e.textureOffset;
+        for (auto &t : meshes[i].textures)
+            offset += 2 * sizeof(uint32_t) + t.type.size() + t.path.size();
+    }
+
+    // second pass: write everything (padding is filled with zeros)
+    std::ofstream out(meshCachePath(sourcePath, processFlags), std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    auto pad = [&out](uint64_t target)
+    {
+        while ((uint64_t)out.tellp() < target)
+            out.put(0);
+    };
+    auto writeString = [&out](const std::string &str)
+    {
+        uint32_t length = (uint32_t)str.size();
+        out.write((const char *)&length, sizeof(length));
+        out.write(str.data(), length);
+    };
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)entries.data(), entries.size() * sizeof(MeshCacheEntry));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        pad(entries[i].vertexOffset);
+        out.write((const char *)meshes[i].vertices.data(), entries[i].vertexCount * sizeof(Vertex));
+        pad(entries[i].indexOffset);
+        out.write((const char *)meshes[i].indices.data(), entries[i].indexCount * sizeof(unsigned int));
+        out.write((const char *)meshes[i].lods.data(), entries[i].lodCount * sizeof(MeshLod));
+        for (auto &t : meshes[i].textures)
+        {
+            writeString(t.type);
+            writeString(t.path);
+        }
+    }
+    return (bool)out;
+}
+
+#endif
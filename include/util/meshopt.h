@@ -0,0 +1,421 @@
+#pragma once
+#ifndef MESHOPT_H
+#define MESHOPT_H
+
+#include <util/mesh.h>
+#include <util/mappedfile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+// Load-time optimization of indexed triangle meshes (no OpenGL calls, safe on worker threads):
+//   1. weld:          merge vertices with identical attributes (Assimp emits 3 vertices per OBJ triangle)
+//   2. vertex cache:  reorder triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+//   3. overdraw:      sort clusters of triangles so that outward facing ones are drawn first (Sander et al., "Fast Triangle Reordering")
+//   4. vertex fetch:  reorder vertices by first use, so the vertex fetch reads memory (mostly) sequentially
+// The statistics of the result are computed with a FIFO cache simulation (ACMR) and a small software rasterizer (overdraw).
+
+const unsigned int VERTEX_CACHE_SIZE = 32;  // cache size the Forsyth scores are tuned for
+const unsigned int ACMR_CACHE_SIZE = 16;    // FIFO size used to measure the ACMR (a conservative estimate for current GPUs)
+const int OVERDRAW_RESOLUTION = 256;        // per view of the overdraw rasterizer
+
+// before/after numbers of optimizeMesh, can be accumulated over all meshes of a model
+struct MeshOptStats
+{
+    size_t triangles = 0;
+    size_t verticesBefore = 0, verticesAfter = 0;
+    size_t missesBefore = 0, missesAfter = 0;   // vertex shader invocations (FIFO cache misses)
+    size_t coveredBefore = 0, coveredAfter = 0; // pixels covered in the 6 overdraw views
+    size_t shadedBefore = 0, shadedAfter = 0;   // pixels shaded (passed the depth test) in the 6 overdraw views
+
+    // average cache miss ratio: transformed vertices per triangle (3 = no reuse, ~0.5 is the optimum for regular grids)
+    float AcmrBefore() const { return triangles ? (float)missesBefore / triangles : 0.0f; }
+    float AcmrAfter() const { return triangles ? (float)missesAfter / triangles : 0.0f; }
+    // shaded / covered pixels (1 = every pixel is shaded once)
+    float OverdrawBefore() const { return coveredBefore ? (float)shadedBefore / coveredBefore : 0.0f; }
+    float OverdrawAfter() const { return coveredAfter ? (float)shadedAfter / coveredAfter : 0.0f; }
+
+    void add(const MeshOptStats &other)
+    {
+        triangles += other.triangles;
+        verticesBefore += other.verticesBefore;
+        verticesAfter += other.verticesAfter;
+        missesBefore += other.missesBefore;
+        missesAfter += other.missesAfter;
+        coveredBefore += other.coveredBefore;
+        coveredAfter += other.coveredAfter;
+        shadedBefore += other.shadedBefore;
+        shadedAfter += other.shadedAfter;
+    }
+};
+
+// number of vertex shader invocations for the index buffer with a FIFO post-transform cache
+// ---------------------------------------------------
+size_t countCacheMisses(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = ACMR_CACHE_SIZE)
+{
+    // a vertex is in the FIFO if less than cacheSize misses happened since it was last transformed
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+// rasterizes the mesh along the 6 axis directions (back faces culled, depth test on) and counts the
+// covered and shaded pixels, for drawing the triangles in index buffer order
+// ---------------------------------------------------
+void countOverdraw(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, size_t &covered, size_t &shaded)
+{
+    covered = shaded = 0;
+    if (vertices.empty() || indices.empty())
+        return;
+
+    glm::vec3 minPos = vertices[0].Position, maxPos = vertices[0].Position;
+    for (auto &v : vertices)
+    {
+        minPos = glm::min(minPos, v.Position);
+        maxPos = glm::max(maxPos, v.Position);
+    }
+    glm::vec3 extent = glm::max(maxPos - minPos, glm::vec3(1e-20f));
+    float scale = std::max(extent.x, std::max(extent.y, extent.z)); // keep the aspect ratio
+
+    const int size = OVERDRAW_RESOLUTION;
+    std::vector<float> depth(size * size);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int direction = 0; direction < 2; direction++)
+        {
+            std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+            // project into the view: u, v in pixels and the depth (smaller is closer). Mirroring u for the
+            // opposite direction keeps the winding of front faces counter-clockwise.
+            auto project = [&](const glm::vec3 &position)
+            {
+                glm::vec3 p = (position - minPos) / scale;
+                float u = p[(axis + 1) % 3], v = p[(axis + 2) % 3], d = p[axis];
+                if (direction == 0)
+                    d = 1.0f - d;
+                else
+                    u = 1.0f - u;
+                return glm::vec3(u * (size - 1), v * (size - 1), d);
+            };
+
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                glm::vec3 a = project(vertices[indices[i]].Position);
+                glm::vec3 b = project(vertices[indices[i + 1]].Position);
+                glm::vec3 c = project(vertices[indices[i + 2]].Position);
+                float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+                if (area <= 0.0f) // back facing or degenerate
+                    continue;
+
+                int x0 = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x))));
+                int x1 = std::min(size - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+                int y0 = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+                int y1 = std::min(size - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+                for (int y = y0; y <= y1; y++)
+                {
+                    for (int x = x0; x <= x1; x++)
+                    {
+                        // barycentric coordinates from the edge functions
+                        float px = x + 0.5f, py = y + 0.5f;
+                        float wa = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+                        float wb = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+                        float wc = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+                        if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+                            continue;
+                        float z = (wa * a.z + wb * b.z + wc * c.z) / area;
+                        float &stored = depth[y * size + x];
+                        if (z < stored)
+                        {
+                            if (stored == std::numeric_limits<float>::max())
+                                covered++;
+                            stored = z;
+                            shaded++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// merges vertices whose attributes are bitwise identical. Returns the number of removed vertices.
+// ---------------------------------------------------
+size_t weldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    struct VertexHash
+    {
+        const std::vector<Vertex> *vertices;
+        size_t operator()(unsigned int i) const { return (size_t)hashBytes(&(*vertices)[i], sizeof(Vertex)); }
+    };
+    struct VertexEqual
+    {
+        const std::vector<Vertex> *vertices;
+        bool operator()(unsigned int a, unsigned int b) const { return std::memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0; }
+    };
+
+    std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> unique(vertices.size(), VertexHash{&vertices}, VertexEqual{&vertices});
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.insert({i, (unsigned int)welded.size()});
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (auto &index : indices)
+        index = remap[index];
+
+    size_t removed = vertices.size() - welded.size();
+    vertices.swap(welded);
+    return removed;
+}
+
+// score of a vertex for the Forsyth algorithm: recently used vertices and vertices with few remaining triangles score high
+// ---------------------------------------------------
+float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f; // no triangle left that needs the vertex
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3) // used by the last triangle, a fixed score so the next triangle does not just reuse an edge
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - (cachePosition - 3) / float(VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt((float)remainingTriangles); // valence boost: finish off vertices with few triangles left
+}
+
+// reorders the triangles for the post-transform vertex cache (greedy, always emits the best scoring triangle next)
+// ---------------------------------------------------
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles of each vertex (the not emitted ones are kept at the front of each list)
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    std::vector<char> emitted(triangleCount, 0);
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache, newCache;
+    size_t cursor = 0;   // all triangles before the cursor are emitted
+    long best = -1;
+    while (result.size() < indices.size())
+    {
+        if (best < 0) // nothing in the cache has triangles left, continue with the next triangle in the input
+        {
+            while (emitted[cursor])
+                cursor++;
+            best = (long)cursor;
+        }
+
+        const unsigned int *triangle = &indices[best * 3];
+        emitted[best] = 1;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // remove the triangle from the lists of its vertices, put its vertices at the front of the LRU cache
+        newCache.assign(triangle, triangle + 3);
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            unsigned int *list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++)
+            {
+                if (list[j] == (unsigned int)best)
+                {
+                    std::swap(list[j], list[remaining[v] - 1]);
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+        for (unsigned int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.push_back(v);
+
+        // update the scores of the cached (and just evicted) vertices and their triangles
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < VERTEX_CACHE_SIZE ? (int)i : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : newCache)
+        {
+            for (unsigned int j = 0; j < remaining[v]; j++)
+            {
+                unsigned int t = adjacency[offsets[v] + j];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+        if (newCache.size() > VERTEX_CACHE_SIZE)
+            newCache.resize(VERTEX_CACHE_SIZE);
+        cache.swap(newCache);
+    }
+    indices.swap(result);
+}
+
+// sorts clusters of triangles so that the ones facing outwards (which likely occlude the others) are drawn first.
+// Clusters end where the vertex cache order starts over (a triangle with 3 cache misses), so the order inside a
+// cluster and thus the cache efficiency stays almost the same. The result is dropped if the ACMR grows by more
+// than the threshold.
+// ---------------------------------------------------
+void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices, float threshold = 1.05f)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // split into clusters using the same FIFO simulation as countCacheMisses
+    std::vector<size_t> clusterStart;
+    {
+        std::vector<unsigned int> timestamps(vertices.size(), 0);
+        unsigned int time = ACMR_CACHE_SIZE + 1;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int index = indices[t * 3 + k];
+                if (time - timestamps[index] > ACMR_CACHE_SIZE)
+                {
+                    timestamps[index] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusterStart.push_back(t);
+        }
+        clusterStart.push_back(triangleCount);
+    }
+    size_t clusterCount = clusterStart.size() - 1;
+
+    // sort key: how far the cluster lies outside of the mesh center in the direction it is facing
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCenter(clusterCount, glm::vec3(0.0f)), clusterNormal(clusterCount, glm::vec3(0.0f));
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float clusterArea = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &p = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, p - a); // length is twice the area
+            float area = glm::length(normal);
+            glm::vec3 center = (a + b + p) / 3.0f;
+            clusterCenter[c] += center * area;
+            clusterNormal[c] += normal;
+            clusterArea += area;
+            meshCenter += center * area;
+            meshArea += area;
+        }
+        clusterCenter[c] = clusterArea > 0.0f ? clusterCenter[c] / clusterArea : glm::vec3(0.0f);
+    }
+    meshCenter = meshArea > 0.0f ? meshCenter / meshArea : glm::vec3(0.0f);
+
+    std::vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float length = glm::length(clusterNormal[c]);
+        sortKey[c] = length > 0.0f ? glm::dot(clusterCenter[c] - meshCenter, clusterNormal[c] / length) : 0.0f;
+    }
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     { return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+
+    if (countCacheMisses(result, vertices.size()) <= threshold * countCacheMisses(indices, vertices.size()))
+        indices.swap(result);
+}
+
+// reorders the vertices in the order they are first used by the index buffer (and drops unused ones)
+// ---------------------------------------------------
+void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    std::vector<unsigned int> remap(vertices.size(), ~0u);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (auto &index : indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = (unsigned int)result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+// runs all passes and measures the mesh before and after
+// ---------------------------------------------------
+MeshOptStats optimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    MeshOptStats stats;
+    stats.triangles = indices.size() / 3;
+    stats.verticesBefore = vertices.size();
+    stats.missesBefore = countCacheMisses(indices, vertices.size());
+    countOverdraw(vertices, indices, stats.coveredBefore, stats.shadedBefore);
+
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices);
+    optimizeVertexFetch(vertices, indices);
+
+    stats.verticesAfter = vertices.size();
+    stats.missesAfter = countCacheMisses(indices, vertices.size());
+    countOverdraw(vertices, indices, stats.coveredAfter, stats.shadedAfter);
+    return stats;
+}
+
+#endif
@@ -0,0 +1,335 @@
+#pragma once
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include <util/mesh.h>
+#include <util/meshopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+// Level of detail generation by edge collapses ordered by the quadric error metric
+// (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics"). No OpenGL calls.
+// A vertex is always collapsed onto one of its neighbours, so all levels share the vertices of the base
+// mesh and only need their own index range. Vertices on open borders are never moved. Vertices on UV or
+// normal seams (two vertices with the same position, one per side) only move along the seam, both sides
+// together, so the seam does not open up.
+
+// target triangle counts of the generated levels, relative to the base mesh
+const float MESH_LOD_RATIOS[] = {0.5f, 0.25f, 0.125f};
+
+// symmetric 4x4 matrix summing up the area weighted squared distances to a set of planes
+struct Quadric
+{
+    double m[10] = {}; // aa ab ac ad bb bc bd cc cd dd
+    double weight = 0.0;
+
+    // plane n.x * x + n.y * y + n.z * z + d = 0 (n normalized)
+    void addPlane(const glm::vec3 &n, float d, double area)
+    {
+        double a = n.x, b = n.y, c = n.z;
+        m[0] += area * a * a; m[1] += area * a * b; m[2] += area * a * c; m[3] += area * a * d;
+        m[4] += area * b * b; m[5] += area * b * c; m[6] += area * b * d;
+        m[7] += area * c * c; m[8] += area * c * d;
+        m[9] += area * d * d;
+        weight += area;
+    }
+
+    void add(const Quadric &other)
+    {
+        for (int i = 0; i < 10; i++)
+            m[i] += other.m[i];
+        weight += other.weight;
+    }
+
+    // mean squared distance of p to the planes (weighted by the areas of their triangles)
+    double error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double sum = m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x +
+                     m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y +
+                     m[7] * z * z + 2 * m[8] * z + m[9];
+        return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+    }
+};
+
+// simplifies the triangles towards targetIndexCount indices (fewer collapses happen if too many vertices are locked).
+// The result references the same vertices. error receives the geometric error of the result in model units.
+// ---------------------------------------------------
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, size_t targetIndexCount, float &error)
+{
+    size_t vertexCount = vertices.size();
+    std::vector<unsigned int> result(indices);
+    error = 0.0f;
+    auto edgeKey = [](unsigned int a, unsigned int b)
+    { return ((uint64_t)std::min(a, b) << 32) | std::max(a, b); };
+
+    // vertices with the same position form a ring (sibling points to the next one)
+    std::vector<unsigned int> positionId(vertexCount), sibling(vertexCount), groupSize(vertexCount);
+    {
+        struct PositionHash
+        {
+            const std::vector<Vertex> *vertices;
+            size_t operator()(unsigned int i) const { return (size_t)hashBytes(&(*vertices)[i].Position, sizeof(glm::vec3)); }
+        };
+        struct PositionEqual
+        {
+            const std::vector<Vertex> *vertices;
+            bool operator()(unsigned int a, unsigned int b) const { return (*vertices)[a].Position == (*vertices)[b].Position; }
+        };
+        std::unordered_map<unsigned int, unsigned int, PositionHash, PositionEqual> first(vertexCount, PositionHash{&vertices}, PositionEqual{&vertices});
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            auto inserted = first.insert({v, v});
+            unsigned int head = inserted.first->second;
+            positionId[v] = head;
+            sibling[v] = inserted.second ? v : sibling[head];
+            sibling[head] = v;
+            groupSize[head]++;
+        }
+    }
+
+    // classify the vertices: edges used by one triangle are borders. Borders that are closed when only positions
+    // are compared are seams (UV islands, hard normals) with exactly two vertices per position, one per side.
+    enum VertexKind : char
+    {
+        Manifold, // free to move
+        Seam,     // moves along the seam, together with its sibling
+        Locked    // open border or complex seam
+    };
+    std::vector<char> kind(vertexCount, Manifold);
+    {
+        std::unordered_map<uint64_t, int> edgeUse, positionEdgeUse;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                edgeUse[edgeKey(a, b)]++;
+                positionEdgeUse[edgeKey(positionId[a], positionId[b])]++;
+            }
+        }
+        for (auto &edge : edgeUse)
+        {
+            if (edge.second != 1)
+                continue;
+            unsigned int ends[2] = {(unsigned int)(edge.first >> 32), (unsigned int)(edge.first & 0xffffffffu)};
+            bool seam = positionEdgeUse[edgeKey(positionId[ends[0]], positionId[ends[1]])] == 2;
+            for (unsigned int v : ends)
+            {
+                if (seam && groupSize[positionId[v]] == 2 && kind[v] != Locked)
+                    kind[v] = Seam;
+                else
+                    kind[v] = Locked;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const glm::vec3 &a = vertices[result[i]].Position;
+        glm::vec3 normal = glm::cross(vertices[result[i + 1]].Position - a, vertices[result[i + 2]].Position - a);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+        normal = normal / length;
+        for (int k = 0; k < 3; k++)
+            quadrics[result[i + k]].addPlane(normal, -glm::dot(normal, a), 0.5 * length);
+    }
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        unsigned int siblingFrom, siblingTo; // the other side of a seam (equal to from/to otherwise)
+        double cost;
+    };
+    std::vector<Collapse> collapses;
+    std::unordered_map<uint64_t, int> edgeUse;
+    std::vector<unsigned int> offsets(vertexCount + 1), adjacency;
+    std::vector<char> touched(vertexCount);
+    std::vector<unsigned int> remap(vertexCount);
+    std::iota(remap.begin(), remap.end(), 0);
+    double maxCost = 0.0;
+
+    auto cost = [&](unsigned int from, unsigned int to)
+    {
+        Quadric q = quadrics[from];
+        q.add(quadrics[to]);
+        return q.error(vertices[to].Position);
+    };
+
+    // a seam vertex may only move along its seam; its sibling has to move onto the sibling of the target
+    auto addCollapse = [&](unsigned int from, unsigned int to)
+    {
+        if (kind[from] == Locked)
+            return;
+        if (kind[from] == Manifold)
+        {
+            collapses.push_back({from, to, from, to, cost(from, to)});
+            return;
+        }
+        if (edgeUse[edgeKey(from, to)] != 1)
+            return;
+        unsigned int siblingFrom = sibling[from];
+        for (unsigned int candidate = sibling[to]; candidate != to; candidate = sibling[candidate])
+        {
+            auto edge = edgeUse.find(edgeKey(siblingFrom, candidate));
+            if (edge != edgeUse.end() && edge->second == 1)
+            {
+                collapses.push_back({from, to, siblingFrom, candidate, cost(from, to) + cost(siblingFrom, candidate)});
+                return;
+            }
+        }
+    };
+
+    // a collapse is rejected if it flips a triangle; counts the triangles that degenerate
+    auto checkCollapse = [&](unsigned int from, unsigned int to, size_t &collapsing)
+    {
+        for (unsigned int j = offsets[from]; j < offsets[from + 1]; j++)
+        {
+            const unsigned int *triangle = &result[adjacency[j] * 3];
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            {
+                collapsing++;
+                continue;
+            }
+            glm::vec3 p[3], q[3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = vertices[triangle[k]].Position;
+                q[k] = triangle[k] == from ? vertices[to].Position : p[k];
+            }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.0f)
+                return false;
+        }
+        return true;
+    };
+
+    auto touchNeighbourhood = [&](unsigned int v)
+    {
+        touched[v] = 1;
+        for (unsigned int j = offsets[v]; j < offsets[v + 1]; j++)
+            for (int k = 0; k < 3; k++)
+                touched[result[adjacency[j] * 3 + k]] = 1;
+    };
+
+    // every pass collapses the cheapest edges whose neighbourhoods do not overlap
+    while (result.size() > targetIndexCount)
+    {
+        edgeUse.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+                edgeUse[edgeKey(result[i + k], result[i + (k + 1) % 3])]++;
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                if (a > b && edgeUse[edgeKey(a, b)] == 2) // interior edges are visited twice (once per direction), only keep one
+                    continue;
+                addCollapse(a, b);
+                addCollapse(b, a);
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y)
+                  { return x.cost < y.cost; });
+
+        // triangles of each vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (unsigned int index : result)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        {
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+        }
+
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        for (const Collapse &c : collapses)
+        {
+            if (removed >= trianglesToRemove)
+                break;
+            bool seam = c.siblingFrom != c.from;
+            if (touched[c.from] || touched[c.to] || touched[c.siblingFrom] || touched[c.siblingTo])
+                continue;
+            size_t collapsing = 0;
+            if (!checkCollapse(c.from, c.to, collapsing) || (seam && !checkCollapse(c.siblingFrom, c.siblingTo, collapsing)))
+                continue;
+
+            remap[c.from] = c.to;
+            quadrics[c.to].add(quadrics[c.from]);
+            touchNeighbourhood(c.from);
+            if (seam)
+            {
+                remap[c.siblingFrom] = c.siblingTo;
+                quadrics[c.siblingTo].add(quadrics[c.siblingFrom]);
+                touchNeighbourhood(c.siblingFrom);
+            }
+            maxCost = std::max(maxCost, c.cost);
+            removed += collapsing;
+        }
+        if (removed == 0)
+            break;
+
+        // apply the collapses and drop the degenerate triangles
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    error = (float)std::sqrt(std::max(maxCost, 0.0));
+    return result;
+}
+
+// welds the vertices and appends the levels of MESH_LOD_RATIOS to the index buffer (as long as they still reduce
+// the triangle count noticeably). Returns all levels including the base mesh as level 0.
+// ---------------------------------------------------
+std::vector<MeshLod> generateLods(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, bool optimizeOrder)
+{
+    weldVertices(vertices, indices); // shared vertices are needed to find the edges
+    std::vector<MeshLod> lods = {{0, (unsigned int)indices.size(), 0.0f}};
+
+    size_t baseCount = indices.size();
+    std::vector<unsigned int> previous(indices);
+    for (float ratio : MESH_LOD_RATIOS)
+    {
+        float error;
+        std::vector<unsigned int> lod = simplifyMesh(vertices, previous, (size_t)(baseCount * ratio) / 3 * 3, error);
+        if (lod.empty() || lod.size() > previous.size() * 9 / 10) // too many locked vertices, no real reduction left
+            break;
+        if (optimizeOrder)
+            optimizeVertexCache(lod, vertices.size());
+
+        // the error of a level builds on the error of the level it was simplified from
+        lods.push_back({(unsigned int)indices.size(), (unsigned int)lod.size(), lods.back().error + error});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        previous.swap(lod);
+    }
+    return lods;
+}
+
+#endif
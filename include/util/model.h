@@ -12,7 +12,19 @@
 #include <assimp/postprocess.h>
 
 #include <util/mesh.h>
+#include <util/meshopt.h>
+#include <util/meshsimplify.h>
+#include <util/meshcache.h>
+#include <util/mesharena.h>
+#include <util/renderqueue.h>
+#include <util/texcompress.h>
+#include <util/texturecache.h>
+#include <util/gltf.h>
+#include <util/objparser.h>
 #include <util/shader.h>
+#include <util/camera.h>
+#include <util/culling.h>
+#include <util/gpuscene.h>
 
 #include <string>
 #include <fstream>
@@ -20,51 +32,444 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <chrono>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, TexUsage usage = TexUsage::Color);
 
 class Model 
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// the textures this model holds a reference to (see ReleaseTextures)
     vector<Mesh>    meshes;
     string directory;
-    bool gammaCorrection;
-    bool loadTexturesFromModel;
+    bool gammaCorrection = false;
+    bool loadTexturesFromModel = false;
+    bool deferUpload = false;          // if true, meshes are only loaded to the CPU and uploaded later with Mesh::UploadStep
+    bool loadedFromCache = false;      // true if the meshes came from the binary mesh cache instead of Assimp
+    unsigned int importMilliseconds = 0; // duration of the (last) Assimp or glTF import of this file
+    VertexLayout vertexLayout = VertexLayout::Full; // GPU vertex format of the meshes, see SetVertexLayout
+    uint32_t meshProcessing = 0;       // MESH_PROCESS_* flags (see meshcache.h) applied to every imported mesh
+    unsigned int drawnTriangles = 0;   // triangles submitted by the last Draw
+    unsigned int drawCalls = 0;        // draw calls issued by the last Draw
+    unsigned int culledMeshes = 0;     // meshes outside the frustum in the last Draw or Enqueue
+    BoundsSoA meshBounds;              // box and sphere of each mesh in model space, computed at load time
+    MeshOptStats optimizationStats;    // summed up over all meshes, also available when loaded from the cache
+    // unique number of the placement of the meshes in the arena, changes whenever UseArena or ReleaseBuffers moves
+    // them (never reused), e.g., to know when a GPU scene (AddTo) has to be rebuilt
+    unsigned int arenaSerial = 0;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool loadTextures = false, bool gamma = false) : gammaCorrection(gamma), loadTexturesFromModel(loadTextures)
+    // an empty model (draws nothing), e.g., as a stand-in while the real one is still loading
+    Model() {}
+
+    // constructor, expects a filepath to a 3D model. glTF files (.gltf/.glb) are read by the native loader in
+    // gltf.h, all other formats through Assimp.
+    // With deferUpload = true no OpenGL calls are made, so the model can be loaded on a worker thread
+    // (textures of the model file cannot be loaded in that case).
+    // processing: MESH_PROCESS_OPTIMIZE welds and reorders the meshes for the vertex cache, overdraw and vertex fetch,
+    // MESH_PROCESS_LODS adds simplified levels of detail (see Draw with a camera), MESH_PROCESS_FAST_OBJ reads .obj
+    // files with the parallel parser of objparser.h instead of Assimp.
+    Model(string const &path, bool loadTextures = false, bool gamma = false, bool defer = false, uint32_t processing = 0)
+        : gammaCorrection(gamma), loadTexturesFromModel(loadTextures && !defer), deferUpload(defer), meshProcessing(processing)
     {
         loadModel(path);
+        computeMeshBounds();
+    }
+
+    // true once all meshes are in GPU memory
+    bool IsUploaded() const
+    {
+        for (auto &mesh : meshes)
+            if (!mesh.IsUploaded())
+                return false;
+        return true;
+    }
+
+    // bytes of the CPU copies of all vertex and index arrays
+    size_t CpuBytes() const
+    {
+        size_t bytes = 0;
+        for (auto &mesh : meshes)
+            bytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+        return bytes;
+    }
+
+    // CpuBytes of the model at path as it is stored in the mesh cache, without loading it. 0 if there is no valid
+    // cache file for these settings (e.g., the model was never imported).
+    static size_t CachedCpuBytes(const string &path, uint32_t processing = 0, bool loadTextures = false)
+    {
+        MeshCache cache;
+        if (!meshCacheEnabled || !cache.open(path, IMPORT_FLAGS, processing | (loadTextures ? MESH_CACHE_TEXTURES : 0)))
+            return 0;
+        size_t bytes = 0;
+        for (uint32_t i = 0; i < cache.meshCount(); i++)
+            bytes += cache.entry(i).vertexCount * sizeof(Vertex) + cache.entry(i).indexCount * sizeof(unsigned int);
+        return bytes;
+    }
+
+    // bytes of the vertex buffers in GPU memory
+    size_t VertexBytes() const
+    {
+        size_t bytes = 0;
+        for (auto &mesh : meshes)
+            bytes += mesh.vertices.size() * mesh.VertexSize();
+        return bytes;
+    }
+
+    // bytes of the vertex and index buffers that are allocated in GPU memory, including the copies in the arena
+    size_t GpuBytes() const
+    {
+        size_t bytes = 0;
+        for (auto &mesh : meshes)
+            bytes += mesh.VAO != 0 ? mesh.ByteSize() : 0;
+        if (arena && arenaRanges.size() == meshes.size())
+            for (auto &mesh : meshes)
+                bytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+        return bytes;
+    }
+
+    // uploads all meshes that are not (completely) in GPU memory, e.g. after ReleaseBuffers (render thread only)
+    void Upload()
+    {
+        for (auto &mesh : meshes)
+            while (!mesh.IsUploaded())
+                mesh.UploadStep(mesh.ByteSize());
+    }
+
+    // drops the references to the textures of the model file (the meshes must not be drawn with textures afterwards)
+    void ReleaseTextures()
+    {
+        for (auto &texture : textures_loaded)
+            textureCache().Release(texture.id);
+        textures_loaded.clear();
+    }
+
+    // frees the GPU buffers of all meshes and their ranges in the arena, the CPU copies stay for Upload (see
+    // Mesh::ReleaseBuffers). The next UseArena copies the meshes into the arena again, into the freed space.
+    // GPU scenes (AddTo) that contain the meshes have to be rebuilt.
+    void ReleaseBuffers()
+    {
+        for (auto &mesh : meshes)
+            mesh.ReleaseBuffers();
+        if (arena && arenaRanges.size() == meshes.size())
+            for (size_t i = 0; i < meshes.size(); i++)
+                arena->Free(arenaRanges[i], meshes[i]);
+        if (!arenaRanges.empty())
+            arenaSerial = nextArenaSerial();
+        arenaRanges.clear();
+    }
+
+    // switches the vertex format of all meshes (see Mesh::SetLayout)
+    void SetVertexLayout(VertexLayout layout)
+    {
+        vertexLayout = layout;
+        for (auto &mesh : meshes)
+            mesh.SetLayout(layout);
+    }
+
+    // draws the meshes from the arena (nullptr: from their own buffers again). The meshes are copied into the
+    // arena on the first call; they keep their own buffers, so switching back and forth is cheap.
+    void UseArena(MeshArena *meshArena)
+    {
+        if (meshArena && (arena != meshArena || arenaRanges.size() != meshes.size()))
+        {
+            if (arena && arenaRanges.size() == meshes.size()) // moving to another arena
+                for (size_t i = 0; i < meshes.size(); i++)
+                    arena->Free(arenaRanges[i], meshes[i]);
+            arenaRanges.clear();
+            for (auto &mesh : meshes)
+                arenaRanges.push_back(meshArena->Allocate(mesh));
+            arena = meshArena;
+            arenaSerial = nextArenaSerial();
+        }
+        drawFromArena = meshArena != nullptr;
     }
 
     // draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    void Draw(Shader &shader)
+    {
+        m_drawLods.assign(meshes.size(), 0);
+        culledMeshes = 0;
+        submit(shader);
+    }
+
+    // draws every mesh at the coarsest level of detail whose error, projected onto the screen, stays below
+    // maxPixelError pixels. model is the model matrix the shader uses, viewportHeight the height in pixels.
+    // With a frustum (Camera::GetFrustum) meshes whose bounds are outside of it are skipped.
+    void Draw(Shader &shader, const Camera &camera, const glm::mat4 &model, float viewportHeight, float maxPixelError = 1.0f,
+              const Frustum *frustum = nullptr)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        selectLods(camera, model, viewportHeight, maxPixelError, frustum);
+        submit(shader);
+    }
+
+    // draws every instance of the buffer (transform and material per instance, see instancing.h) with one draw
+    // call per mesh, all meshes at the same level of detail
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances, unsigned int lod = 0)
+    {
+        drawnTriangles = 0;
+        for (auto &mesh : meshes)
+        {
+            mesh.DrawInstanced(shader, instances, lod);
+            drawnTriangles += mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)].indexCount / 3 * (unsigned int)instances.Count();
+        }
+        drawCalls = instances.Count() > 0 ? (unsigned int)meshes.size() : 0;
+    }
+
+    // adds the meshes as objects of a GPU-driven scene (see gpuscene.h). The meshes are drawn from the arena, so
+    // UseArena has to be called first; returns false (and adds nothing) otherwise.
+    bool AddTo(GpuScene &scene, const glm::mat4 &model) const
+    {
+        if (!arena || arenaRanges.size() != meshes.size())
+            return false;
+        for (size_t i = 0; i < meshes.size(); i++)
+            scene.Add(meshes[i], arenaRanges[i], model);
+        return true;
+    }
+
+    // records the meshes as packets of the render queue instead of drawing them (levels of detail as in Draw).
+    // modelUniform is set to the model matrix for each mesh; the model must not change until the queue is submitted.
+    void Enqueue(RenderQueue &queue, Shader &shader, UniformHandle<glm::mat4> modelUniform, const Camera &camera, const glm::mat4 &model,
+                 float viewportHeight, float maxPixelError = 1.0f, unsigned int pass = 0, const Frustum *frustum = nullptr)
+    {
+        selectLods(camera, model, viewportHeight, maxPixelError, frustum);
+        bool fromArena = drawFromArena && arenaRanges.size() == meshes.size() && vertexLayout == VertexLayout::Full;
+        drawnTriangles = 0;
+        drawCalls = 0;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            if (m_drawLods[i] == CULLED)
+                continue;
+            const Mesh &mesh = meshes[i];
+            const MeshLod &level = mesh.lods[std::min<size_t>(m_drawLods[i], mesh.lods.size() - 1)];
+            DrawPacket packet;
+            packet.shader = &shader;
+            packet.material = &mesh.material;
+            packet.mesh = &mesh;
+            packet.vao = fromArena ? arena->VAO() : mesh.VAO;
+            packet.count = (GLsizei)level.indexCount;
+            packet.firstIndex = level.indexOffset + (fromArena ? arenaRanges[i].firstIndex : 0);
+            packet.baseVertex = fromArena ? arenaRanges[i].baseVertex : 0;
+            packet.modelUniform = modelUniform;
+            packet.model = model;
+            queue.Push(packet, pass, m_drawDistances[i]);
+            drawnTriangles += level.indexCount / 3;
+            drawCalls++;
+        }
     }
     
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    MeshArena *arena = nullptr;
+    vector<MeshArena::Range> arenaRanges; // per mesh
+    bool drawFromArena = false;
+    // per draw scratch arrays, kept to avoid allocations every frame
+    static const unsigned int CULLED = ~0u; // in m_drawLods: the mesh is not drawn
+    vector<unsigned int> m_drawLods;
+    vector<float> m_drawDistances;
+    BoundsSoA m_worldBounds;
+    vector<uint32_t> m_visible;
+    vector<GLsizei> m_counts;
+    vector<const void *> m_offsets;
+    vector<GLint> m_baseVertices;
+
+    // a new arenaSerial
+    static unsigned int nextArenaSerial()
+    {
+        static unsigned int placements = 0;
+        return ++placements;
+    }
+
+    // box and sphere of each mesh from its vertex positions (see Mesh::computeBounds)
+    void computeMeshBounds()
+    {
+        meshBounds.Clear();
+        for (auto &mesh : meshes)
+            meshBounds.Add(mesh.boundsMin, mesh.boundsMin + mesh.boundsExtent);
+    }
+
+    // picks the level of each mesh (m_drawLods) from the projected error, see Draw. Meshes outside the frustum
+    // (if there is one) get CULLED.
+    void selectLods(const Camera &camera, const glm::mat4 &model, float viewportHeight, float maxPixelError, const Frustum *frustum)
+    {
+        if (meshBounds.Size() != meshes.size())
+            computeMeshBounds();
+        m_worldBounds.Transform(meshBounds, model);
+        // errors are in model units, scale them with the largest axis scale of the model matrix
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        m_drawLods.clear();
+        m_drawDistances.clear();
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            float distance = glm::length(m_worldBounds.Center(i) - camera.Position) - m_worldBounds.radius[i]; // closest point of the bounding sphere
+            m_drawLods.push_back(meshes[i].SelectLod(camera.ProjectedSize(scale, distance, viewportHeight), maxPixelError));
+            m_drawDistances.push_back(std::max(distance, 0.0f));
+        }
+
+        culledMeshes = 0;
+        if (!frustum)
+            return;
+        m_worldBounds.Cull(*frustum, m_visible);
+        culledMeshes = (unsigned int)(meshes.size() - m_visible.size());
+        // m_visible is ascending: mark everything between two visible meshes
+        size_t next = 0;
+        for (uint32_t visible : m_visible)
+        {
+            for (; next < visible; next++)
+                m_drawLods[next] = CULLED;
+            next = visible + 1;
+        }
+        for (; next < meshes.size(); next++)
+            m_drawLods[next] = CULLED;
+    }
+
+    // draws each mesh at the level in m_drawLods. From the arena, untextured meshes are drawn with a single
+    // glMultiDrawElementsBaseVertex, textured ones with one draw each (but still without VAO switches).
+    void submit(Shader &shader)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        drawnTriangles = 0;
+        drawCalls = 0;
+        for (size_t i = 0; i < meshes.size(); i++)
+            if (m_drawLods[i] != CULLED)
+                drawnTriangles += meshes[i].lods[std::min<size_t>(m_drawLods[i], meshes[i].lods.size() - 1)].indexCount / 3;
+
+        if (!drawFromArena || arenaRanges.size() != meshes.size() || vertexLayout != VertexLayout::Full)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            for (size_t i = 0; i < meshes.size(); i++)
+            {
+                if (m_drawLods[i] == CULLED)
+                    continue;
+                meshes[i].Draw(shader, m_drawLods[i]);
+                drawCalls++;
+            }
             return;
         }
+
+        glUniform1i(vertexDecodeUniforms().Resolve(shader)[0], 0);
+        m_counts.clear();
+        m_offsets.clear();
+        m_baseVertices.clear();
+        arena->Bind();
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            if (m_drawLods[i] == CULLED)
+                continue;
+            const MeshLod &level = meshes[i].lods[std::min<size_t>(m_drawLods[i], meshes[i].lods.size() - 1)];
+            const void *offset = (const void *)((arenaRanges[i].firstIndex + level.indexOffset) * sizeof(unsigned int));
+            if (!meshes[i].material.Empty())
+            {
+                meshes[i].material.Bind(shader);
+                glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)level.indexCount, GL_UNSIGNED_INT, (void *)offset, arenaRanges[i].baseVertex);
+                drawCalls++;
+                continue;
+            }
+            m_counts.push_back((GLsizei)level.indexCount);
+            m_offsets.push_back(offset);
+            m_baseVertices.push_back(arenaRanges[i].baseVertex);
+        }
+        if (!m_counts.empty())
+        {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_counts.data(), GL_UNSIGNED_INT, m_offsets.data(), (GLsizei)m_counts.size(), m_baseVertices.data());
+            drawCalls++;
+        }
+    }
+
+    static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // the flags of the mesh cache file: the processing, and whether the texture references are in it
+    uint32_t cacheFlags() const
+    {
+        return meshProcessing | (loadTexturesFromModel ? MESH_CACHE_TEXTURES : 0);
+    }
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    void loadModel(string const &path)
+    {
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // try the binary mesh cache first, it is written after every successful import
+        if (meshCacheEnabled && loadFromCache(path))
+            return;
+
+        auto t1 = std::chrono::high_resolution_clock::now();
+        if (isGltfFile(path))
+        {
+            if (!loadGltf(path))
+                return;
+        }
+        else if ((meshProcessing & MESH_PROCESS_FAST_OBJ) && isObjFile(path))
+        {
+            if (!loadObj(path))
+                return;
+        }
+        else
+        {
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return;
+            }
+
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene);
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        importMilliseconds = (unsigned int)std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+
+        if (meshCacheEnabled && !writeMeshCache(path, meshes, IMPORT_FLAGS, importMilliseconds, cacheFlags(), optimizationStats))
+            cout << "WARNING::MESH_CACHE:: could not write " << meshCachePath(path, cacheFlags()) << endl;
+    }
+
+    // creates the meshes from a valid cache file; each mesh is uploaded straight from the mapped file.
+    bool loadFromCache(string const &path)
+    {
+        MeshCache cache;
+        if (!cache.open(path, IMPORT_FLAGS, cacheFlags()))
+            return false;
+
+        GltfFile gltf; // opened for the first image of a glTF file, they are not files of their own
+        bool gltfTried = false, gltfOpen = false;
+        for (uint32_t i = 0; i < cache.meshCount(); i++)
+        {
+            vector<Texture> textures;
+            if (loadTexturesFromModel)
+            {
+                for (auto &t : cache.textures(i))
+                {
+                    int source, channel;
+                    if (!parseGltfImageKey(t.second, source, channel))
+                    {
+                        textures.push_back(loadTextureOnce(t.second.c_str(), t.first));
+                        continue;
+                    }
+                    if (!gltfTried)
+                    {
+                        gltfTried = true;
+                        gltfOpen = gltf.open(path);
+                    }
+                    if (!gltfOpen)
+                        continue;
+                    Texture texture;
+                    texture.id = loadGltfTexture(gltf, source, textureUsageForType(t.first), channel, texture.path);
+                    texture.type = t.first;
+                    if (texture.id != 0)
+                        textures.push_back(texture);
+                }
+            }
+            const MeshCacheEntry &e = cache.entry(i);
+            meshes.push_back(Mesh(cache.vertices(i), e.vertexCount, cache.indices(i), e.indexCount, textures, !deferUpload));
+            if (e.lodCount > 0)
+                meshes.back().lods.assign(cache.lods(i), cache.lods(i) + e.lodCount);
+        }
+        loadedFromCache = true;
+        importMilliseconds = cache.importMilliseconds();
+        optimizationStats = cache.header().optimizationStats;
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -166,7 +571,165 @@ private:
         }
         
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return createMesh(vertices, indices, textures);
+    }
+
+    // applies the MESH_PROCESS_* steps to freshly loaded data and moves it into a new mesh (all loaders)
+    Mesh createMesh(vector<Vertex> &vertices, vector<unsigned int> &indices, vector<Texture> &textures)
+    {
+        // weld and reorder before the data is moved into the mesh
+        if (meshProcessing & MESH_PROCESS_OPTIMIZE)
+            optimizationStats.add(optimizeMesh(vertices, indices));
+        vector<MeshLod> lods;
+        if (meshProcessing & MESH_PROCESS_LODS)
+            lods = generateLods(vertices, indices, meshProcessing & MESH_PROCESS_OPTIMIZE);
+
+        Mesh result(std::move(vertices), std::move(indices), std::move(textures), !deferUpload);
+        if (!lods.empty())
+            result.lods = lods;
+        return result;
+    }
+
+    // reads an OBJ file with objparser.h, textures are taken from the MTL file like Assimp does
+    bool loadObj(string const &path)
+    {
+        ObjFile file;
+        if (!readObjFile(path, file))
+            return false;
+        for (auto &objMesh : file.meshes)
+        {
+            vector<Texture> textures;
+            auto material = file.materials.find(objMesh.material);
+            if (loadTexturesFromModel && material != file.materials.end())
+            {
+                const pair<string, const char *> maps[] = {{material->second.diffuseMap, "texture_diffuse"},
+                                                           {material->second.specularMap, "texture_specular"},
+                                                           {material->second.normalMap, "texture_normal"},
+                                                           {material->second.heightMap, "texture_height"}};
+                for (auto &map : maps)
+                    if (!map.first.empty())
+                        textures.push_back(loadTextureOnce(map.first.c_str(), map.second));
+            }
+            meshes.push_back(createMesh(objMesh.vertices, objMesh.indices, textures));
+        }
+        return !meshes.empty();
+    }
+
+    // reads the triangle primitives of all mesh nodes of a glTF file, one Mesh per primitive
+    bool loadGltf(string const &path)
+    {
+        GltfFile file;
+        if (!file.open(path))
+            return false;
+        forEachGltfMesh(file, [&](const JsonValue &mesh, const glm::mat4 &transform)
+                        {
+            const JsonValue &primitives = mesh["primitives"];
+            for (size_t p = 0; p < primitives.size(); p++)
+            {
+                vector<Vertex> vertices;
+                vector<unsigned int> indices;
+                if (!readGltfPrimitive(file, primitives[p], transform, vertices, indices))
+                {
+                    cout << "WARNING::GLTF:: skipped unsupported primitive of mesh " << mesh["name"].asString() << endl;
+                    continue;
+                }
+                vector<Texture> textures;
+                if (loadTexturesFromModel)
+                    textures = loadGltfMaterial(file, primitives[p]["material"].asInt());
+                meshes.push_back(createMesh(vertices, indices, textures));
+            } });
+        return !meshes.empty();
+    }
+
+    // the textures of a glTF material, named after the samplers of the PBR shader (albedoMap, normalMap,
+    // metallicMap, roughnessMap, aoMap). Metallic (blue) and roughness (green) share one image in glTF,
+    // they are split into two single channel textures.
+    vector<Texture> loadGltfMaterial(const GltfFile &file, int materialIndex)
+    {
+        vector<Texture> textures;
+        const JsonValue &material = file.json()["materials"][materialIndex];
+        if (material.isNull())
+            return textures;
+        const JsonValue &pbr = material["pbrMetallicRoughness"];
+        auto add = [&](const JsonValue &textureInfo, const char *type, TexUsage usage, int channel)
+        {
+            if (!textureInfo.has("index"))
+                return;
+            Texture texture;
+            int source = file.json()["textures"][textureInfo["index"].asInt()]["source"].asInt();
+            texture.id = loadGltfTexture(file, source, usage, channel, texture.path);
+            texture.type = type;
+            if (texture.id != 0)
+                textures.push_back(texture);
+        };
+        add(pbr["baseColorTexture"], "albedoMap", TexUsage::Color, -1);
+        add(material["normalTexture"], "normalMap", TexUsage::Normal, -1);
+        add(pbr["metallicRoughnessTexture"], "metallicMap", TexUsage::Mask, 2);
+        add(pbr["metallicRoughnessTexture"], "roughnessMap", TexUsage::Mask, 1);
+        add(material["occlusionTexture"], "aoMap", TexUsage::Mask, 0);
+        return textures;
+    }
+
+    // decodes (embedded or external) image source of a glTF file, channel >= 0 moves that channel into red.
+    // Each (image, channel) pair is loaded once per model, and through the texture cache keyed by the content of
+    // the image, so models that share images (embedded or not) share the textures. key names the pair (see
+    // parseGltfImageKey), it is the texture path stored in the mesh cache.
+    unsigned int loadGltfTexture(const GltfFile &file, int source, TexUsage usage, int channel, string &key)
+    {
+        key = "gltf-image-" + std::to_string(source) + (channel >= 0 ? "#" + std::to_string(channel) : "");
+        for (auto &loaded : textures_loaded)
+            if (loaded.path == key)
+                return loaded.id;
+
+        const uint8_t *bytes = nullptr;
+        size_t size = 0;
+        string externalPath;
+        if (source < 0 || !file.image(source, bytes, size, externalPath))
+        {
+            cout << "Texture failed to load: glTF image " << source << endl;
+            return 0;
+        }
+        auto load = [&]() -> unsigned int
+        {
+            RgbaImage image;
+            int nrComponents;
+            unsigned char *pixels;
+            stbi_set_flip_vertically_on_load_thread(false); // glTF texture coordinates start at the top left
+            if (externalPath.empty())
+                pixels = stbi_load_from_memory(bytes, (int)size, &image.width, &image.height, &nrComponents, 4);
+            else
+                pixels = stbi_load(externalPath.c_str(), &image.width, &image.height, &nrComponents, 4);
+            if (!pixels)
+                return 0;
+            image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+            stbi_image_free(pixels);
+            if (channel > 0)
+                for (size_t i = 0; i < image.pixels.size(); i += 4)
+                    image.pixels[i] = image.pixels[i + channel];
+            return uploadRgbaImage(std::move(image), usage, GL_REPEAT); // the glTF default sampler
+        };
+        uint32_t variant = textureVariant(false, usage, GL_REPEAT) | textureChannelVariant(channel);
+        unsigned int id = externalPath.empty() ? textureCache().AcquireContent(hashBytes(bytes, size), variant, load)
+                                               : textureCache().Acquire(externalPath, variant, load);
+        if (id == 0)
+        {
+            cout << "Texture failed to load: glTF image " << source << endl;
+            return 0;
+        }
+        textures_loaded.push_back({id, "", key}); // one reference, dropped by ReleaseTextures
+        return id;
+    }
+
+    // the image source and channel of a key of loadGltfTexture, false for the paths of other textures
+    static bool parseGltfImageKey(const string &key, int &source, int &channel)
+    {
+        const string prefix = "gltf-image-";
+        if (key.compare(0, prefix.size(), prefix) != 0)
+            return false;
+        size_t hash = key.find('#', prefix.size());
+        source = std::atoi(key.c_str() + prefix.size());
+        channel = hash != string::npos ? std::atoi(key.c_str() + hash + 1) : -1;
+        return true;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -178,41 +741,50 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadTextureOnce(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // how a texture of the model is compressed: normal maps keep x and y (BC5), height maps and the single channel
+    // maps of glTF materials are one channel, diffuse, specular and albedo maps are colors
+    static TexUsage textureUsageForType(const string &typeName)
+    {
+        if (typeName == "texture_normal" || typeName == "normalMap")
+            return TexUsage::Normal;
+        if (typeName == "texture_height" || typeName == "metallicMap" || typeName == "roughnessMap" || typeName == "aoMap")
+            return TexUsage::Mask;
+        return TexUsage::Color;
+    }
+
+    // loads a texture of the model through the global texture cache, so a file (or the same content under another
+    // name) that was loaded before, by this or any other model or loader, is not loaded again
+    Texture loadTextureOnce(const char *path, const string &typeName)
+    {
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory, gammaCorrection, textureUsageForType(typeName));
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture); // one reference per request, dropped by ReleaseTextures
+        return texture;
+    }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// loads an image file into a new texture with REPEAT wrapping (see TextureFromFile). Block compressed when possible,
+// the usage picks the format (see TexUsage); uncompressed maps are stored as they are in the file (linear mips).
+// ---------------------------------------------------
+unsigned int textureFromFileUncached(const string &filename, TexUsage usage)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
+    unsigned int textureID = 0;
+    if (textureCompressionEnabled)
+        textureID = uploadCompressedTexture(loadCompressedTexture(filename, false, usage), GL_REPEAT);
+    if (textureID != 0)
+        return textureID;
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
+    stbi_set_flip_vertically_on_load_thread(false); // the flag is per thread, a previous decode may have set it
     unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
     if (data)
     {
@@ -224,7 +796,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().BindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -237,10 +809,20 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        std::cout << "Texture failed to load at path: " << filename << std::endl;
         stbi_image_free(data);
     }
 
     return textureID;
 }
+
+// loads a texture of a model file (path relative to directory). Textures are shared through the global texture
+// cache: the returned texture holds a reference, give it back with textureCache().Release.
+// ---------------------------------------------------
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, TexUsage usage)
+{
+    string filename = directory + '/' + string(path);
+    return textureCache().Acquire(filename, textureVariant(false, usage, GL_REPEAT), [&]
+                                  { return textureFromFileUncached(filename, usage); });
+}
 #endif
@@ -0,0 +1,593 @@
+#pragma once
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <glm/glm.hpp>
+
+#include <util/mappedfile.h>
+#include <util/mesh.h>
+#include <util/threadpool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Wavefront OBJ/MTL reader, a fast path beside the Assimp importer (see MESH_PROCESS_FAST_OBJ in meshcache.h).
+// The file is memory-mapped and split at line boundaries into chunks that are parsed in parallel; numbers are
+// read 8 characters at a time with SWAR (SIMD within a register) digit tests and conversion. Afterwards every
+// mesh resolves its face indices and welds identical position/texcoord/normal corners in a single pass, writing
+// straight into the Vertex layout. The output matches the Assimp import with IMPORT_FLAGS of Model: polygons
+// are fan triangulated, v is flipped (1 - v) and tangents are generated. Meshes are split at o/g and usemtl.
+// Not supported: line continuations, free-form geometry, vertex colors (ignored).
+
+// the OBJ material properties Model uses (texture paths relative to the .mtl file)
+struct ObjMaterial
+{
+    std::string diffuseMap;  // map_Kd
+    std::string specularMap; // map_Ks
+    std::string normalMap;   // map_Bump / bump (Assimp: aiTextureType_HEIGHT)
+    std::string heightMap;   // map_Ka (Assimp: aiTextureType_AMBIENT)
+};
+
+struct ObjMesh
+{
+    std::string name;
+    std::string material;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+struct ObjFile
+{
+    std::vector<ObjMesh> meshes;
+    std::map<std::string, ObjMaterial> materials;
+};
+
+// index of the lowest set bit (x != 0)
+// ---------------------------------------------------
+int countTrailingZeros64(uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// the next 8 characters as one little endian word (first character in the lowest byte), zero padded at the end
+// ---------------------------------------------------
+uint64_t loadObjWord(const char *p, const char *end)
+{
+    uint64_t word = 0;
+    std::memcpy(&word, p, std::min<size_t>(8, end - p));
+    return word;
+}
+
+// number of leading ASCII digits in a word: a byte is a digit if its high nibble is 3 and adding 6 does not
+// carry out of the low nibble. A carry out of a non-digit byte only disturbs the bytes after it.
+// ---------------------------------------------------
+int objDigitCount(uint64_t word)
+{
+    const uint64_t high = 0xF0F0F0F0F0F0F0F0ull, three = 0x3030303030303030ull;
+    uint64_t nonDigit = ((word & high) ^ three) | (((word + 0x0606060606060606ull) & high) ^ three);
+    return nonDigit ? countTrailingZeros64(nonDigit) / 8 : 8;
+}
+
+// value of the first n (1..8) digits of a word. The digits are shifted to the top so the free bytes act as
+// leading zeros, then pairs, quads and octets are combined with three multiplications.
+// ---------------------------------------------------
+uint32_t objDigitValue(uint64_t word, int n)
+{
+    word = (word - 0x3030303030303030ull) << (8 * (8 - n));
+    word = word * 10 + (word >> 8);
+    word = (((word & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+            (((word >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return (uint32_t)word;
+}
+
+// accumulates a run of digits into mantissa (at most 19 significant digits), returns the position after them.
+// Dropped integer digits raise the exponent, kept fraction digits lower it.
+// ---------------------------------------------------
+const char *parseObjDigits(const char *p, const char *end, uint64_t &mantissa, int &digits, int &exponent, bool fraction)
+{
+    static const uint64_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+    while (p < end)
+    {
+        uint64_t word = loadObjWord(p, end);
+        int n = std::min(objDigitCount(word), (int)(end - p));
+        if (n == 0)
+            break;
+        int keep = std::min(n, 19 - digits);
+        if (keep > 0)
+        {
+            mantissa = mantissa * POW10[keep] + objDigitValue(word, keep);
+            digits += keep;
+            if (fraction)
+                exponent -= keep;
+        }
+        if (!fraction)
+            exponent += n - std::max(keep, 0);
+        p += n;
+        if (n < 8)
+            break;
+    }
+    return p;
+}
+
+// parses a decimal floating point number (optional sign, fraction and exponent), nullptr if there is none
+// ---------------------------------------------------
+const char *parseObjFloat(const char *p, const char *end, float &value)
+{
+    static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    const char *start = p;
+    p = parseObjDigits(p, end, mantissa, digits, exponent, false);
+    if (p < end && *p == '.')
+        p = parseObjDigits(p + 1, end, mantissa, digits, exponent, true);
+    if (p == start || (p == start + 1 && *start == '.'))
+        return nullptr;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+        int e = 0;
+        for (; q < end && *q >= '0' && *q <= '9'; q++)
+            e = std::min(e * 10 + (*q - '0'), 10000);
+        exponent += negativeExponent ? -e : e;
+        p = q;
+    }
+
+    // exact for mantissas below 2^53 and |exponent| <= 22, plenty for single precision
+    double result = (double)mantissa;
+    if (exponent < 0 && exponent >= -22)
+        result /= POW10[-exponent];
+    else if (exponent > 0 && exponent <= 22)
+        result *= POW10[exponent];
+    else if (exponent != 0)
+        result *= std::pow(10.0, exponent);
+    value = (float)(negative ? -result : result);
+    return p;
+}
+
+// parses an optionally negative integer, nullptr if there is none
+// ---------------------------------------------------
+const char *parseObjInt(const char *p, const char *end, int &value)
+{
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+    uint64_t word = loadObjWord(p, end);
+    int n = std::min(objDigitCount(word), (int)(end - p));
+    if (n == 0)
+        return nullptr;
+    int64_t result = objDigitValue(word, n);
+    p += n;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) // more than 8 digits
+        result = std::min<int64_t>(result * 10 + (*p - '0'), INT_MAX);
+    value = (int)(negative ? -result : result);
+    return p;
+}
+
+// one corner of a face: 0-based indices (-1 if missing). Negative OBJ indices are relative to the elements
+// read so far; inside a chunk they are stored relative to the chunk start, offset by OBJ_RELATIVE_BASE.
+struct ObjCorner
+{
+    int position, texCoord, normal;
+};
+
+const int OBJ_RELATIVE_BASE = INT_MIN / 2;
+
+// a change of the object/group name or the material, starting at corner `corner` of the chunk
+struct ObjMeshSwitch
+{
+    size_t corner;
+    bool material; // usemtl, otherwise o/g
+    std::string name;
+};
+
+// what one thread read from its part of the file
+struct ObjChunk
+{
+    const char *begin, *end;
+    std::vector<float> positions; // xyz
+    std::vector<float> texCoords; // uv
+    std::vector<float> normals;   // xyz
+    std::vector<ObjCorner> corners; // three per triangle
+    std::vector<ObjMeshSwitch> switches;
+    std::vector<std::string> materialLibraries;
+    size_t positionStart = 0, texCoordStart = 0, normalStart = 0; // counts of all previous chunks
+    size_t errorLine = 0; // 1-based line in the chunk, 0 if there was no error
+};
+
+// the rest of the line without surrounding white space
+// ---------------------------------------------------
+std::string objLineRest(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    const char *last = p;
+    while (last < end && *last != '\n' && *last != '\r')
+        last++;
+    while (last > p && (last[-1] == ' ' || last[-1] == '\t'))
+        last--;
+    return std::string(p, last);
+}
+
+// reads n floats separated by white space into values, false if one is missing
+// ---------------------------------------------------
+bool parseObjFloats(const char *&p, const char *end, int n, std::vector<float> &values)
+{
+    for (int i = 0; i < n; i++)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        float value;
+        const char *next = parseObjFloat(p, end, value);
+        if (!next)
+            return false;
+        values.push_back(value);
+        p = next;
+    }
+    return true;
+}
+
+// one face index: 1-based becomes 0-based, negative becomes chunk relative (see ObjCorner)
+// ---------------------------------------------------
+const char *parseObjIndex(const char *p, const char *end, size_t count, int &index)
+{
+    int value;
+    p = parseObjInt(p, end, value);
+    if (!p || value == 0)
+        return nullptr;
+    index = value > 0 ? value - 1 : OBJ_RELATIVE_BASE + (int)count + value;
+    return p;
+}
+
+// reads the face corners of a line and fan triangulates them
+// ---------------------------------------------------
+bool parseObjFace(const char *p, const char *end, ObjChunk &chunk)
+{
+    ObjCorner first, previous;
+    int count = 0;
+    while (true)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        if (p == end || *p == '\n' || *p == '\r' || *p == '#')
+            break;
+        ObjCorner corner = {-1, -1, -1};
+        p = parseObjIndex(p, end, chunk.positions.size() / 3, corner.position);
+        if (!p)
+            return false;
+        if (p < end && *p == '/')
+        {
+            p++;
+            if (p < end && *p != '/' && !(p = parseObjIndex(p, end, chunk.texCoords.size() / 2, corner.texCoord)))
+                return false;
+            if (p < end && *p == '/' && !(p = parseObjIndex(p + 1, end, chunk.normals.size() / 3, corner.normal)))
+                return false;
+        }
+        if (count == 0)
+            first = corner;
+        else if (count >= 2)
+        {
+            chunk.corners.push_back(first);
+            chunk.corners.push_back(previous);
+            chunk.corners.push_back(corner);
+        }
+        previous = corner;
+        count++;
+    }
+    return count >= 3;
+}
+
+// true if the line at p starts with the keyword followed by white space
+// ---------------------------------------------------
+bool objKeyword(const char *p, const char *end, const char *keyword)
+{
+    size_t length = std::strlen(keyword);
+    return (size_t)(end - p) > length && std::memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+}
+
+// parses all lines of a chunk
+// ---------------------------------------------------
+void parseObjChunk(ObjChunk &chunk)
+{
+    const char *p = chunk.begin, *end = chunk.end;
+    size_t line = 0;
+    while (p < end)
+    {
+        line++;
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        const char *lineStart = p;
+        bool ok = true;
+        if (objKeyword(p, end, "v"))
+            ok = parseObjFloats(p += 2, end, 3, chunk.positions);
+        else if (objKeyword(p, end, "vt"))
+            ok = parseObjFloats(p += 3, end, 2, chunk.texCoords);
+        else if (objKeyword(p, end, "vn"))
+            ok = parseObjFloats(p += 3, end, 3, chunk.normals);
+        else if (objKeyword(p, end, "f"))
+            ok = parseObjFace(p + 2, end, chunk);
+        else if (objKeyword(p, end, "o") || objKeyword(p, end, "g"))
+            chunk.switches.push_back({chunk.corners.size(), false, objLineRest(p + 2, end)});
+        else if (objKeyword(p, end, "usemtl"))
+            chunk.switches.push_back({chunk.corners.size(), true, objLineRest(p + 7, end)});
+        else if (objKeyword(p, end, "mtllib"))
+            chunk.materialLibraries.push_back(objLineRest(p + 7, end));
+        if (!ok)
+        {
+            chunk.errorLine = line;
+            return;
+        }
+        // skip to the next line (vt with a w component, comments, unsupported statements)
+        p = (const char *)std::memchr(std::max(p, lineStart), '\n', end - std::max(p, lineStart));
+        p = p ? p + 1 : end;
+    }
+}
+
+// reads the materials of a .mtl file (later definitions replace earlier ones)
+// ---------------------------------------------------
+void readObjMaterials(const std::string &path, std::map<std::string, ObjMaterial> &materials)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "WARNING::OBJ:: material library " << path << " not found" << std::endl;
+        return;
+    }
+    ObjMaterial *material = nullptr;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        std::string rest = objLineRest(line.c_str() + std::min(line.size(), line.find(keyword) + keyword.size()), line.c_str() + line.size());
+        if (keyword == "newmtl")
+            material = &(materials[rest] = ObjMaterial());
+        else if (!material || rest.empty())
+            continue;
+        // options like -bm 1.0 are skipped, the file name is the last word
+        size_t space = rest.find_last_of(" \t");
+        std::string map = space == std::string::npos ? rest : rest.substr(space + 1);
+        if (keyword == "map_Kd")
+            material->diffuseMap = map;
+        else if (keyword == "map_Ks")
+            material->specularMap = map;
+        else if (keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump")
+            material->normalMap = map;
+        else if (keyword == "map_Ka")
+            material->heightMap = map;
+    }
+}
+
+// a range of corners of one chunk that belongs to a mesh
+struct ObjCornerRange
+{
+    size_t chunk, begin, end;
+};
+
+// resolves a chunk relative index (see ObjCorner), returns false if it is outside of [0, count)
+// ---------------------------------------------------
+bool resolveObjIndex(int &index, size_t chunkStart, size_t count)
+{
+    if (index < -1)
+        index = index - OBJ_RELATIVE_BASE + (int)chunkStart;
+    return index >= 0 && (size_t)index < count;
+}
+
+// builds the vertices and indices of a mesh from its corner ranges: index resolution and welding of equal
+// corners (open addressing hash table over the index triples) happen in one pass
+// ---------------------------------------------------
+bool buildObjMesh(const std::vector<ObjChunk> &chunks, const std::vector<ObjCornerRange> &ranges,
+                  const std::vector<float> &positions, const std::vector<float> &texCoords, const std::vector<float> &normals, ObjMesh &mesh)
+{
+    size_t cornerCount = 0;
+    for (auto &range : ranges)
+        cornerCount += range.end - range.begin;
+    size_t tableSize = 16;
+    while (tableSize < cornerCount * 2)
+        tableSize *= 2;
+    std::vector<uint32_t> table(tableSize, UINT32_MAX);
+    std::vector<ObjCorner> keys; // corner of each vertex
+    keys.reserve(cornerCount / 2);
+    mesh.vertices.reserve(cornerCount / 2);
+    mesh.indices.reserve(cornerCount);
+
+    size_t positionCount = positions.size() / 3, texCoordCount = texCoords.size() / 2, normalCount = normals.size() / 3;
+    bool hasNormals = false;
+    for (auto &range : ranges)
+    {
+        const ObjChunk &chunk = chunks[range.chunk];
+        for (size_t c = range.begin; c < range.end; c++)
+        {
+            ObjCorner corner = chunk.corners[c];
+            if (!resolveObjIndex(corner.position, chunk.positionStart, positionCount) ||
+                (corner.texCoord != -1 && !resolveObjIndex(corner.texCoord, chunk.texCoordStart, texCoordCount)) ||
+                (corner.normal != -1 && !resolveObjIndex(corner.normal, chunk.normalStart, normalCount)))
+                return false;
+
+            size_t slot = ((uint32_t)corner.position * 73856093u ^ (uint32_t)corner.texCoord * 19349663u ^ (uint32_t)corner.normal * 83492791u) & (tableSize - 1);
+            while (table[slot] != UINT32_MAX)
+            {
+                const ObjCorner &key = keys[table[slot]];
+                if (key.position == corner.position && key.texCoord == corner.texCoord && key.normal == corner.normal)
+                    break;
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if (table[slot] == UINT32_MAX)
+            {
+                table[slot] = (uint32_t)mesh.vertices.size();
+                keys.push_back(corner);
+                Vertex vertex = {};
+                const float *position = &positions[corner.position * 3];
+                vertex.Position = glm::vec3(position[0], position[1], position[2]);
+                if (corner.texCoord >= 0)
+                    vertex.TexCoords = glm::vec2(texCoords[corner.texCoord * 2], 1.0f - texCoords[corner.texCoord * 2 + 1]);
+                if (corner.normal >= 0)
+                {
+                    const float *normal = &normals[corner.normal * 3];
+                    vertex.Normal = glm::vec3(normal[0], normal[1], normal[2]);
+                    hasNormals = true;
+                }
+                mesh.vertices.push_back(vertex);
+            }
+            mesh.indices.push_back(table[slot]);
+        }
+    }
+
+    if (!hasNormals) // smooth normals from the area weighted face normals
+    {
+        for (size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            Vertex &v0 = mesh.vertices[mesh.indices[i]], &v1 = mesh.vertices[mesh.indices[i + 1]], &v2 = mesh.vertices[mesh.indices[i + 2]];
+            glm::vec3 n = glm::cross(v1.Position - v0.Position, v2.Position - v0.Position);
+            v0.Normal += n;
+            v1.Normal += n;
+            v2.Normal += n;
+        }
+        for (auto &v : mesh.vertices)
+        {
+            float length = glm::length(v.Normal);
+            v.Normal = length > 0.0f ? v.Normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+    computeTangents(mesh.vertices, mesh.indices);
+    return true;
+}
+
+// utility function for reading an OBJ file and its material libraries, returns false on errors
+// ---------------------------------------------------
+bool readObjFile(const std::string &path, ObjFile &result)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        std::cout << "ERROR::OBJ:: could not open " << path << std::endl;
+        return false;
+    }
+
+    // split at line ends into about 256 KB per chunk, at most a few per thread
+    const char *data = (const char *)file.data(), *dataEnd = data + file.size();
+    size_t chunkCount = std::max<size_t>(1, std::min(file.size() / (256 * 1024), (workerPool().size() + 1) * 4));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char *p = data;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        chunks[i].begin = p;
+        const char *split = i + 1 == chunkCount ? dataEnd : std::max(p, data + file.size() * (i + 1) / chunkCount);
+        const char *newline = (const char *)std::memchr(split, '\n', dataEnd - split);
+        p = newline ? newline + 1 : dataEnd;
+        chunks[i].end = p;
+    }
+    parallelFor(chunkCount, [&](size_t i)
+                { parseObjChunk(chunks[i]); });
+
+    // global element offsets of the chunks, then one array per attribute
+    size_t positionCount = 0, texCoordCount = 0, normalCount = 0, line = 0;
+    for (auto &chunk : chunks)
+    {
+        if (chunk.errorLine)
+        {
+            std::cout << "ERROR::OBJ:: syntax error in line " << line + chunk.errorLine << " of " << path << std::endl;
+            return false;
+        }
+        line += std::count(chunk.begin, chunk.end, '\n');
+        chunk.positionStart = positionCount;
+        chunk.texCoordStart = texCoordCount;
+        chunk.normalStart = normalCount;
+        positionCount += chunk.positions.size() / 3;
+        texCoordCount += chunk.texCoords.size() / 2;
+        normalCount += chunk.normals.size() / 3;
+    }
+    std::vector<float> positions(positionCount * 3), texCoords(texCoordCount * 2), normals(normalCount * 3);
+    parallelFor(chunkCount, [&](size_t i)
+                {
+        const ObjChunk &chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionStart * 3);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.texCoordStart * 2);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalStart * 3); });
+
+    // group the corners into meshes: one per object/group name and material, in order of appearance
+    std::string object = "default", material;
+    std::map<std::pair<std::string, std::string>, size_t> meshIndex;
+    std::vector<std::vector<ObjCornerRange>> meshRanges;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        const ObjChunk &chunk = chunks[i];
+        size_t begin = 0;
+        for (size_t s = 0; s <= chunk.switches.size(); s++)
+        {
+            size_t end = s < chunk.switches.size() ? chunk.switches[s].corner : chunk.corners.size();
+            if (end > begin)
+            {
+                auto key = std::make_pair(object, material);
+                if (meshIndex.find(key) == meshIndex.end())
+                {
+                    meshIndex[key] = result.meshes.size();
+                    result.meshes.push_back({object, material, {}, {}});
+                    meshRanges.emplace_back();
+                }
+                meshRanges[meshIndex[key]].push_back({i, begin, end});
+            }
+            begin = end;
+            if (s < chunk.switches.size())
+                (chunk.switches[s].material ? material : object) = chunk.switches[s].name;
+        }
+    }
+
+    std::vector<char> valid(result.meshes.size(), 0);
+    parallelFor(result.meshes.size(), [&](size_t m)
+                { valid[m] = buildObjMesh(chunks, meshRanges[m], positions, texCoords, normals, result.meshes[m]); });
+    for (size_t m = 0; m < valid.size(); m++)
+        if (!valid[m])
+        {
+            std::cout << "ERROR::OBJ:: face index out of range in " << result.meshes[m].name << " of " << path << std::endl;
+            return false;
+        }
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    for (auto &chunk : chunks)
+        for (auto &library : chunk.materialLibraries)
+            readObjMaterials(directory + library, result.materials);
+    return true;
+}
+
+// true if the file has the .obj extension (case insensitive)
+// ---------------------------------------------------
+bool isObjFile(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    for (auto &c : extension)
+        c = (char)std::tolower((unsigned char)c);
+    return extension == "obj";
+}
+
+#endif
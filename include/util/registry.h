@@ -0,0 +1,129 @@
+#pragma once
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A lightweight reference to an asset in an AssetRegistry<T>: an index into the slot array plus the
+// generation of the slot. Once an asset is removed, the generation of its slot changes and old handles
+// become invalid instead of silently pointing at whatever is loaded into the slot next.
+template <class T>
+struct Handle
+{
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 is never used by a registry, so a default handle is always invalid
+
+    bool isValid() const { return generation != 0; }
+    // index and generation in one number, e.g. as a map key that does not confuse a recycled slot with its old asset
+    uint64_t Id() const { return (uint64_t)generation << 32 | index; }
+    bool operator==(const Handle &other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Handle &other) const { return !(*this == other); }
+};
+
+// Stores exactly one instance per asset (keyed by e.g. the file path) and hands out handles to it.
+// Get is an array access plus a generation check; the key is only needed when an asset is requested.
+template <class T>
+class AssetRegistry
+{
+public:
+    // returns the handle of an asset, or an invalid handle if nothing is registered under the key
+    Handle<T> Find(const std::string &key) const
+    {
+        auto found = m_keys.find(key);
+        return found != m_keys.end() ? found->second : Handle<T>();
+    }
+
+    // takes ownership of the asset and registers it under key (replaces an asset with the same key)
+    Handle<T> Add(const std::string &key, T asset)
+    {
+        Handle<T> existing = Find(key);
+        if (existing.isValid())
+        {
+            *m_slots[existing.index].asset = std::move(asset);
+            return existing;
+        }
+
+        uint32_t index;
+        if (!m_free.empty())
+        {
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)m_slots.size();
+            m_slots.emplace_back();
+        }
+        Slot &slot = m_slots[index];
+        slot.asset = std::make_unique<T>(std::move(asset)); // heap allocated, so references stay valid when the registry grows
+        slot.key = key;
+        Handle<T> handle{index, slot.generation};
+        m_keys[key] = handle;
+        return handle;
+    }
+
+    // the asset of a valid handle, nullptr for stale handles
+    T *TryGet(Handle<T> handle)
+    {
+        if (handle.index >= m_slots.size() || m_slots[handle.index].generation != handle.generation || !m_slots[handle.index].asset)
+            return nullptr;
+        return m_slots[handle.index].asset.get();
+    }
+
+    T &Get(Handle<T> handle)
+    {
+        T *asset = TryGet(handle);
+        if (!asset)
+            throw std::out_of_range("stale or invalid asset handle");
+        return *asset;
+    }
+
+    bool IsValid(Handle<T> handle) const
+    {
+        return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation && m_slots[handle.index].asset;
+    }
+
+    // destroys the asset and invalidates all handles to it
+    void Remove(Handle<T> handle)
+    {
+        if (!IsValid(handle))
+            return;
+        Slot &slot = m_slots[handle.index];
+        m_keys.erase(slot.key);
+        slot.asset.reset();
+        slot.key.clear();
+        slot.generation = slot.generation + 1 == 0 ? 1 : slot.generation + 1;
+        m_free.push_back(handle.index);
+    }
+
+    const std::string &Key(Handle<T> handle) const { return m_slots.at(handle.index).key; }
+    size_t Size() const { return m_keys.size(); }
+
+    // calls f(handle, asset) for every registered asset
+    template <class F>
+    void ForEach(F f)
+    {
+        for (uint32_t i = 0; i < m_slots.size(); i++)
+            if (m_slots[i].asset)
+                f(Handle<T>{i, m_slots[i].generation}, *m_slots[i].asset);
+    }
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<T> asset;
+        uint32_t generation = 1;
+        std::string key;
+    };
+
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_free;
+    std::unordered_map<std::string, Handle<T>> m_keys;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#pragma once
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include <util/glstate.h>
+#include <util/material.h>
+#include <util/mesh.h>
+#include <util/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// one indexed draw (GL_UNSIGNED_INT indices) with everything it binds, recorded for RenderQueue::Submit
+struct DrawPacket
+{
+    Shader *shader = nullptr;
+    const Material *material = nullptr; // textures, nullptr for none
+    const Mesh *mesh = nullptr;         // sets the compact layout uniforms (Mesh::SetDecodeUniforms), nullptr for none
+    GLuint vao = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLsizei count = 0;
+    size_t firstIndex = 0;
+    GLint baseVertex = 0;
+    // per object uniforms, set if the handle is valid
+    UniformHandle<glm::mat4> modelUniform;
+    glm::mat4 model = glm::mat4(1.0f);
+    UniformHandle<glm::vec3> colorUniform;
+    glm::vec3 color = glm::vec3(1.0f);
+};
+
+// Collects the draws of a frame and submits them sorted by a 64 bit key, so draws with the same shader, material
+// and VAO follow each other and their state is set once for all of them:
+//
+//  bits 63-60 pass | 59-48 shader program | 47-32 material | 31-16 VAO | 15-0 depth (front to back)
+//
+// Program switches and texture binds then depend on the number of different shaders and materials, not on the
+// number of draws. Pointers in the packets have to stay valid until Submit.
+class RenderQueue
+{
+public:
+    float maxDepth = 100.0f; // view distance that maps to the largest depth key (e.g., the far plane)
+
+    struct Stats
+    {
+        unsigned int draws = 0;
+        unsigned int programSwitches = 0;
+        unsigned int materialBinds = 0;
+        unsigned int vaoSwitches = 0;
+    };
+
+    // records a draw. pass orders groups of draws (e.g., opaque before transparent), depth is the distance to the camera.
+    void Push(const DrawPacket &packet, unsigned int pass = 0, float depth = 0.0f)
+    {
+        m_keys.push_back({sortKey(packet, pass, depth), (uint32_t)m_packets.size()});
+        m_packets.push_back(packet);
+    }
+
+    // sorts and draws all recorded packets and clears the queue (render thread only)
+    void Submit()
+    {
+        std::sort(m_keys.begin(), m_keys.end());
+        m_stats = Stats();
+        Shader *shader = nullptr;
+        unsigned int program = 0, material = 0;
+        const Mesh *mesh = nullptr;
+        GLuint vao = 0;
+        for (auto &key : m_keys)
+        {
+            const DrawPacket &packet = m_packets[key.second];
+            bool programChanged = !shader || packet.shader->programSerial != program;
+            shader = packet.shader; // the uniform handles belong to the Shader object
+            if (programChanged)
+            {
+                program = shader->programSerial;
+                shader->use();
+                m_stats.programSwitches++;
+            }
+            unsigned int packetMaterial = packet.material ? packet.material->ID() : 0;
+            if (packetMaterial != 0 && (programChanged || packetMaterial != material))
+            {
+                packet.material->Bind(*shader); // the sampler uniforms belong to the program
+                m_stats.materialBinds++;
+            }
+            material = packetMaterial;
+            if (packet.mesh && (programChanged || packet.mesh != mesh))
+                packet.mesh->SetDecodeUniforms(*shader);
+            mesh = packet.mesh;
+            if (packet.vao != vao || m_stats.draws == 0)
+            {
+                glState().BindVertexArray(packet.vao);
+                vao = packet.vao;
+                m_stats.vaoSwitches++;
+            }
+
+            if (packet.modelUniform.isValid())
+                shader->set(packet.modelUniform, packet.model);
+            if (packet.colorUniform.isValid())
+                shader->set(packet.colorUniform, packet.color);
+            const void *offset = (const void *)(packet.firstIndex * sizeof(unsigned int));
+            if (packet.baseVertex != 0)
+                glDrawElementsBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT, (void *)offset, packet.baseVertex);
+            else
+                glDrawElements(packet.mode, packet.count, GL_UNSIGNED_INT, offset);
+            m_stats.draws++;
+        }
+        Clear();
+    }
+
+    // drops the recorded packets (the memory is kept for the next frame)
+    void Clear()
+    {
+        m_keys.clear();
+        m_packets.clear();
+    }
+
+    size_t Size() const { return m_packets.size(); }
+    // counts of the last Submit
+    const Stats &LastStats() const { return m_stats; }
+
+private:
+    std::vector<std::pair<uint64_t, uint32_t>> m_keys; // sort key, packet index (keeps the push order for equal keys)
+    std::vector<DrawPacket> m_packets;
+    Stats m_stats;
+
+    uint64_t sortKey(const DrawPacket &packet, unsigned int pass, float depth) const
+    {
+        uint64_t depthBits = (uint64_t)(std::min(std::max(depth / maxDepth, 0.0f), 1.0f) * 65535.0f);
+        uint64_t program = packet.shader ? packet.shader->programSerial : 0;
+        uint64_t material = packet.material ? packet.material->ID() : 0;
+        return ((uint64_t)(pass & 0xf) << 60) | ((program & 0xfff) << 48) | ((material & 0xffff) << 32) |
+               ((uint64_t)(packet.vao & 0xffff) << 16) | depthBits;
+    }
+};
+
+#endif
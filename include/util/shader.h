@@ -4,10 +4,79 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <util/glstate.h>
+#include <util/shadercache.h>
+#include <util/uniformblocks.h>
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <chrono> // for timing
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GL_COMPLETION_STATUS_KHR // KHR_parallel_shader_compile
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// true if the driver compiles and links in the background and can be asked whether it is done
+// (KHR_parallel_shader_compile or ARB_parallel_shader_compile, the thread count is left to the driver)
+// ------------------------------------------------------------------------
+bool parallelShaderCompileSupported()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name && (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+                supported = 1;
+        }
+    }
+    return supported == 1;
+}
+
+// set to false to look up uniform locations with glGetUniformLocation on every set call, as before
+bool uniformLocationCacheEnabled = true;
+
+// a uniform of a Shader, fetched once by name (Shader::getUniform) and then set without any string work.
+// Stays valid when the shader is reloaded. T is the C++ type of the value (int, float, bool, glm::vec3, ...).
+template <class T>
+struct UniformHandle
+{
+    int slot = -1;
+    bool isValid() const { return slot >= 0; }
+};
+
+// the GLSL types a C++ value type can be uploaded to
+// ------------------------------------------------------------------------
+template <class T>
+bool uniformTypeMatches(GLenum type);
+template <>
+bool uniformTypeMatches<int>(GLenum type) { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_3D; }
+template <>
+bool uniformTypeMatches<bool>(GLenum type) { return type == GL_BOOL || type == GL_INT; }
+template <>
+bool uniformTypeMatches<float>(GLenum type) { return type == GL_FLOAT; }
+template <>
+bool uniformTypeMatches<glm::vec2>(GLenum type) { return type == GL_FLOAT_VEC2; }
+template <>
+bool uniformTypeMatches<glm::vec3>(GLenum type) { return type == GL_FLOAT_VEC3; }
+template <>
+bool uniformTypeMatches<glm::vec4>(GLenum type) { return type == GL_FLOAT_VEC4; }
+template <>
+bool uniformTypeMatches<glm::mat2>(GLenum type) { return type == GL_FLOAT_MAT2; }
+template <>
+bool uniformTypeMatches<glm::mat3>(GLenum type) { return type == GL_FLOAT_MAT3; }
+template <>
+bool uniformTypeMatches<glm::mat4>(GLenum type) { return type == GL_FLOAT_MAT4; }
 
 class Shader
 {
@@ -15,6 +84,7 @@ private:
     std::string vPath = "";
     std::string fPath = "";
     std::string gPath = "";
+    bool isCompute = false; // vPath is a compute shader, there are no other stages
     bool isSuccess = false;
 
 public:
@@ -33,6 +103,15 @@ public:
     }
     unsigned int ID; // shader program id
 
+    // how long the last load took and whether the program came from the program binary cache (see shadercache.h)
+    double loadMilliseconds = 0.0;
+    bool fromProgramCache = false;
+    // unique number of the linked program, changes with every reload (never reused like program ids are), e.g., to
+    // know when locations that were looked up once (see Material) have to be looked up again
+    unsigned int programSerial = 0;
+    // reload when one of the source files is saved (see update)
+    bool watchFiles = true;
+
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr)
@@ -44,7 +123,7 @@ public:
         if (geometryPath)
             gPath = std::string(geometryPath);
 
-        isSuccess = loadAndCompile(vPath, fPath, gPath, ID);
+        isSuccess = loadAndCompile(ID);
     }
 
     // constructor generates the shader on the fly
@@ -53,7 +132,7 @@ public:
     {
         vPath = vertexPath;
         fPath = fragmentPath;
-        isSuccess = loadAndCompile(vPath, fPath, gPath, ID);
+        isSuccess = loadAndCompile(ID);
     }
 
     // constructor generates the shader on the fly
@@ -63,91 +142,241 @@ public:
         vPath = vertexPath;
         fPath = fragmentPath;
         gPath = geometryPath;
-        isSuccess = loadAndCompile(vPath, fPath, gPath, ID);
+        isSuccess = loadAndCompile(ID);
     }
 
-    // try to reload and recompile the shder
+    // constructor generates a compute shader program (OpenGL 4.3, see glDispatchCompute)
+    // ------------------------------------------------------------------------
+    explicit Shader(const std::string computePath)
+    {
+        vPath = computePath;
+        isCompute = true;
+        isSuccess = loadAndCompile(ID);
+    }
+
+    // starts to reload and recompile the shader, returns right away. The driver compiles while rendering goes on,
+    // update() swaps in the new program once it is linked (the old one is used until then)
     // ------------------------------------------------------------------------
     void reload()
     {
-        unsigned int newID;
-        if (loadAndCompile(vPath, fPath, gPath, newID))
-        {
-            ID = newID;
-            isSuccess = true;
-        }
+        discardPending(); // a newer edit replaces a reload that is still compiling
+        if (beginProgram(pending))
+            reloading = true;
         else
+            std::cout << "ERROR::SHADER_RELOAD_ERROR : keeping previous shader!" << std::endl;
+    }
+
+    // call once per frame: starts a reload when a source file changed (with watchFiles) and finishes a reload when
+    // the driver is done. Returns true when a new program was swapped in, uniforms that are only set once have to
+    // be set again then.
+    // ------------------------------------------------------------------------
+    bool update()
+    {
+        if (watchFiles && sourcesChanged())
+            reload();
+        if (!reloading || !programReady(pending))
+            return false;
+
+        reloading = false;
+        if (!finishProgram(pending))
         {
             std::cout << "ERROR::SHADER_RELOAD_ERROR : keeping previous shader!" << std::endl;
+            return false;
+        }
+        if (isSuccess)
+        {
+            glState().ForgetProgram(ID);
+            glDeleteProgram(ID);
         }
+        ID = pending.program;
+        pending = PendingProgram();
+        isSuccess = true;
+        return true;
     }
 
+    // a reload is compiling
+    bool isReloading() const { return reloading; }
+
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(ID);
+        glState().UseProgram(ID);
+    }
+    // returns a handle for setting the uniform without a name lookup. Uniforms that are not active (e.g., removed by
+    // the compiler because they are unused) get a handle too, setting them does nothing like glUniform with -1.
+    // ------------------------------------------------------------------------
+    template <class T>
+    UniformHandle<T> getUniform(const std::string &name)
+    {
+        UniformHandle<T> uniform;
+        auto known = std::find(handleNames.begin(), handleNames.end(), name);
+        uniform.slot = (int)(known - handleNames.begin());
+        if (known == handleNames.end())
+        {
+            handleNames.push_back(name);
+            handleLocations.push_back(uniformInfo(name).location);
+        }
+        auto info = uniforms.find(name);
+        if (info != uniforms.end() && !uniformTypeMatches<T>(info->second.type))
+            std::cout << "WARNING::SHADER_UNIFORM : " << name << " has another type in " << vPath << " + " << fPath << std::endl;
+        return uniform;
     }
-    // utility uniform functions
+
+    // the location of an active uniform of the current program, -1 if it is not active
+    // ------------------------------------------------------------------------
+    GLint location(const std::string &name) const { return uniformInfo(name).location; }
+
+    // typed uniform functions (the shader has to be in use)
+    // ------------------------------------------------------------------------
+    void set(UniformHandle<bool> uniform, bool value) const { glUniform1i(handleLocation(uniform.slot), (int)value); }
+    void set(UniformHandle<int> uniform, int value) const { glUniform1i(handleLocation(uniform.slot), value); }
+    void set(UniformHandle<float> uniform, float value) const { glUniform1f(handleLocation(uniform.slot), value); }
+    void set(UniformHandle<glm::vec2> uniform, const glm::vec2 &value) const { glUniform2fv(handleLocation(uniform.slot), 1, &value[0]); }
+    void set(UniformHandle<glm::vec3> uniform, const glm::vec3 &value) const { glUniform3fv(handleLocation(uniform.slot), 1, &value[0]); }
+    void set(UniformHandle<glm::vec4> uniform, const glm::vec4 &value) const { glUniform4fv(handleLocation(uniform.slot), 1, &value[0]); }
+    void set(UniformHandle<glm::mat2> uniform, const glm::mat2 &mat) const { glUniformMatrix2fv(handleLocation(uniform.slot), 1, GL_FALSE, &mat[0][0]); }
+    void set(UniformHandle<glm::mat3> uniform, const glm::mat3 &mat) const { glUniformMatrix3fv(handleLocation(uniform.slot), 1, GL_FALSE, &mat[0][0]); }
+    void set(UniformHandle<glm::mat4> uniform, const glm::mat4 &mat) const { glUniformMatrix4fv(handleLocation(uniform.slot), 1, GL_FALSE, &mat[0][0]); }
+
+    // utility uniform functions, the names are looked up in the table of active uniforms (see reflectUniforms)
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(uniformLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(uniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(uniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(uniformLocation(name), 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(uniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(uniformLocation(name), 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(uniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(uniformLocation(name), 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(uniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    struct UniformInfo
+    {
+        GLint location = -1;
+        GLenum type = 0;
+    };
+    // every active uniform of the program by name, array elements also as name[i]
+    std::unordered_map<std::string, UniformInfo> uniforms;
+    // the uniforms that were fetched as handles, indexed by UniformHandle::slot
+    std::vector<std::string> handleNames;
+    std::vector<GLint> handleLocations;
+
+    UniformInfo uniformInfo(const std::string &name) const
+    {
+        auto found = uniforms.find(name);
+        return found != uniforms.end() ? found->second : UniformInfo();
+    }
+
+    GLint uniformLocation(const std::string &name) const
+    {
+        if (!uniformLocationCacheEnabled)
+            return glGetUniformLocation(ID, name.c_str());
+        return uniformInfo(name).location;
+    }
+
+    GLint handleLocation(int slot) const
+    {
+        return slot >= 0 && slot < (int)handleLocations.size() ? handleLocations[slot] : -1;
+    }
+
+    // fills the uniform table from the linked program (glGetActiveUniform) and updates the handles
+    void reflectUniforms(unsigned int program)
+    {
+        uniforms.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            uniforms[name] = {glGetUniformLocation(program, name.c_str()), type};
+            if (size > 1 || (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0))
+            { // arrays are reported as name[0], the elements can also be set one by one
+                std::string base = name.substr(0, name.find_last_of('['));
+                uniforms[base] = uniforms[name];
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniforms[elementName] = {glGetUniformLocation(program, elementName.c_str()), type};
+                }
+            }
+        }
+        for (size_t slot = 0; slot < handleNames.size(); slot++)
+            handleLocations[slot] = uniformInfo(handleNames[slot]).location;
+    }
+
+    // connects the shared uniform blocks of the program (FrameData, ...) to their binding points (see uniformblocks.h)
+    void bindUniformBlocks(unsigned int program)
+    {
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(program, (GLuint)i, sizeof(name), &length, name);
+            GLint binding = uniformBlockBinding(std::string(name, length));
+            if (binding >= 0)
+                glUniformBlockBinding(program, (GLuint)i, (GLuint)binding);
+            else
+                std::cout << "WARNING::SHADER_UNIFORM_BLOCK : no binding point for " << std::string(name, length) << std::endl;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     bool checkCompileErrors(GLuint shader, std::string type)
@@ -178,14 +407,26 @@ private:
         return success;
     }
 
-    bool loadAndCompile(std::string vertexPath, std::string fragmentPath, std::string geometryPath, unsigned int &ID)
+    // a program that is compiled and linked by the driver while rendering goes on (see reload and update)
+    struct PendingProgram
     {
-        bool success = true;
+        unsigned int program = 0;
+        unsigned int shaders[3] = {};
+        const char *shaderTypes[3] = {"VERTEX", "FRAGMENT", "GEOMETRY"};
+        int shaderCount = 0;
+        bool fromCache = false;
+        bool polled = false; // programReady was called once (in the frame that started it)
+        uint64_t sourceHash = 0;
+        std::string cachePath;
+        std::chrono::high_resolution_clock::time_point start;
+    };
+    PendingProgram pending;
+    bool reloading = false;
+    int64_t sourceTimes[3] = {};
+    std::chrono::steady_clock::time_point lastFileCheck;
 
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
+    bool readSources(std::string &vertexCode, std::string &fragmentCode, std::string &geometryCode)
+    {
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -196,22 +437,26 @@ private:
         try
         {
             // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
+            vShaderFile.open(vPath);
             std::stringstream vShaderStream, fShaderStream;
             // read file's buffer contents into streams
             vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
             // close file handlers
             vShaderFile.close();
-            fShaderFile.close();
             // convert stream into string
             vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            // a compute program has only the one source
+            if (!isCompute)
+            {
+                fShaderFile.open(fPath);
+                fShaderStream << fShaderFile.rdbuf();
+                fShaderFile.close();
+                fragmentCode = fShaderStream.str();
+            }
             // if geometry shader path is present, also load a geometry shader
-            if (!geometryPath.empty())
+            if (!gPath.empty())
             {
-                gShaderFile.open(geometryPath);
+                gShaderFile.open(gPath);
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
@@ -223,45 +468,143 @@ private:
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
             return false;
         }
-        const char *vShaderCode = vertexCode.c_str();
-        const char *fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        success = success && checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        success = success && checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (!geometryPath.empty())
+        return true;
+    }
+
+    // reads the sources and hands them to the driver without waiting for the result (finishProgram does)
+    bool beginProgram(PendingProgram &program)
+    {
+        program = PendingProgram();
+        program.start = std::chrono::high_resolution_clock::now();
+        sourceTimes[0] = fileTimestamp(vPath);
+        sourceTimes[1] = isCompute ? 0 : fileTimestamp(fPath);
+        sourceTimes[2] = gPath.empty() ? 0 : fileTimestamp(gPath);
+
+        // 1. retrieve the vertex/fragment source code from filePath
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::string geometryCode;
+        if (!readSources(vertexCode, fragmentCode, geometryCode))
+            return false;
+
+        // 2. use the cached program binary if the sources and the driver did not change
+        program.cachePath = programCachePath(vPath, fPath, gPath);
+        program.sourceHash = programSourceHash({vertexCode, fragmentCode, geometryCode});
+        program.program = loadProgramCache(program.cachePath, program.sourceHash);
+        program.fromCache = program.program != 0;
+        if (program.fromCache)
+            return true;
+
+        // 3. compile shaders and link the program, the status is only queried when it is done
+        const std::string *codes[3] = {&vertexCode, &fragmentCode, &geometryCode};
+        const GLenum types[3] = {isCompute ? (GLenum)GL_COMPUTE_SHADER : (GLenum)GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+        program.shaderCount = isCompute ? 1 : gPath.empty() ? 2 : 3; // if geometry shader is given, compile geometry shader
+        if (isCompute)
+            program.shaderTypes[0] = "COMPUTE";
+        for (int i = 0; i < program.shaderCount; i++)
         {
-            const char *gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            success = success && checkCompileErrors(geometry, "GEOMETRY");
+            const char *code = codes[i]->c_str();
+            program.shaders[i] = glCreateShader(types[i]);
+            glShaderSource(program.shaders[i], 1, &code, NULL);
+            glCompileShader(program.shaders[i]);
         }
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if (!geometryPath.empty())
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        success = success && checkCompileErrors(ID, "PROGRAM");
+        program.program = glCreateProgram();
+        if (programCacheEnabled && programBinarySupported())
+            glProgramParameteri(program.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        for (int i = 0; i < program.shaderCount; i++)
+            glAttachShader(program.program, program.shaders[i]);
+        glLinkProgram(program.program);
+        return true;
+    }
+
+    // true if finishProgram will not wait for the driver. Never in the first call, which is made in the frame that
+    // started the program, so the status is read in the next frame at the earliest.
+    bool programReady(PendingProgram &program)
+    {
+        if (!program.polled)
+        {
+            program.polled = true;
+            return false;
+        }
+        if (program.fromCache || !parallelShaderCompileSupported())
+            return true; // without the extension there is no way to ask, the next frame waits for the link
+        GLint done = GL_FALSE;
+        glGetProgramiv(program.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // checks the result of beginProgram (waits for it if necessary). On failure the program is deleted.
+    bool finishProgram(PendingProgram &program)
+    {
+        bool success = true;
+        for (int i = 0; i < program.shaderCount; i++)
+            success = success && checkCompileErrors(program.shaders[i], program.shaderTypes[i]);
+        success = success && checkCompileErrors(program.program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if (!geometryPath.empty())
-            glDeleteShader(geometry);
+        for (int i = 0; i < program.shaderCount; i++)
+            glDeleteShader(program.shaders[i]);
+        program.shaderCount = 0;
+
+        if (!success)
+        {
+            glDeleteProgram(program.program);
+            program.program = 0;
+            return false;
+        }
+        static unsigned int linkedPrograms = 0;
+        programSerial = ++linkedPrograms;
+        fromProgramCache = program.fromCache;
+        reflectUniforms(program.program);
+        bindUniformBlocks(program.program);
+        if (!program.fromCache)
+            writeProgramCache(program.cachePath, program.program, program.sourceHash);
+        printLoadTime(program.start);
+        return true;
+    }
 
+    void discardPending()
+    {
+        if (!reloading)
+            return;
+        for (int i = 0; i < pending.shaderCount; i++)
+            glDeleteShader(pending.shaders[i]);
+        glDeleteProgram(pending.program);
+        pending = PendingProgram();
+        reloading = false;
+    }
+
+    // true if one of the source files was written since the program was loaded (checked twice per second)
+    bool sourcesChanged()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastFileCheck < std::chrono::milliseconds(500))
+            return false;
+        lastFileCheck = now;
+        const std::string *paths[3] = {&vPath, &fPath, &gPath};
+        for (int i = 0; i < 3; i++)
+        {
+            int64_t time = paths[i]->empty() ? 0 : fileTimestamp(*paths[i]);
+            if (time != 0 && time != sourceTimes[i]) // 0: the file is being replaced right now, try again later
+                return true;
+        }
+        return false;
+    }
+
+    bool loadAndCompile(unsigned int &ID)
+    {
+        PendingProgram program;
+        bool success = beginProgram(program) && finishProgram(program);
+        ID = program.program;
         return success;
     }
+
+    void printLoadTime(std::chrono::high_resolution_clock::time_point start)
+    {
+        auto t2 = std::chrono::high_resolution_clock::now();
+        loadMilliseconds = std::chrono::duration<double, std::milli>(t2 - start).count();
+        std::cout << "Shader " << vPath << (isCompute ? "" : " + " + fPath) << (gPath.empty() ? "" : " + " + gPath) << ": "
+                  << loadMilliseconds << " ms (" << (fromProgramCache ? "program binary cache" : "compiled and linked") << ")" << std::endl;
+    }
 };
 #endif
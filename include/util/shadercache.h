@@ -0,0 +1,154 @@
+#pragma once
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/mappedfile.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Program binary cache: after a shader program was compiled and linked, the driver's binary of it
+// (glGetProgramBinary) is written next to the vertex shader, e.g., pbr.vs.glsl+pbr.fs.glsl.programcache. Later
+// runs hand it back with glProgramBinary and skip compiling and linking. The cache is only used if the GLSL
+// sources hash to the same value and the driver (vendor, renderer and version string) is the same; the driver
+// may still reject a binary (e.g., after an update with the same version string), then the program is compiled.
+//
+// file layout:  ProgramCacheHeader | binary (binarySize bytes)
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+const char PROGRAM_CACHE_MAGIC[4] = {'R', 'T', 'G', 'P'};
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT // ARB_get_program_binary, core since OpenGL 4.1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// set to false to always compile shader programs from source (the cache is then neither read nor written)
+bool programCacheEnabled = true;
+
+struct ProgramCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t binaryFormat; // as returned by glGetProgramBinary
+    uint32_t binarySize;
+    uint64_t sourceHash; // FNV-1a hash of all shader sources of the program
+    uint64_t driverHash; // FNV-1a hash of GL_VENDOR, GL_RENDERER and GL_VERSION
+};
+
+// true if the context can give out and take back program binaries (needs the GL 4.1 entry points and at
+// least one binary format, some drivers support none)
+// ---------------------------------------------------
+bool programBinarySupported()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        GLint formats = 0;
+        if (glGetProgramBinary && glProgramBinary && glProgramParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0 ? 1 : 0;
+    }
+    return supported == 1;
+}
+
+// identifies the driver the binaries were made by
+// ---------------------------------------------------
+uint64_t programDriverHash()
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const char *str = (const char *)glGetString(name);
+        if (str)
+            hash = hashBytes(str, std::strlen(str) + 1, hash);
+    }
+    return hash;
+}
+
+// the hash of the sources of a program (empty sources, e.g., no geometry shader, still change the hash)
+// ---------------------------------------------------
+uint64_t programSourceHash(const std::vector<std::string> &sources)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (auto &source : sources)
+        hash = hashBytes(source.c_str(), source.size() + 1, hash);
+    return hash;
+}
+
+// utility function to get the cache file path of a program from its shader files
+// ---------------------------------------------------
+std::string programCachePath(const std::string &vertexPath, const std::string &fragmentPath, const std::string &geometryPath)
+{
+    std::string path = vertexPath;
+    if (!fragmentPath.empty()) // compute programs have a single source
+        path += "+" + std::filesystem::path(fragmentPath).filename().string();
+    if (!geometryPath.empty())
+        path += "+" + std::filesystem::path(geometryPath).filename().string();
+    return path + ".programcache";
+}
+
+// creates the program from its cached binary. Returns 0 if there is no valid cache or the driver rejects it.
+// ---------------------------------------------------
+unsigned int loadProgramCache(const std::string &cachePath, uint64_t sourceHash)
+{
+    if (!programCacheEnabled || !programBinarySupported())
+        return 0;
+    MappedFile file(cachePath);
+    const ProgramCacheHeader *header = file.at<ProgramCacheHeader>(0);
+    if (!header || std::memcmp(header->magic, PROGRAM_CACHE_MAGIC, 4) != 0 || header->version != PROGRAM_CACHE_VERSION ||
+        header->sourceHash != sourceHash || header->driverHash != programDriverHash())
+        return 0;
+    const char *binary = file.at<char>(sizeof(ProgramCacheHeader), header->binarySize);
+    if (!binary)
+        return 0;
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header->binaryFormat, binary, header->binarySize);
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// utility function for writing the binary of a freshly linked program (linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+// ---------------------------------------------------
+bool writeProgramCache(const std::string &cachePath, unsigned int program, uint64_t sourceHash)
+{
+    if (!programCacheEnabled || !programBinarySupported())
+        return false;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramCacheHeader header;
+    std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+    header.version = PROGRAM_CACHE_VERSION;
+    header.binaryFormat = format;
+    header.binarySize = (uint32_t)length;
+    header.sourceHash = sourceHash;
+    header.driverHash = programDriverHash();
+
+    std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write((const char *)&header, sizeof(header));
+    out.write(binary.data(), length);
+    return (bool)out;
+}
+
+#endif
@@ -0,0 +1,775 @@
+#pragma once
+#ifndef TEXCOMPRESS_H
+#define TEXCOMPRESS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#undef STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <util/glstate.h>
+#include <util/mappedfile.h>
+#include <util/threadpool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Block compressed textures: images are encoded on the CPU (spread over the worker pool) into BC1/BC3/BC4/BC5/BC7
+// together with their full mip chain, and the result is cached next to the image file (e.g., albedo.png.color.texcache).
+// Later runs map the cache and hand the levels straight to glCompressedTexImage2D.
+//
+// cache file layout:  TexCacheHeader | CompressedLevel[levelCount] | block data of all levels (largest first)
+
+// what a texture is used for, decides the block format
+enum class TexUsage
+{
+    Color,  // albedo/diffuse (sRGB encoded): BC1, BC3 if it has alpha, BC7 with textureCompressionBC7
+    Normal, // tangent space normal map: BC5 (x and y only, the shader reconstructs z)
+    Mask    // single channel data, e.g., metallic, roughness, ambient occlusion: BC4 (red channel)
+};
+
+enum BlockFormat : uint32_t
+{
+    BLOCK_NONE = 0,
+    BLOCK_BC1 = 1, // RGB 5:6:5 endpoints, 4 bits per pixel
+    BLOCK_BC3 = 3, // BC1 color + BC4 alpha, 8 bits per pixel
+    BLOCK_BC4 = 4, // one channel, 4 bits per pixel
+    BLOCK_BC5 = 5, // two BC4 channels, 8 bits per pixel
+    BLOCK_BC7 = 7  // RGBA (mode 6 only), 8 bits per pixel
+};
+
+const uint32_t TEX_CACHE_VERSION = 1;
+const char TEX_CACHE_MAGIC[4] = {'R', 'T', 'G', 'T'};
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT // EXT_texture_compression_s3tc, supported by all desktop drivers
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// set to false to upload textures uncompressed (RGB/RGBA8 with glGenerateMipmap) as before
+bool textureCompressionEnabled = true;
+// set to true to encode color textures with BC7 (better quality, twice the size of BC1, slower to encode)
+bool textureCompressionBC7 = false;
+
+struct TexCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t format; // BlockFormat
+    uint32_t levelCount;
+    uint32_t width;
+    uint32_t height;
+    uint32_t flipped;
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime; // last write time of the source file
+    uint64_t sourceHash; // FNV-1a hash of the source file content
+};
+
+struct CompressedLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset; // from the beginning of the block data
+    uint64_t size;
+};
+
+// the encoded mip chain of a texture, either freshly encoded (data) or mapped from the cache (file)
+struct CompressedTexture
+{
+    std::string path;
+    BlockFormat format = BLOCK_NONE;
+    std::vector<CompressedLevel> levels;
+    std::vector<uint8_t> data;
+    std::unique_ptr<MappedFile> file;
+    const uint8_t *bytes = nullptr; // block data of all levels
+    bool fromCache = false;
+    size_t sourceBytes = 0; // size of the uncompressed mip chain (RGBA8), for statistics
+
+    bool isValid() const { return format != BLOCK_NONE && bytes != nullptr && !levels.empty(); }
+    size_t ByteSize() const { return levels.empty() ? 0 : (size_t)(levels.back().offset + levels.back().size); }
+};
+
+// utility functions for the properties of a block format
+// ---------------------------------------------------
+size_t blockBytes(BlockFormat format)
+{
+    return (format == BLOCK_BC1 || format == BLOCK_BC4) ? 8 : 16;
+}
+
+GLenum blockFormatGL(BlockFormat format)
+{
+    switch (format)
+    {
+    case BLOCK_BC1:
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BLOCK_BC3:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BLOCK_BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case BLOCK_BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    case BLOCK_BC7:
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default:
+        return 0;
+    }
+}
+
+const char *blockFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BLOCK_BC1:
+        return "BC1";
+    case BLOCK_BC3:
+        return "BC3";
+    case BLOCK_BC4:
+        return "BC4";
+    case BLOCK_BC5:
+        return "BC5";
+    case BLOCK_BC7:
+        return "BC7";
+    default:
+        return "uncompressed";
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// block encoders: each one takes the 4x4 pixels of a block as RGBA8 (row by row) and writes one block
+
+// the direction of largest variance of the pixels (power iteration on the covariance matrix), channels: 3 or 4
+// ---------------------------------------------------
+void principalAxis(const float pixels[16][4], int channels, float mean[4], float axis[4])
+{
+    for (int c = 0; c < 4; c++)
+    {
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            mean[c] += pixels[i][c];
+        mean[c] /= 16.0f;
+    }
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                cov[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+
+    float v[4] = {1.0f, 1.0f, 1.0f, channels == 4 ? 1.0f : 0.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                next[a] += cov[a][b] * v[b];
+        float length = 0.0f;
+        for (int a = 0; a < channels; a++)
+            length = std::max(length, std::fabs(next[a]));
+        if (length < 1e-6f)
+            break; // (almost) uniform block
+        for (int a = 0; a < 4; a++)
+            v[a] = next[a] / length;
+    }
+    float length = 0.0f;
+    for (int a = 0; a < 4; a++)
+        length += v[a] * v[a];
+    length = std::sqrt(length);
+    for (int a = 0; a < 4; a++)
+        axis[a] = (a < channels && length > 0.0f) ? v[a] / length : 0.0f;
+}
+
+// the two ends of the pixels projected onto the principal axis, moved inwards a bit (reduces the average error)
+// ---------------------------------------------------
+void blockEndpoints(const uint8_t rgba[64], int channels, float end0[4], float end1[4])
+{
+    float pixels[16][4], mean[4], axis[4];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            pixels[i][c] = rgba[i * 4 + c];
+    principalAxis(pixels, channels, mean, axis);
+
+    float lo = 0.0f, hi = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (pixels[i][c] - mean[c]) * axis[c];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    float inset = (hi - lo) / 32.0f;
+    for (int c = 0; c < 4; c++)
+    {
+        end0[c] = c < channels ? std::clamp(mean[c] + axis[c] * (hi - inset), 0.0f, 255.0f) : 255.0f;
+        end1[c] = c < channels ? std::clamp(mean[c] + axis[c] * (lo + inset), 0.0f, 255.0f) : 255.0f;
+    }
+}
+
+// BC1: two RGB565 endpoints and 2 bit indices into the 4 color palette between them (no alpha)
+// ---------------------------------------------------
+void encodeBC1Block(const uint8_t rgba[64], uint8_t *block)
+{
+    float end0[4], end1[4];
+    blockEndpoints(rgba, 3, end0, end1);
+
+    auto pack565 = [](const float c[4])
+    {
+        return (uint16_t)((int(c[0] * 31.0f / 255.0f + 0.5f) << 11) | (int(c[1] * 63.0f / 255.0f + 0.5f) << 5) | int(c[2] * 31.0f / 255.0f + 0.5f));
+    };
+    uint16_t c0 = pack565(end0), c1 = pack565(end1);
+    if (c0 < c1) // c0 > c1 selects the 4 color mode
+        std::swap(c0, c1);
+
+    // the palette as the GPU decodes it
+    int palette[4][3];
+    auto unpack565 = [](uint16_t c, int *rgb)
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    };
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) // equal endpoints: all indices 0
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = INT32_MAX;
+            for (int p = 0; p < 4; p++)
+            {
+                int error = 0;
+                for (int c = 0; c < 3; c++)
+                    error += (rgba[i * 4 + c] - palette[p][c]) * (rgba[i * 4 + c] - palette[p][c]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+    // all block formats are little endian
+    block[0] = (uint8_t)(c0 & 0xff);
+    block[1] = (uint8_t)(c0 >> 8);
+    block[2] = (uint8_t)(c1 & 0xff);
+    block[3] = (uint8_t)(c1 >> 8);
+    for (int b = 0; b < 4; b++)
+        block[4 + b] = (uint8_t)(indices >> (8 * b));
+}
+
+// BC4: two 8 bit endpoints and 3 bit indices into the 8 value palette between them, for one channel of the pixels
+// ---------------------------------------------------
+void encodeBC4Block(const uint8_t rgba[64], int channel, uint8_t *block)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, (int)rgba[i * 4 + channel]);
+        hi = std::max(hi, (int)rgba[i * 4 + channel]);
+    }
+
+    // a0 > a1 selects the 8 value mode: a0, a1, then 6 values interpolated from a0 to a1
+    int palette[8] = {hi, lo};
+    for (int p = 1; p < 7; p++)
+        palette[p + 1] = ((7 - p) * hi + p * lo) / 7;
+
+    uint64_t indices = 0;
+    if (hi != lo) // equal endpoints: all indices 0
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int value = rgba[i * 4 + channel], best = 0;
+            for (int p = 1; p < 8; p++)
+                if (std::abs(value - palette[p]) < std::abs(value - palette[best]))
+                    best = p;
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    block[0] = (uint8_t)hi;
+    block[1] = (uint8_t)lo;
+    for (int b = 0; b < 6; b++)
+        block[2 + b] = (uint8_t)(indices >> (8 * b));
+}
+
+// BC3: BC4 alpha block followed by a BC1 color block
+// ---------------------------------------------------
+void encodeBC3Block(const uint8_t rgba[64], uint8_t *block)
+{
+    encodeBC4Block(rgba, 3, block);
+    encodeBC1Block(rgba, block + 8);
+}
+
+// BC5: BC4 blocks of the red and the green channel
+// ---------------------------------------------------
+void encodeBC5Block(const uint8_t rgba[64], uint8_t *block)
+{
+    encodeBC4Block(rgba, 0, block);
+    encodeBC4Block(rgba, 1, block + 8);
+}
+
+// BC7 mode 6: one subset, RGBA endpoints with 7 bits per channel plus a shared lowest bit (p-bit) per endpoint,
+// and 4 bit indices. The other 7 modes (partitions, separate alpha) are not used.
+// ---------------------------------------------------
+void encodeBC7Block(const uint8_t rgba[64], uint8_t *block)
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float ends[2][4];
+    blockEndpoints(rgba, 4, ends[0], ends[1]);
+
+    // quantize each endpoint to 7 bits + p-bit, the p-bit is picked for the smaller error
+    int quantized[2][4], pbit[2];
+    for (int e = 0; e < 2; e++)
+    {
+        float bestError = 1e30f;
+        for (int p = 0; p < 2; p++)
+        {
+            int q[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                q[c] = std::clamp((int)std::lround((ends[e][c] - p) / 2.0f), 0, 127);
+                float d = (float)((q[c] << 1) | p) - ends[e][c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pbit[e] = p;
+                std::copy(q, q + 4, quantized[e]);
+            }
+        }
+    }
+
+    int indices[16];
+    auto findIndices = [&]()
+    {
+        int palette[16][4];
+        for (int c = 0; c < 4; c++)
+        {
+            int e0 = (quantized[0][c] << 1) | pbit[0], e1 = (quantized[1][c] << 1) | pbit[1];
+            for (int w = 0; w < 16; w++)
+                palette[w][c] = ((64 - weights[w]) * e0 + weights[w] * e1 + 32) >> 6;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = INT32_MAX;
+            for (int w = 0; w < 16; w++)
+            {
+                int error = 0;
+                for (int c = 0; c < 4; c++)
+                    error += (rgba[i * 4 + c] - palette[w][c]) * (rgba[i * 4 + c] - palette[w][c]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = w;
+                }
+            }
+            indices[i] = best;
+        }
+    };
+    findIndices();
+    if (indices[0] & 8) // the highest bit of the first index is implicitly 0: swap the endpoints
+    {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pbit[0], pbit[1]);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    std::memset(block, 0, 16);
+    unsigned int bit = 0;
+    auto put = [&](uint32_t value, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++, bit++)
+            if ((value >> i) & 1)
+                block[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+    };
+    put(1 << 6, 7); // mode 6
+    for (int c = 0; c < 4; c++)
+    {
+        put(quantized[0][c], 7);
+        put(quantized[1][c], 7);
+    }
+    put(pbit[0], 1);
+    put(pbit[1], 1);
+    put(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        put(indices[i], 4);
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// mip chain and encoding
+
+// an RGBA8 image (one mip level)
+struct RgbaImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// utility function for the next smaller mip level (2x2 box filter). Color textures are averaged in linear space
+// (gamma 2.2, as the shaders decode them), normals are renormalized.
+// ---------------------------------------------------
+RgbaImage downsample(const RgbaImage &image, TexUsage usage)
+{
+    static const std::vector<float> toLinear = []
+    {
+        std::vector<float> table(256);
+        for (int i = 0; i < 256; i++)
+            table[i] = std::pow(i / 255.0f, 2.2f);
+        return table;
+    }();
+
+    RgbaImage result;
+    result.width = std::max(1, image.width / 2);
+    result.height = std::max(1, image.height / 2);
+    result.pixels.resize((size_t)result.width * result.height * 4);
+    for (int y = 0; y < result.height; y++)
+    {
+        for (int x = 0; x < result.width; x++)
+        {
+            float sum[4] = {};
+            for (int s = 0; s < 4; s++)
+            {
+                int sx = std::min(2 * x + (s & 1), image.width - 1), sy = std::min(2 * y + (s >> 1), image.height - 1);
+                const uint8_t *p = &image.pixels[((size_t)sy * image.width + sx) * 4];
+                for (int c = 0; c < 4; c++)
+                {
+                    if (usage == TexUsage::Color && c < 3)
+                        sum[c] += toLinear[p[c]];
+                    else if (usage == TexUsage::Normal && c < 3)
+                        sum[c] += p[c] / 127.5f - 1.0f;
+                    else
+                        sum[c] += p[c] / 255.0f;
+                }
+            }
+            uint8_t *out = &result.pixels[((size_t)y * result.width + x) * 4];
+            if (usage == TexUsage::Normal)
+            {
+                float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                for (int c = 0; c < 3; c++)
+                    out[c] = (uint8_t)std::lround(std::clamp(length > 0.0f ? sum[c] / length * 0.5f + 0.5f : 0.5f, 0.0f, 1.0f) * 255.0f);
+            }
+            for (int c = 0; c < 4; c++)
+            {
+                if (usage == TexUsage::Normal && c < 3)
+                    continue;
+                float value = sum[c] / 4.0f;
+                if (usage == TexUsage::Color && c < 3)
+                    value = std::pow(value, 1.0f / 2.2f);
+                out[c] = (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+            }
+        }
+    }
+    return result;
+}
+
+// picks the block format of a texture
+// ---------------------------------------------------
+BlockFormat chooseBlockFormat(TexUsage usage, const RgbaImage &image)
+{
+    if (usage == TexUsage::Normal)
+        return BLOCK_BC5;
+    if (usage == TexUsage::Mask)
+        return BLOCK_BC4;
+    if (textureCompressionBC7)
+        return BLOCK_BC7;
+    for (size_t i = 3; i < image.pixels.size(); i += 4)
+        if (image.pixels[i] != 255)
+            return BLOCK_BC3;
+    return BLOCK_BC1;
+}
+
+// encodes one mip level into dst. Rows of blocks are distributed over the worker pool.
+// ---------------------------------------------------
+void encodeLevel(const RgbaImage &image, BlockFormat format, uint8_t *dst)
+{
+    const int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+    const size_t rowBytes = blocksX * blockBytes(format);
+    parallelFor(blocksY, [&](size_t by)
+                {
+        uint8_t pixels[64];
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            // gather the block, edge pixels are repeated for levels smaller than 4x4
+            for (int i = 0; i < 16; i++)
+            {
+                int x = std::min(bx * 4 + (i & 3), image.width - 1), y = std::min((int)by * 4 + (i >> 2), image.height - 1);
+                std::memcpy(pixels + i * 4, &image.pixels[((size_t)y * image.width + x) * 4], 4);
+            }
+            uint8_t *block = dst + by * rowBytes + bx * blockBytes(format);
+            switch (format)
+            {
+            case BLOCK_BC1: encodeBC1Block(pixels, block); break;
+            case BLOCK_BC3: encodeBC3Block(pixels, block); break;
+            case BLOCK_BC4: encodeBC4Block(pixels, 0, block); break;
+            case BLOCK_BC5: encodeBC5Block(pixels, block); break;
+            case BLOCK_BC7: encodeBC7Block(pixels, block); break;
+            default: break;
+            }
+        } });
+}
+
+// utility function for encoding an RGBA8 image and all of its mip levels
+// ---------------------------------------------------
+CompressedTexture compressImage(RgbaImage image, TexUsage usage)
+{
+    CompressedTexture result;
+    result.format = chooseBlockFormat(usage, image);
+
+    std::vector<RgbaImage> chain;
+    chain.push_back(std::move(image));
+    while (chain.back().width > 1 || chain.back().height > 1)
+        chain.push_back(downsample(chain.back(), usage));
+
+    uint64_t offset = 0;
+    for (auto &level : chain)
+    {
+        uint64_t size = (uint64_t)((level.width + 3) / 4) * ((level.height + 3) / 4) * blockBytes(result.format);
+        result.levels.push_back({(uint32_t)level.width, (uint32_t)level.height, offset, size});
+        result.sourceBytes += level.pixels.size();
+        offset += size;
+    }
+    result.data.resize(offset);
+    for (size_t i = 0; i < chain.size(); i++)
+        encodeLevel(chain[i], result.format, result.data.data() + result.levels[i].offset);
+    result.bytes = result.data.data();
+    return result;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// cache files
+
+// utility function to get the cache file path of an image file, the usage decides the block format
+// ---------------------------------------------------
+std::string texCachePath(const std::string &sourcePath, bool flipVertically, TexUsage usage)
+{
+    const char *name = usage == TexUsage::Normal ? ".normal" : (usage == TexUsage::Mask ? ".mask" : (textureCompressionBC7 ? ".color-bc7" : ".color"));
+    return sourcePath + name + (flipVertically ? ".flipped" : "") + ".texcache";
+}
+
+// maps the cache of an image file if it is still valid for the source file (same rules as the mesh cache)
+// ---------------------------------------------------
+bool readTexCache(const std::string &sourcePath, bool flipVertically, TexUsage usage, CompressedTexture &result)
+{
+    std::string cachePath = texCachePath(sourcePath, flipVertically, usage);
+    auto file = std::make_unique<MappedFile>();
+    if (!file->open(cachePath))
+        return false;
+
+    const TexCacheHeader *header = file->at<TexCacheHeader>(0);
+    if (!header || std::memcmp(header->magic, TEX_CACHE_MAGIC, 4) != 0 || header->version != TEX_CACHE_VERSION ||
+        header->flipped != (uint32_t)flipVertically || header->levelCount == 0)
+        return false;
+    std::error_code ec;
+    if ((uint64_t)std::filesystem::file_size(sourcePath, ec) != header->sourceSize || ec)
+        return false;
+    int64_t sourceTime = fileTimestamp(sourcePath);
+    if (sourceTime != header->sourceTime)
+    {
+        if (hashFile(sourcePath) != header->sourceHash)
+            return false;
+        // same content, new timestamp: store it, so later runs do not hash the source again
+        file->close();
+        patchFile(cachePath, offsetof(TexCacheHeader, sourceTime), sourceTime);
+        if (!file->open(cachePath) || !(header = file->at<TexCacheHeader>(0)))
+            return false;
+    }
+
+    const CompressedLevel *levels = file->at<CompressedLevel>(sizeof(TexCacheHeader), header->levelCount);
+    size_t dataOffset = sizeof(TexCacheHeader) + header->levelCount * sizeof(CompressedLevel);
+    if (!levels)
+        return false;
+    const CompressedLevel &last = levels[header->levelCount - 1];
+    const uint8_t *bytes = file->at<uint8_t>(dataOffset, (size_t)(last.offset + last.size));
+    if (!bytes)
+        return false;
+
+    result.format = (BlockFormat)header->format;
+    result.levels.assign(levels, levels + header->levelCount);
+    for (auto &level : result.levels)
+        result.sourceBytes += (size_t)level.width * level.height * 4;
+    result.bytes = bytes;
+    result.file = std::move(file);
+    result.fromCache = true;
+    return true;
+}
+
+// utility function for writing a freshly encoded texture into its cache file
+// ---------------------------------------------------
+bool writeTexCache(const std::string &sourcePath, bool flipVertically, TexUsage usage, const CompressedTexture &texture)
+{
+    std::error_code ec;
+    TexCacheHeader header;
+    std::memcpy(header.magic, TEX_CACHE_MAGIC, 4);
+    header.version = TEX_CACHE_VERSION;
+    header.format = texture.format;
+    header.levelCount = (uint32_t)texture.levels.size();
+    header.width = texture.levels[0].width;
+    header.height = texture.levels[0].height;
+    header.flipped = flipVertically;
+    header.reserved = 0;
+    header.sourceSize = (uint64_t)std::filesystem::file_size(sourcePath, ec);
+    header.sourceTime = fileTimestamp(sourcePath);
+    header.sourceHash = hashFile(sourcePath);
+    if (ec)
+        return false;
+
+    std::ofstream out(texCachePath(sourcePath, flipVertically, usage), std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)texture.levels.data(), texture.levels.size() * sizeof(CompressedLevel));
+    out.write((const char *)texture.bytes, texture.ByteSize());
+    return (bool)out;
+}
+
+// utility function for getting the compressed mip chain of an image file: from the cache, or decoded, encoded and
+// cached. Does not use OpenGL, so it is safe to call from worker threads. Returns an invalid texture on failure.
+// ---------------------------------------------------
+CompressedTexture loadCompressedTexture(const std::string &path, bool flipVertically, TexUsage usage)
+{
+    CompressedTexture result;
+    if (readTexCache(path, flipVertically, usage, result))
+    {
+        result.path = path;
+        return result;
+    }
+
+    RgbaImage image;
+    int nrComponents;
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &nrComponents, 4);
+    stbi_set_flip_vertically_on_load_thread(false); // runs on worker threads, do not leave the flag to the next task
+    if (!data)
+        return result;
+    image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+    stbi_image_free(data);
+
+    result = compressImage(std::move(image), usage);
+    result.path = path;
+    writeTexCache(path, flipVertically, usage, result);
+    return result;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// OpenGL (render thread only)
+
+// checks if the driver lists the block format as a supported compressed format
+// ---------------------------------------------------
+bool blockFormatSupported(BlockFormat format)
+{
+    static std::vector<GLint> supported;
+    if (supported.empty())
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+        supported.resize(std::max(count, 1));
+        glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, supported.data());
+    }
+    return std::find(supported.begin(), supported.end(), (GLint)blockFormatGL(format)) != supported.end();
+}
+
+// utility function for creating a texture from the compressed mip chain, wrap is used for S and T (the same as the
+// uncompressed upload of the caller, so compression does not change sampling). Returns 0 if the format is not supported.
+// ---------------------------------------------------
+unsigned int uploadCompressedTexture(const CompressedTexture &texture, GLenum wrap)
+{
+    if (!texture.isValid() || !blockFormatSupported(texture.format))
+        return 0;
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glState().BindTexture(GL_TEXTURE_2D, textureID);
+    for (size_t i = 0; i < texture.levels.size(); i++)
+    {
+        const CompressedLevel &level = texture.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, blockFormatGL(texture.format), level.width, level.height, 0,
+                               (GLsizei)level.size, texture.bytes + level.offset);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// utility function for creating a texture from decoded RGBA8 pixels that have no file of their own (e.g., images
+// embedded in a glTF file, so there is no cache): block compressed with textureCompressionEnabled, else RGBA8.
+// ---------------------------------------------------
+unsigned int uploadRgbaImage(RgbaImage image, TexUsage usage, GLenum wrap)
+{
+    if (textureCompressionEnabled)
+    {
+        if (unsigned int textureID = uploadCompressedTexture(compressImage(image, usage), wrap))
+            return textureID;
+    }
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glState().BindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// GPU memory of a 2D texture with all its mip levels, queried from OpenGL (compressed size, or the texel size
+// from the component bits of the internal format)
+// ---------------------------------------------------
+size_t textureGpuBytes(unsigned int textureID)
+{
+    if (textureID == 0)
+        return 0;
+    glState().BindTexture(GL_TEXTURE_2D, textureID);
+    size_t bytes = 0;
+    for (GLint level = 0; level < 16; level++)
+    {
+        GLint width = 0, height = 0, compressed = GL_FALSE;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0) // no more levels
+            break;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            bytes += size;
+            continue;
+        }
+        GLint bits = 0;
+        for (GLenum component : {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE})
+        {
+            GLint componentBits = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, component, &componentBits);
+            bits += componentBits;
+        }
+        bytes += (size_t)width * height * bits / 8;
+    }
+    glState().BindTexture(GL_TEXTURE_2D, 0);
+    return bytes;
+}
+
+#endif
@@ -0,0 +1,163 @@
+#pragma once
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/mappedfile.h>
+#include <util/texcompress.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// how a texture is created from an image: the same file content loaded with another variant is another texture
+// ---------------------------------------------------
+uint32_t textureVariant(bool flipVertically, TexUsage usage, GLenum wrap)
+{
+    return (flipVertically ? 1u : 0u) | ((uint32_t)usage << 1) | ((uint32_t)(wrap == GL_REPEAT) << 4);
+}
+
+// added to the variant of half float textures decoded from .hdr files (see loadHdrTexture)
+const uint32_t TEX_VARIANT_HDR = 1u << 5;
+
+// added to the variant of textures that hold one channel (0-3) of the image moved into red (see loadGltfTexture)
+// ---------------------------------------------------
+uint32_t textureChannelVariant(int channel)
+{
+    return channel >= 0 ? (uint32_t)(channel + 1) << 6 : 0;
+}
+
+// All 2D textures created from image files (Model::TextureFromFile and loadTexture), keyed by the content hash
+// of the file and the variant. Identical images under different names share one OpenGL texture; every Acquire
+// adds a reference and the texture is deleted when the last one is released. Lookups are hash table accesses:
+// a file is hashed once, later requests for the same path use the remembered hash (render thread only).
+class TextureCache
+{
+public:
+    // the texture for the content of the file at path, created with load() if there is none for this content
+    // and variant yet. Returns 0 (and keeps nothing) if load() fails. contentHash is the hashFile of path if the
+    // caller has it already (e.g., computed on a worker thread), 0 to hash the file here.
+    template <class F>
+    unsigned int Acquire(const std::string &path, uint32_t variant, F load, uint64_t contentHash = 0)
+    {
+        if (contentHash != 0)
+            m_contentHashes[path] = contentHash;
+        uint64_t hash = fileHash(path);
+        if (hash == 0) // unreadable file, let the loader report it
+            return load();
+        return AcquireContent(hash, variant, load);
+    }
+
+    // the same for content that is not a file of its own, e.g. an image embedded in a glTF file: hash is the
+    // hashBytes of the encoded image
+    template <class F>
+    unsigned int AcquireContent(uint64_t hash, uint32_t variant, F load)
+    {
+        Key key{hash, variant};
+        auto found = m_entries.find(key);
+        if (found != m_entries.end())
+        {
+            found->second.references++;
+            m_shared++;
+            return found->second.textureID;
+        }
+        unsigned int textureID = load();
+        if (textureID == 0)
+            return 0;
+        m_entries[key] = {textureID, 1};
+        m_keys[textureID] = key;
+        return textureID;
+    }
+
+    // adds a reference to a texture of the cache
+    void AddRef(unsigned int textureID)
+    {
+        auto key = m_keys.find(textureID);
+        if (key != m_keys.end())
+            m_entries[key->second].references++;
+    }
+
+    // drops a reference, the texture is deleted with the last one. Textures not created through the cache are
+    // deleted right away.
+    void Release(unsigned int textureID)
+    {
+        if (textureID == 0)
+            return;
+        auto key = m_keys.find(textureID);
+        if (key != m_keys.end())
+        {
+            auto entry = m_entries.find(key->second);
+            if (--entry->second.references > 0)
+                return;
+            m_entries.erase(entry);
+            m_keys.erase(key);
+        }
+        glState().ForgetTexture(textureID);
+        glDeleteTextures(1, &textureID);
+    }
+
+    // number of references to a texture of the cache, 0 for textures that were not created through it
+    uint32_t References(unsigned int textureID) const
+    {
+        auto key = m_keys.find(textureID);
+        return key != m_keys.end() ? m_entries.at(key->second).references : 0;
+    }
+
+    // the content hash and variant of a texture of the cache as text, empty for textures not created through it.
+    // Unlike the OpenGL name it is not reused for other content after the texture is deleted.
+    std::string ContentKey(unsigned int textureID) const
+    {
+        auto key = m_keys.find(textureID);
+        if (key == m_keys.end())
+            return std::string();
+        return std::to_string(key->second.hash) + "/" + std::to_string(key->second.variant);
+    }
+
+    size_t Size() const { return m_entries.size(); }
+    // number of requests that were served by an existing texture (same name, or same content under another name)
+    size_t SharedRequests() const { return m_shared; }
+
+private:
+    struct Key
+    {
+        uint64_t hash;
+        uint32_t variant;
+        bool operator==(const Key &other) const { return hash == other.hash && variant == other.variant; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const { return (size_t)(key.hash ^ ((uint64_t)key.variant * 0x9E3779B97F4A7C15ull)); }
+    };
+    struct Entry
+    {
+        unsigned int textureID;
+        uint32_t references;
+    };
+
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    std::unordered_map<unsigned int, Key> m_keys;              // texture id -> entry
+    std::unordered_map<std::string, uint64_t> m_contentHashes; // path -> hash of the file content
+    size_t m_shared = 0;
+
+    uint64_t fileHash(const std::string &path)
+    {
+        auto found = m_contentHashes.find(path);
+        if (found != m_contentHashes.end())
+            return found->second;
+        uint64_t hash = hashFile(path);
+        if (hash != 0)
+            m_contentHashes[path] = hash;
+        return hash;
+    }
+};
+
+// the cache shared by all loaders
+// ---------------------------------------------------
+TextureCache &textureCache()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#pragma once
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A small pool of worker threads for CPU work (decoding images, parsing files, ...).
+// Tasks must not call OpenGL, the GL context is only current on the render thread!
+class ThreadPool
+{
+public:
+    // by default one thread less than there are cores, the render thread keeps one for itself
+    ThreadPool(unsigned int numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1)
+    {
+        for (unsigned int i = 0; i < std::max(1u, numThreads); i++)
+            m_workers.emplace_back([this]
+                                   { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for (auto &worker : m_workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // queues a task and returns a future for its result
+    template <class F>
+    auto submit(F &&task) -> std::future<decltype(task())>
+    {
+        using R = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push([packaged]
+                         { (*packaged)(); });
+        }
+        m_condition.notify_one();
+        return result;
+    }
+
+    size_t size() const { return m_workers.size(); }
+
+private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]
+                                 { return m_stop || !m_tasks.empty(); });
+                if (m_stop && m_tasks.empty())
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+// the shared pool used by the asset loaders (created on first use)
+// ---------------------------------------------------
+ThreadPool &workerPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+// runs body(i) for every i in [0, count) on the shared pool and returns when all calls are done.
+// The calling thread works along instead of blocking, so this may also be called from inside a pool task
+// (even if every worker does that, the work still gets done). Tasks that start late find nothing to do.
+// ---------------------------------------------------
+template <class F>
+void parallelFor(size_t count, F &&body)
+{
+    struct Progress
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+    auto progress = std::make_shared<Progress>();
+    auto work = [progress, count, &body]
+    {
+        for (size_t i = progress->next++; i < count; i = progress->next++)
+        {
+            body(i);
+            progress->done++;
+        }
+    };
+
+    size_t helpers = count > 1 ? std::min(count - 1, workerPool().size()) : 0;
+    for (size_t t = 0; t < helpers; t++)
+        workerPool().submit(work);
+    work();
+    while (progress->done < count) // the remaining items are running on other threads
+        std::this_thread::yield();
+}
+
+#endif
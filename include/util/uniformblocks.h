@@ -0,0 +1,115 @@
+#pragma once
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Uniform blocks shared by all shader programs. Each block has a fixed binding point; Shader connects the blocks of
+// a program to them when it is linked (see Shader::bindUniformBlocks), so one buffer update per frame reaches
+// every program that declares the block. The C++ structs below are laid out like the std140 blocks in GLSL:
+//
+//  layout (std140) uniform FrameData    { mat4 projection; mat4 view; vec3 camPos; float gamma; };
+//  layout (std140) uniform LightData    { vec4 lightPositions[4]; vec4 lightColors[4]; };
+//  layout (std140) uniform MaterialData { vec3 Albedo; float Metallic; float Roughness; float AO; float useTextures; };
+//
+// vec3 members are followed by a float so nothing is padded, arrays use vec4 (std140 rounds array elements to 16 bytes).
+
+const GLuint FRAME_DATA_BINDING = 0;
+const GLuint LIGHT_DATA_BINDING = 1;
+const GLuint MATERIAL_DATA_BINDING = 2;
+
+const int MAX_LIGHTS = 4;
+
+// per frame, the same for all programs
+struct FrameData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 camPos;
+    float gamma;
+};
+
+// per light (xyz used, w is padding), switched off lights are black
+struct LightData
+{
+    glm::vec4 lightPositions[MAX_LIGHTS];
+    glm::vec4 lightColors[MAX_LIGHTS];
+};
+
+// per material, the constant values used without textures
+struct MaterialData
+{
+    glm::vec3 albedo;
+    float metallic;
+    float roughness;
+    float ao;
+    float useTextures;
+    float padding; // std140 rounds the block size up to 16 bytes
+};
+
+static_assert(sizeof(FrameData) == 144 && offsetof(FrameData, camPos) == 128 && offsetof(FrameData, gamma) == 140, "FrameData does not match std140");
+static_assert(sizeof(LightData) == 128 && offsetof(LightData, lightColors) == 64, "LightData does not match std140");
+static_assert(sizeof(MaterialData) == 32 && offsetof(MaterialData, metallic) == 12 && offsetof(MaterialData, useTextures) == 24, "MaterialData does not match std140");
+
+// the binding point of a uniform block by its name in GLSL, -1 for blocks that are not shared
+// ---------------------------------------------------
+GLint uniformBlockBinding(const std::string &name)
+{
+    if (name == "FrameData")
+        return FRAME_DATA_BINDING;
+    if (name == "LightData")
+        return LIGHT_DATA_BINDING;
+    if (name == "MaterialData")
+        return MATERIAL_DATA_BINDING;
+    return -1;
+}
+
+// a uniform buffer holding one T, bound to its binding point for its whole lifetime (create it after the context)
+template <class T>
+class UniformBuffer
+{
+public:
+    UniformBuffer(GLuint binding) : m_binding{binding}
+    {
+        glGenBuffers(1, &m_ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_ubo);
+    }
+    ~UniformBuffer() { glDeleteBuffers(1, &m_ubo); }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    // uploads the data, unless it is the same as the last upload
+    void Update(const T &data)
+    {
+        if (m_uploaded && std::memcmp(&data, &m_last, sizeof(T)) == 0)
+            return;
+        glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_last = data;
+        m_uploaded = true;
+        m_uploads++;
+    }
+
+    GLuint ID() const { return m_ubo; }
+    // number of uploads that were not skipped
+    size_t Uploads() const { return m_uploads; }
+
+private:
+    GLuint m_ubo = 0;
+    GLuint m_binding;
+    T m_last;
+    bool m_uploaded = false;
+    size_t m_uploads = 0;
+};
+
+#endif
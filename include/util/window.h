@@ -20,6 +20,7 @@
 
 GLFWwindow *window = nullptr;
 bool gui = false;
+int glMajorVersion = 0, glMinorVersion = 0; // of the context that was created
 
 // utility function to derminate the window
 // ---------------------------------------------------
@@ -32,9 +33,10 @@ void DestroyWindow(void)
     }
 }
 
-// utility function to instantiate a GLFW3 window
+// utility function to instantiate a GLFW3 window. The context is at least OpenGL major.minor (core profile); if the
+// driver has no such context (e.g., macOS stops at 4.1), it falls back to 3.3, check glMajorVersion/glMinorVersion.
 // ---------------------------------------------------
-int InitWindow(int &width, int &height, const char *appname = "OpenGL", bool resizeable = true)
+int InitWindow(int &width, int &height, const char *appname = "OpenGL", bool resizeable = true, int major = 3, int minor = 3)
 {
     // glfw: initialize and configure
     // ------------------------------
@@ -42,8 +44,8 @@ int InitWindow(int &width, int &height, const char *appname = "OpenGL", bool res
     glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
 
     // glsl_version = "#version 440";
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES, 4);
     glfwWindowHint(GLFW_RED_BITS, 8);
@@ -62,6 +64,13 @@ int InitWindow(int &width, int &height, const char *appname = "OpenGL", bool res
     // glfw window creation
     // --------------------
     window = glfwCreateWindow(width, height, appname, NULL, NULL);
+    if (window == NULL && (major > 3 || (major == 3 && minor > 3)))
+    {
+        std::cout << "OpenGL " << major << "." << minor << " is not available, falling back to 3.3" << std::endl;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(width, height, appname, NULL, NULL);
+    }
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -81,15 +90,17 @@ int InitWindow(int &width, int &height, const char *appname = "OpenGL", bool res
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    glGetIntegerv(GL_MAJOR_VERSION, &glMajorVersion);
+    glGetIntegerv(GL_MINOR_VERSION, &glMinorVersion);
 
     return 0; // success
 }
 
 // utility function to instantiate a GLFW3 window and a GUI
 // ---------------------------------------------------
-int InitWindowAndGUI(int &width, int &height, const char *appname = "OpenGL", bool resizeable = true)
+int InitWindowAndGUI(int &width, int &height, const char *appname = "OpenGL", bool resizeable = true, int major = 3, int minor = 3)
 {
-    if (InitWindow(width, height, appname, resizeable) >= 0)
+    if (InitWindow(width, height, appname, resizeable, major, minor) >= 0)
     {
 
         // Setup Dear ImGui context
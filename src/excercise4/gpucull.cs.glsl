@@ -0,0 +1,94 @@
+#version 430 core
+// culling of the objects of a GpuScene (see gpuscene.h): one invocation per object, its draw command gets one
+// instance if the object is visible and none otherwise
+layout (local_size_x = 64) in;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsCenter; // model space
+    vec4 boundsExtent; // half extent
+    uint count;
+    uint firstIndex;
+    int baseVertex;
+    uint material;
+};
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+layout (std430, binding = 1) writeonly buffer Commands
+{
+    DrawCommand commands[];
+};
+
+uniform int objectCount;
+uniform vec4 planes[6]; // world space, the normals point inside (see Frustum in culling.h)
+uniform bool occlusionCulling;
+uniform mat4 viewProjection;
+layout (binding = 0) uniform sampler2D hiZ; // farthest depth of the last frame, see HiZPyramid
+
+bool insideFrustum(vec3 center, vec3 extent)
+{
+    for (int i = 0; i < 6; i++)
+        if (dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), extent) < 0.0)
+            return false;
+    return true;
+}
+
+// true if the box is behind the depth buffer everywhere on its screen rectangle
+bool occluded(vec3 center, vec3 extent)
+{
+    vec3 ndcMin = vec3(1.0);
+    vec3 ndcMax = vec3(-1.0);
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = center + extent * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0)
+            return false; // reaches behind the camera
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+    vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+    float nearest = ndcMin.z * 0.5 + 0.5;
+
+    // in this level the rectangle is at most one texel wide, so it touches at most 2x2 texels
+    vec2 size = (uvMax - uvMin) * vec2(textureSize(hiZ, 0));
+    float level = ceil(log2(max(max(size.x, size.y), 1.0)));
+    float farthest = max(max(textureLod(hiZ, uvMin, level).r, textureLod(hiZ, vec2(uvMax.x, uvMin.y), level).r),
+                         max(textureLod(hiZ, vec2(uvMin.x, uvMax.y), level).r, textureLod(hiZ, uvMax, level).r));
+    return nearest > farthest;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uint(objectCount))
+        return;
+    Object object = objects[i];
+
+    // world space box around the transformed one (see BoundsSoA::Transform)
+    vec3 center = vec3(object.model * vec4(object.boundsCenter.xyz, 1.0));
+    mat3 m = mat3(object.model);
+    vec3 extent = mat3(abs(m[0]), abs(m[1]), abs(m[2])) * object.boundsExtent.xyz;
+    bool visible = insideFrustum(center, extent) && !(occlusionCulling && occluded(center, extent));
+
+    commands[i].count = object.count;
+    commands[i].instanceCount = visible ? 1u : 0u;
+    commands[i].firstIndex = object.firstIndex;
+    commands[i].baseVertex = object.baseVertex;
+    commands[i].baseInstance = i; // the vertex shader finds the object through it
+}
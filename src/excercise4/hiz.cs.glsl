@@ -0,0 +1,30 @@
+#version 430 core
+// one level of the depth pyramid (see HiZPyramid in gpuscene.h): level 0 is a copy of the depth buffer, every
+// further texel holds the farthest depth of the texels of the level above it covers
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (binding = 0) uniform sampler2D depthTexture;            // level 0
+layout (r32f, binding = 0) readonly uniform image2D source;      // the level above
+layout (r32f, binding = 1) writeonly uniform image2D destination;
+uniform int level;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, imageSize(destination))))
+        return;
+    if (level == 0)
+    {
+        imageStore(destination, texel, vec4(texelFetch(depthTexture, texel, 0).r));
+        return;
+    }
+
+    // with an odd size the last row and column of the source are covered by the texels before them as well
+    ivec2 sourceSize = imageSize(source);
+    ivec2 extra = sourceSize & 1;
+    float depth = 0.0;
+    for (int y = 0; y <= 1 + extra.y; y++)
+        for (int x = 0; x <= 1 + extra.x; x++)
+            depth = max(depth, imageLoad(source, min(texel * 2 + ivec2(x, y), sourceSize - 1)).r);
+    imageStore(destination, texel, vec4(depth));
+}
@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per instance (see InstanceData in instancing.h)
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in vec4 aInstanceColor;
+
+// shared with the other programs, bound by Shader (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    float gamma;
+};
+
+flat out vec3 LightColor;
+
+void main()
+{
+    LightColor = aInstanceColor.rgb;
+    gl_Position = projection * view * aInstanceModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
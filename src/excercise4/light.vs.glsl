@@ -3,11 +3,21 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// shared with the other programs, bound by Shader (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    float gamma;
+};
 uniform mat4 model;
+uniform vec3 lightColor;
+
+flat out vec3 LightColor;
 
 void main()
 {
+    LightColor = lightColor;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
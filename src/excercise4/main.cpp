@@ -6,6 +6,7 @@
 #include <sstream>
 #include <iomanip>
 #include <optional>
+#include <random>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -16,6 +17,8 @@
 #include <util/model.h>
 #include <util/window.h>
 #include <util/assets.h>
+#include <util/renderqueue.h>
+#include <util/gpuscene.h>
 
 using namespace std;
 // using namespace nanogui;
@@ -26,6 +29,7 @@ AssetManager assets({{"sphere", // group
                       {{"model", "../resources/simple/sphere.obj"},
                        {"transformation", glm::scale(glm::mat4(1.0f), glm::vec3(1.0))},
                        {TEX_FLIP, false}, // if true, causes textures to be flipped in y
+                       {MESH_OPTIMIZE, false}, // if true, meshes are welded and reordered at load time
                        {"albedo", "../resources/textures/rusted_iron/albedo.png"},
                        {"normal", "../resources/textures/rusted_iron/normal.png"},
                        {"metallness", "../resources/textures/rusted_iron/metallic.png"},
@@ -35,15 +39,31 @@ AssetManager assets({{"sphere", // group
                       {{"model", "../resources/objects/helmet/helmet.obj"},
                        {"transformation", glm::scale(glm::mat4(1.0f), glm::vec3(1.0))},
                        {TEX_FLIP, true}, // if true, causes textures to be flipped in y
+                       {MESH_OPTIMIZE, true},
+                       {MESH_FAST_OBJ, true}, // if true, the parallel OBJ parser is used instead of Assimp
+                       {MESH_LODS, true}, // if true, simplified levels of detail are generated at load time
                        {"albedo", "../resources/objects/helmet/albedo.jpg"},
                        {"normal", "../resources/objects/helmet/normal.jpg"},
                        {"metallness", "../resources/objects/helmet/metall.jpg"},
                        {"roughness", "../resources/objects/helmet/roughness.jpg"},
                        {"ao", "../resources/objects/helmet/AO.jpg"}}},
+                     {"helmet-gltf", // group, same asset read by the native glTF loader
+                      {{"model", "../resources/objects/helmet/DamagedHelmet.glb"},
+                       {"transformation", glm::scale(glm::mat4(1.0f), glm::vec3(1.0))},
+                       {TEX_FLIP, true}, // if true, causes textures to be flipped in y
+                       {MESH_OPTIMIZE, true},
+                       {MESH_LODS, true}, // if true, simplified levels of detail are generated at load time
+                       {"albedo", "../resources/objects/helmet/Default_albedo.jpg"}, // same content as albedo.jpg, shared by the texture cache
+                       {"normal", "../resources/objects/helmet/Default_normal.jpg"},
+                       {"metallness", "../resources/objects/helmet/metall.jpg"},
+                       {"roughness", "../resources/objects/helmet/roughness.jpg"},
+                       {"ao", "../resources/objects/helmet/Default_AO.jpg"}}},
                      {"backpack", // group
                       {{"model", "../resources/objects/backpack/backpack.obj"},
                        {"transformation", glm::scale(glm::mat4(1.0f), glm::vec3(1.0))},
                        {TEX_FLIP, true}, // this causes textures to be flipped in y
+                       {MESH_OPTIMIZE, true},
+                       {MESH_LODS, true}, // if true, simplified levels of detail are generated at load time
                        {"albedo", "../resources/objects/backpack/diffuse.jpg"},
                        {"normal", "../resources/objects/backpack/normal.png"},
                        {"metallness", "../resources/objects/backpack/specular.jpg"},
@@ -53,6 +73,8 @@ AssetManager assets({{"sphere", // group
                       {{"model", "../resources/objects/mouse/mouse.obj"},
                        {"transformation", glm::scale(glm::mat4(1.0f), glm::vec3(1.0))},
                        {TEX_FLIP, true}, // this causes textures to be flipped in y
+                       {MESH_OPTIMIZE, true},
+                       {MESH_LODS, true}, // if true, simplified levels of detail are generated at load time
                        {"albedo", "../resources/objects/mouse/default.png"},
                        {"normal", "../resources/objects/mouse/normal.png"},
                        {"metallness", "../resources/objects/mouse/metallic.png"},
@@ -64,7 +86,11 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
-void renderSphere();
+const unsigned int SPHERE_LODS = 4; // levels of detail of the sphere, see sphereLod
+void renderSphere(unsigned int lod = 0);
+void renderSphereInstanced(unsigned int lod, const InstanceBuffer &instances);
+DrawPacket spherePacket(unsigned int lod);
+unsigned int sphereLod(const glm::vec3 &center, float radius, float maxPixelError);
 
 // settings
 int SCR_WIDTH = 1280;
@@ -97,9 +123,9 @@ int main()
     bool rotateModel = false;
     int numLights;
 
-    // glfw: initialize and configure
+    // glfw: initialize and configure (OpenGL 4.3 for the GPU-driven path if available, otherwise 3.3)
     // ------------------------------
-    InitWindowAndGUI(SCR_WIDTH, SCR_HEIGHT, APP_NAME);
+    InitWindowAndGUI(SCR_WIDTH, SCR_HEIGHT, APP_NAME, true, 4, 3);
 
     // OpenGL is initialized now, so we can use OpenGL functions (glFoo ...)
     // ------------------------------
@@ -114,33 +140,81 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().Enable(GL_DEPTH_TEST);
 
-    // loaded model
+    // import the startup group up front (model and textures in parallel). The other groups are streamed in when
+    // they are selected, or all of them are preloaded with the "preload all groups" button.
     // -------------------------
+    auto printPreloadProgress = [](const PreloadProgress &progress)
+    { std::cout << "\r  [" << progress.done << "/" << progress.total << "] " << progress.asset << "\x1b[K" << std::flush; };
     assets.SetActiveGroup("sphere");
-    Model loadedModel = assets.GetActiveAsset<Model>("model"); // new Model(FileSystem::getPath("resources/objects/cerberus/Cerberus_LP.FBX").c_str());
+    assets.Preload({assets.GetActiveGroup()}, printPreloadProgress);
+    std::cout << std::endl;
+
+    // loaded model
+    // -------------------------
+    ModelHandle modelHandle = assets.GetModelHandle(assets.GetActiveGroup(), "model"); // the model is owned by the asset registry, no copies
     glm::mat4 modelTransformation = assets.GetActiveAsset<glm::mat4>("transformation");
 
-    // load PBR material textures
+    // load PBR material textures (decoded in parallel, then uploaded)
     // --------------------------
-    unsigned int albedoMap = assets.GetActiveAsset<Tex>("albedo");
-    unsigned int normalMap = assets.GetActiveAsset<Tex>("normal");
-    unsigned int metallicMap = assets.GetActiveAsset<Tex>("metallness");
-    unsigned int roughnessMap = assets.GetActiveAsset<Tex>("roughness");
-    unsigned int aoMap = assets.GetActiveAsset<Tex>("ao");
+    // the handles are resolved every frame (assets.Get), which marks the textures as used for the GPU memory
+    // budget and loads them again if they were evicted
+    assets.LoadTextures(assets.GetActiveGroup());
+    TexHandle albedoHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "albedo");
+    TexHandle normalHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "normal");
+    TexHandle metallicHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "metallness");
+    TexHandle roughnessHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "roughness");
+    TexHandle aoHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "ao");
+    unsigned int albedoMap, normalMap, metallicMap, roughnessMap, aoMap;
+
+    // streaming: on a group switch the assets are requested in the background. The handles resolve to
+    // placeholders (empty model, 1x1 textures) until the data is resident, so the frame never waits for loading.
+    bool compactVertices = false; // quantized vertex layout, compare the frame time against the float layout
+    float lodPixelError = 1.0f;   // allowed screen space error of the levels of detail (0 = always full resolution)
+    bool useArena = false;        // draw the model meshes from one shared buffer with a multi-draw
+    bool useUniformHandles = true; // set the uniforms through handles instead of names, compare the render loop CPU time
+    bool useRenderQueue = true;    // collect the draws and submit them sorted by shader, material and VAO
+    RenderQueue renderQueue;
+    float renderCpuMicros = 0.0f; // CPU time of the render commands (uniforms, binds, draws), averaged over frames
+    bool frustumCulling = true;   // skip model meshes outside the view (Camera::GetFrustum)
+    bool streamAssets = true;
+    int uploadBudgetMB = 4;
+    int gpuBudgetMB = (int)(assets.gpuBudget / (1024 * 1024));
+
     // build and compile shaders
     // -------------------------
-    const std::string SRC = "../src/10-pbr-solution/";
+    const std::string SRC = "../src/excercise4/";
     Shader shader(SRC + "pbr.vs.glsl", SRC + "pbr.fs.glsl");
     Shader lightShader(SRC + "light.vs.glsl", SRC + "light.fs.glsl");
-
-    shader.use();
-    shader.setInt("albedoMap", 0);
-    shader.setInt("normalMap", 1);
-    shader.setInt("metallicMap", 2);
-    shader.setInt("roughnessMap", 3);
-    shader.setInt("aoMap", 4);
+    // instanced variants: transform and material per instance (see instancing.h)
+    Shader instancedShader(SRC + "pbr.instanced.vs.glsl", SRC + "pbr.fs.glsl");
+    Shader instancedLightShader(SRC + "light.instanced.vs.glsl", SRC + "light.fs.glsl");
+    bool instancedReady = instancedShader.isReady() && instancedLightShader.isReady(); // else the grid is not drawn
+    // startup cost of the programs: compiled (cold) on the first run, from the program binary cache (warm) afterwards
+    std::cout << "Shader startup: " << shader.loadMilliseconds + lightShader.loadMilliseconds << " ms, program binary cache "
+              << (shader.fromProgramCache && lightShader.fromProgramCache ? "warm" : "cold") << std::endl;
+
+    auto setSamplers = [](Shader &pbrShader)
+    {
+        pbrShader.use();
+        pbrShader.setInt("albedoMap", 0);
+        pbrShader.setInt("normalMap", 1);
+        pbrShader.setInt("metallicMap", 2);
+        pbrShader.setInt("roughnessMap", 3);
+        pbrShader.setInt("aoMap", 4);
+    };
+    setSamplers(shader);
+    setSamplers(instancedShader);
+    // GPU-driven path (see gpuscene.h): culling and the depth pyramid are compute shaders
+    std::optional<Shader> gpuShader, cullShader, hiZShader;
+    if (gpuDrivenSupported())
+    {
+        gpuShader.emplace(SRC + "pbr.gpu.vs.glsl", SRC + "pbr.fs.glsl");
+        cullShader.emplace(SRC + "gpucull.cs.glsl");
+        hiZShader.emplace(SRC + "hiz.cs.glsl");
+        setSamplers(*gpuShader);
+    }
 
     // lights
     // ------
@@ -156,22 +230,60 @@ int main()
         glm::vec3(300.0f, 300.0f, 300.0f),
         glm::vec3(300.0f, 300.0f, 300.0f)};
     numLights = sizeof(lightPositions) / sizeof(lightPositions[0]);
+
+    // uniform blocks shared by both programs (see uniformblocks.h) and handles for the per-draw uniforms,
+    // fetched once (they stay valid when the shaders are reloaded)
+    // -----------------------------------------------------------------------------------------------
+    UniformBuffer<FrameData> frameUniforms(FRAME_DATA_BINDING);
+    UniformBuffer<LightData> lightUniforms(LIGHT_DATA_BINDING);
+    UniformBuffer<MaterialData> materialUniforms(MATERIAL_DATA_BINDING);
+    auto uModel = shader.getUniform<glm::mat4>("model");
+    auto uLightModel = lightShader.getUniform<glm::mat4>("model");
+    auto uLightColor = lightShader.getUniform<glm::vec3>("lightColor");
+    auto uInstancedModel = instancedShader.getUniform<glm::mat4>("model");
+
+    // instanced grid of the model: metallic increases with the rows, roughness with the columns. The instance
+    // buffer is only filled again when the grid changes, the model rotation is the model uniform.
+    bool instancedGrid = false;
     int nrRows = 7;
     int nrColumns = 7;
     float spacing = 2.5;
+    int gridRows = 0, gridColumns = 0;
+    float gridSpacing = 0.0f;
+    glm::vec3 gridAlbedo(-1.0f);
+    InstanceBuffer gridInstances, lightInstances;
+    std::vector<InstanceData> instanceData, lightInstanceData;
+
+    // culling benchmark: many small spheres scattered around the scene, culled against the view frustum every frame
+    // (SoA bounds, SSE/AVX) and the visible ones drawn with one instanced draw
+    bool cullingBenchmark = false;
+    bool simdCulling = true;
+    int benchmarkObjects = 100000;
+    BoundsSoA benchmarkBounds;
+    std::vector<InstanceData> benchmarkData, benchmarkVisibleData;
+    std::vector<uint32_t> benchmarkVisible;
+    InstanceBuffer benchmarkInstances;
+    float cullMicros = 0.0f; // averaged over frames
+
+    // GPU-driven: copies of the model scattered around the scene, culled by a compute shader (frustum and, with
+    // occlusion culling, the depth pyramid of the previous frame) and drawn with one multi-draw per material
+    bool gpuDriven = false;
+    bool occlusionCulling = false;
+    int gpuCopies = 1000;
+    GpuScene gpuScene;
+    HiZPyramid hiZ;
+    bool hiZCurrent = false; // the pyramid holds the depth of the last frame
+    const Model *gpuSceneModel = nullptr;
+    size_t gpuSceneMeshes = 0;
+    int gpuSceneCopies = 0;
+    unsigned int gpuSceneArenaSerial = 0; // the scene holds the arena ranges of this placement (see Model::arenaSerial)
 
-    // initialize static shader uniforms before rendering
-    // --------------------------------------------------
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    shader.use();
-    shader.setMat4("projection", projection);
 
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
-        glEnable(GL_DEPTH_TEST);
-
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
@@ -194,7 +306,57 @@ int main()
             // 2. Show a simple window that we create ourselves. We use a Begin/End pair to created a named window.
             {
                 ImGui::Begin(APP_NAME);
-                ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+                ImGui::Text("FPS: %.1f (%.3f ms/frame)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+                ImGui::Checkbox("compact vertices", &compactVertices);
+                ImGui::Text("vertex buffers: %.2f MB", assets.Get(modelHandle).VertexBytes() / (1024.0f * 1024.0f));
+                ImGui::SliderFloat("LOD error (pixels)", &lodPixelError, 0.0f, 8.0f);
+                ImGui::Text("model triangles: %u", assets.Get(modelHandle).drawnTriangles);
+                ImGui::Checkbox("shared mesh arena", &useArena);
+                ImGui::Text("model draw calls: %u", assets.Get(modelHandle).drawCalls);
+                ImGui::Checkbox("uniform handles", &useUniformHandles);
+                if (!useUniformHandles)
+                    ImGui::Checkbox("cache uniform locations", &uniformLocationCacheEnabled);
+                ImGui::Checkbox("instanced grid", &instancedGrid);
+                if (instancedGrid && !instancedReady)
+                    ImGui::Text("instanced shaders did not build (see the log)");
+                else if (instancedGrid)
+                {
+                    ImGui::SliderInt("rows", &nrRows, 1, 200);
+                    ImGui::SliderInt("columns", &nrColumns, 1, 200);
+                    ImGui::SliderFloat("spacing", &spacing, 0.5f, 5.0f);
+                    ImGui::Text("%d instances", nrRows * nrColumns);
+                }
+                ImGui::Checkbox("frustum culling", &frustumCulling);
+                ImGui::Text("culled meshes: %u", assets.Get(modelHandle).culledMeshes);
+                ImGui::Checkbox("culling benchmark", &cullingBenchmark);
+                if (cullingBenchmark)
+                {
+                    ImGui::SliderInt("objects", &benchmarkObjects, 1000, 100000);
+                    ImGui::Checkbox("SIMD culling", &simdCulling);
+                    ImGui::Text("culling: %.1f us/frame, %d of %d visible", cullMicros, (int)benchmarkVisible.size(), (int)benchmarkBounds.Size());
+                }
+                if (gpuDrivenSupported())
+                {
+                    ImGui::Checkbox("GPU-driven (compute culling)", &gpuDriven);
+                    if (gpuDriven && !(gpuShader->isReady() && cullShader->isReady()))
+                        ImGui::Text("GPU-driven shaders did not build (see the log)");
+                    else if (gpuDriven)
+                    {
+                        ImGui::SliderInt("model copies", &gpuCopies, 1, 10000);
+                        ImGui::Checkbox("occlusion culling (Hi-Z)", &occlusionCulling);
+                        if (occlusionCulling && !hiZShader->isReady())
+                            ImGui::Text("Hi-Z shader did not build (see the log)");
+                        ImGui::Text("GPU scene: %d objects, %d materials, %u multi-draws", (int)gpuScene.Size(), (int)gpuScene.Buckets(), gpuScene.drawCalls);
+                    }
+                }
+                else
+                    ImGui::Text("GPU-driven: needs OpenGL 4.3 (context %d.%d)", glMajorVersion, glMinorVersion);
+                ImGui::Checkbox("render queue", &useRenderQueue);
+                if (useRenderQueue)
+                    ImGui::Text("queue: %u draws, %u program switches, %u material binds", renderQueue.LastStats().draws,
+                                renderQueue.LastStats().programSwitches, renderQueue.LastStats().materialBinds);
+                ImGui::Text("render loop CPU: %.1f us", renderCpuMicros);
+                ImGui::Text("GL state calls: %d issued, %d skipped", (int)glState().IssuedLastFrame(), (int)glState().SkippedLastFrame());
                 ImGui::Checkbox("Rotate model", &rotateModel);
                 ImGui::Checkbox("animate lights", &animateLight);
                 ImGui::SliderInt("number lights", &numLights, 1, sizeof(lightPositions) / sizeof(lightPositions[0]));
@@ -214,35 +376,110 @@ int main()
                 for (int i = 0; i < ass.size(); ++i)
                     strings.push_back(ass[i].c_str());
                 ImGui::Combo("model", &item_current, strings.data(), ass.size());
+                ImGui::Checkbox("stream assets", &streamAssets);
+                if (streamAssets)
+                {
+                    ImGui::SliderInt("upload budget (MB/frame)", &uploadBudgetMB, 1, 64);
+                    assets.Streamer().frameBudget = (size_t)uploadBudgetMB * 1024 * 1024;
+                    ImGui::Text("streaming: %d assets pending", (int)assets.Streamer().Pending());
+                }
+                if (ImGui::Button("preload all groups")) // afterwards a group switch only swaps the handles
+                {
+                    assets.Preload(assets.GetGroups(), printPreloadProgress);
+                    std::cout << std::endl;
+                }
                 if (assets.GetActiveGroupId() != item_current)
                 {
                     assets.SetActiveGroup(item_current);
                     // loaded model and (PBR) texutes
                     // -------------------------
-                    loadedModel = assets.GetActiveAsset<Model>("model");
                     modelTransformation = assets.GetActiveAsset<glm::mat4>("transformation");
-                    albedoMap = assets.GetActiveAsset<Tex>("albedo");
-                    normalMap = assets.GetActiveAsset<Tex>("normal");
-                    metallicMap = assets.GetActiveAsset<Tex>("metallness");
-                    roughnessMap = assets.GetActiveAsset<Tex>("roughness");
-                    aoMap = assets.GetActiveAsset<Tex>("ao");
+                    if (const ResidentGroup *resident = assets.ActiveResident()) // preloaded: only the handles change
+                    {
+                        modelHandle = resident->model;
+                        albedoHandle = resident->Texture("albedo");
+                        normalHandle = resident->Texture("normal");
+                        metallicHandle = resident->Texture("metallness");
+                        roughnessHandle = resident->Texture("roughness");
+                        aoHandle = resident->Texture("ao");
+                    }
+                    else if (streamAssets)
+                    {
+                        auto group = assets.GetActiveGroup();
+                        modelHandle = assets.StreamModel(group, "model");
+                        albedoHandle = assets.StreamTexture(group, "albedo");
+                        normalHandle = assets.StreamTexture(group, "normal", 0xffff8080); // flat tangent space normal
+                        metallicHandle = assets.StreamTexture(group, "metallness", 0xff000000);
+                        roughnessHandle = assets.StreamTexture(group, "roughness");
+                        aoHandle = assets.StreamTexture(group, "ao", 0xffffffff);
+                    }
+                    else
+                    {
+                        modelHandle = assets.GetModelHandle(assets.GetActiveGroup(), "model");
+                        assets.LoadTextures(assets.GetActiveGroup());
+                        albedoHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "albedo");
+                        normalHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "normal");
+                        metallicHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "metallness");
+                        roughnessHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "roughness");
+                        aoHandle = assets.GetTextureHandle(assets.GetActiveGroup(), "ao");
+                    }
                 }
+                ImGui::SliderInt("GPU asset budget (MB)", &gpuBudgetMB, 16, 2048);
+                assets.gpuBudget = (size_t)gpuBudgetMB * 1024 * 1024;
+                ImGui::Text("GPU assets: %.2f MB resident, %d evictions", assets.ResidentBytes() / (1024.0f * 1024.0f), (int)assets.Evictions());
+                if (ImGui::Button("print memory report"))
+                    assets.PrintMemoryReport();
                 // a Button to reload the shader (so you don't need to recompile the cpp all the time)
                 if (ImGui::Button("reload shaders"))
                 {
                     shader.reload();
-                    shader.use();
-                    shader.setInt("albedoMap", 0);
-                    shader.setInt("normalMap", 1);
-                    shader.setInt("metallicMap", 2);
-                    shader.setInt("roughnessMap", 3);
-                    shader.setInt("aoMap", 4);
+                    lightShader.reload();
+                    instancedShader.reload();
+                    instancedLightShader.reload();
+                    if (gpuShader)
+                    {
+                        gpuShader->reload();
+                        cullShader->reload();
+                        hiZShader->reload();
+                    }
                 }
+                if (shader.isReloading() || lightShader.isReloading() || instancedShader.isReloading() || instancedLightShader.isReloading())
+                    ImGui::Text("compiling shaders ...");
 
                 ImGui::End();
             }
         }
 
+        // swap in reloaded shaders (saved .glsl files are picked up automatically) once the driver linked them
+        lightShader.update();
+        instancedLightShader.update();
+        if (shader.update())
+            setSamplers(shader);
+        if (instancedShader.update())
+            setSamplers(instancedShader);
+        instancedReady = instancedShader.isReady() && instancedLightShader.isReady(); // a reload can fix a failed build
+        if (gpuShader)
+        {
+            cullShader->update();
+            hiZShader->update();
+            if (gpuShader->update())
+                setSamplers(*gpuShader);
+        }
+
+        // finish streaming requests (within the upload budget) and resolve the handles
+        // -----------------------------------------------------------------------------
+        assets.UpdateStreaming();
+        albedoMap = assets.Get(albedoHandle);
+        normalMap = assets.Get(normalHandle);
+        metallicMap = assets.Get(metallicHandle);
+        roughnessMap = assets.Get(roughnessHandle);
+        aoMap = assets.Get(aoHandle);
+        Model &activeModel = assets.Get(modelHandle);
+        VertexLayout layout = compactVertices ? VertexLayout::Compact : VertexLayout::Full;
+        if (activeModel.vertexLayout != layout)
+            activeModel.SetVertexLayout(layout);
+        activeModel.UseArena(useArena || gpuDriven ? &sharedMeshArena() : nullptr); // the GPU scene draws from the arena
+
         // render
         // ------
         if (gui)
@@ -255,83 +492,223 @@ int main()
 
         // configure global opengl state
         // -----------------------------
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        glState().Enable(GL_DEPTH_TEST);
+        glState().Disable(GL_BLEND);
 
-        shader.use();
+        auto renderStart = std::chrono::high_resolution_clock::now();
         projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        shader.setMat4("projection", projection);
         glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("view", view);
-        shader.setVec3("camPos", camera.Position);
-        shader.setVec3("Albedo", albedo.r, albedo.g, albedo.b);
-        shader.setFloat("AO", 1.0f);
-        shader.setFloat("Metallic", metallic);
-        shader.setFloat("Roughness", glm::clamp(roughness, 0.00001f, 1.0f)); //  we clamp the roughness to 0.05 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off  on direct lighting.
-        shader.setFloat("gamma", gamma);
-        shader.setFloat("useTextures", useTextures ? 1.0f : 0.0f);
+        Frustum frustum = camera.GetFrustum(projection);
+        const Frustum *cullFrustum = frustumCulling ? &frustum : nullptr;
+
+        // per-frame, per-light and per-material data: one buffer upload each (skipped if unchanged) for all programs
+        FrameData frameData = {projection, view, camera.Position, gamma};
+        frameUniforms.Update(frameData);
+        //  we clamp the roughness to 0.05 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off  on direct lighting.
+        MaterialData materialData = {albedo, metallic, glm::clamp(roughness, 0.00001f, 1.0f), 1.0f, useTextures ? 1.0f : 0.0f, 0.0f};
+        materialUniforms.Update(materialData);
+        LightData lightData;
+        glm::vec3 lightPositionsNow[MAX_LIGHTS];
+        for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+        {
+            if (animateLight)
+                lightPositionsNow[i] = lightPositions[i] + glm::vec3(sin(glfwGetTime() * i * 5.0) * 5.0, cos(glfwGetTime() * i * 3.0) * 5.0, 0.0);
+            else
+                lightPositionsNow[i] = lightPositions[i];
+            lightData.lightPositions[i] = glm::vec4(lightPositionsNow[i], 1.0f);
+            lightData.lightColors[i] = glm::vec4(i >= numLights ? glm::vec3(0.0f) : lightColors[i], 1.0f); // switched off lights are black
+        }
+        lightUniforms.Update(lightData);
 
+        shader.use();
         if (useTextures)
         {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, albedoMap);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, normalMap);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, metallicMap);
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, roughnessMap);
-            glActiveTexture(GL_TEXTURE4);
-            glBindTexture(GL_TEXTURE_2D, aoMap);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, albedoMap);
+            glState().ActiveTexture(GL_TEXTURE1);
+            glState().BindTexture(GL_TEXTURE_2D, normalMap);
+            glState().ActiveTexture(GL_TEXTURE2);
+            glState().BindTexture(GL_TEXTURE_2D, metallicMap);
+            glState().ActiveTexture(GL_TEXTURE3);
+            glState().BindTexture(GL_TEXTURE_2D, roughnessMap);
+            glState().ActiveTexture(GL_TEXTURE4);
+            glState().BindTexture(GL_TEXTURE_2D, aoMap);
         }
 
         auto model = (glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 1.0f))) * modelTransformation;
         if (rotateModel)
             model = glm::rotate(model, (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
 
-        shader.setMat4("model", model);
-        shader.setFloat("roughness", 0.05f);
-        loadedModel.Draw(shader);
+        bool drawGpuScene = gpuDriven && gpuShader && gpuShader->isReady() && cullShader->isReady();
+        if (drawGpuScene)
+        {
+            if (&activeModel != gpuSceneModel || activeModel.meshes.size() != gpuSceneMeshes || gpuCopies != gpuSceneCopies ||
+                activeModel.arenaSerial != gpuSceneArenaSerial) // the meshes moved in the arena (eviction)
+            {
+                std::mt19937 random(2);
+                std::uniform_real_distribution<float> horizontal(-40.0f, 40.0f), vertical(-10.0f, 10.0f), angle(0.0f, 6.2831853f);
+                gpuScene.Clear();
+                for (int i = 0; i < gpuCopies; ++i)
+                {
+                    glm::vec3 position(horizontal(random), vertical(random), horizontal(random));
+                    glm::mat4 copy = glm::rotate(glm::translate(glm::mat4(1.0f), position), angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+                    activeModel.AddTo(gpuScene, copy * modelTransformation);
+                }
+                gpuSceneModel = &activeModel;
+                gpuSceneMeshes = activeModel.meshes.size();
+                gpuSceneCopies = gpuCopies;
+                gpuSceneArenaSerial = activeModel.arenaSerial;
+            }
+            gpuScene.Cull(*cullShader, frustum, projection * view, occlusionCulling && hiZCurrent ? &hiZ : nullptr);
+            gpuShader->use();
+            gpuScene.Draw(*gpuShader, sharedMeshArena());
 
-        // render light source (simply re-render sphere at light positions)
-        // this looks a bit off as we use the same shader, but it'll make their positions obvious and
-        // keeps the codeprint small.
-        for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+            lightShader.use();
+            for (int i = 0; i < numLights; ++i)
+            {
+                lightShader.set(uLightModel, glm::scale(glm::translate(glm::mat4(1.0f), lightPositionsNow[i]), glm::vec3(0.5f)));
+                lightShader.set(uLightColor, lightColors[i]);
+                renderSphere(sphereLod(lightPositionsNow[i], 0.5f, lodPixelError));
+            }
+        }
+        else if (instancedGrid && instancedReady)
         {
-            glm::vec3 newPos;
-            if (animateLight)
-                newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * i * 5.0) * 5.0, cos(glfwGetTime() * i * 3.0) * 5.0, 0.0);
-            else
-                newPos = lightPositions[i];
-            shader.use();
-            shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-            if (i >= numLights)
+            if (nrRows != gridRows || nrColumns != gridColumns || spacing != gridSpacing || albedo != gridAlbedo)
+            {
+                instanceData.clear();
+                for (int row = 0; row < nrRows; ++row)
+                    for (int col = 0; col < nrColumns; ++col)
+                    {
+                        InstanceData instance;
+                        instance.model = glm::translate(glm::mat4(1.0f), glm::vec3((col - nrColumns / 2) * spacing, (row - nrRows / 2) * spacing, 0.0f));
+                        instance.color = glm::vec4(albedo, 1.0f);
+                        // we clamp the roughness to 0.05 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off on direct lighting.
+                        instance.material = glm::vec4((float)row / (float)nrRows, glm::clamp((float)col / (float)nrColumns, 0.05f, 1.0f), 1.0f, 0.0f);
+                        instanceData.push_back(instance);
+                    }
+                gridInstances.Upload(instanceData);
+                gridRows = nrRows;
+                gridColumns = nrColumns;
+                gridSpacing = spacing;
+                gridAlbedo = albedo;
+            }
+            instancedShader.use();
+            instancedShader.set(uInstancedModel, model);
+            activeModel.DrawInstanced(instancedShader, gridInstances);
+
+            // all light spheres with one draw call, at the level of detail of the closest one
+            lightInstanceData.resize(numLights);
+            unsigned int lightLod = SPHERE_LODS;
+            for (int i = 0; i < numLights; ++i)
             {
-                shader.setVec3("lightColors[" + std::to_string(i) + "]", glm::vec3(0.0f)); // set to black!
+                lightInstanceData[i].model = glm::scale(glm::translate(glm::mat4(1.0f), lightPositionsNow[i]), glm::vec3(0.5f));
+                lightInstanceData[i].color = glm::vec4(lightColors[i], 1.0f);
+                lightLod = std::min(lightLod, sphereLod(lightPositionsNow[i], 0.5f, lodPixelError));
             }
+            lightInstances.Upload(lightInstanceData);
+            instancedLightShader.use();
+            renderSphereInstanced(lightLod, lightInstances);
+        }
+        else if (useRenderQueue)
+        {
+            // the model meshes and the light spheres are recorded and drawn sorted by shader, material and VAO
+            // (uniforms through handles), so each program is used once per frame
+            activeModel.Enqueue(renderQueue, shader, uModel, camera, model, (float)display_h, lodPixelError, 0, cullFrustum);
+            for (int i = 0; i < numLights; ++i)
+            {
+                DrawPacket packet = spherePacket(sphereLod(lightPositionsNow[i], 0.5f, lodPixelError));
+                packet.shader = &lightShader;
+                packet.modelUniform = uLightModel;
+                packet.model = glm::scale(glm::translate(glm::mat4(1.0f), lightPositionsNow[i]), glm::vec3(0.5f));
+                packet.colorUniform = uLightColor;
+                packet.color = lightColors[i];
+                renderQueue.Push(packet, 0, glm::length(lightPositionsNow[i] - camera.Position));
+            }
+            renderQueue.Submit();
+        }
+        else
+        {
+            if (useUniformHandles)
+                shader.set(uModel, model);
             else
+                shader.setMat4("model", model);
+            activeModel.Draw(shader, camera, model, (float)display_h, lodPixelError, cullFrustum);
+
+            // render light source (simply re-render sphere at light positions)
+            // this looks a bit off as we use the same shader, but it'll make their positions obvious and
+            // keeps the codeprint small.
+            lightShader.use();
+            for (int i = 0; i < numLights; ++i)
             {
-                shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
-                lightShader.use();
                 model = glm::mat4(1.0f);
-                model = glm::translate(model, newPos);
+                model = glm::translate(model, lightPositionsNow[i]);
                 model = glm::scale(model, glm::vec3(0.5f));
-                lightShader.setMat4("model", model);
-                lightShader.setMat4("projection", projection);
-                lightShader.setMat4("view", view);
-                lightShader.setVec3("lightColor", lightColors[i]);
-                renderSphere();
+                if (useUniformHandles)
+                {
+                    lightShader.set(uLightModel, model);
+                    lightShader.set(uLightColor, lightColors[i]);
+                }
+                else
+                {
+                    lightShader.setMat4("model", model);
+                    lightShader.setVec3("lightColor", lightColors[i]);
+                }
+                renderSphere(sphereLod(lightPositionsNow[i], 0.5f, lodPixelError));
             }
         }
 
+        if (cullingBenchmark)
+        {
+            if (benchmarkBounds.Size() != (size_t)benchmarkObjects)
+            {
+                std::mt19937 random(1);
+                std::uniform_real_distribution<float> horizontal(-150.0f, 150.0f), vertical(-20.0f, 20.0f), color(0.2f, 1.0f);
+                benchmarkBounds.Clear();
+                benchmarkBounds.Reserve(benchmarkObjects);
+                benchmarkData.resize(benchmarkObjects);
+                for (auto &object : benchmarkData)
+                {
+                    glm::vec3 position(horizontal(random), vertical(random), horizontal(random));
+                    object.model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.25f));
+                    object.color = glm::vec4(color(random), color(random), color(random), 1.0f);
+                    benchmarkBounds.Add(position - glm::vec3(0.25f), position + glm::vec3(0.25f));
+                }
+            }
+            auto cullStart = std::chrono::high_resolution_clock::now();
+            if (simdCulling)
+                benchmarkBounds.Cull(frustum, benchmarkVisible);
+            else
+                benchmarkBounds.CullScalar(frustum, benchmarkVisible);
+            auto cullEnd = std::chrono::high_resolution_clock::now();
+            cullMicros = 0.95f * cullMicros + 0.05f * std::chrono::duration<float, std::micro>(cullEnd - cullStart).count();
+
+            benchmarkVisibleData.resize(benchmarkVisible.size());
+            for (size_t i = 0; i < benchmarkVisible.size(); i++)
+                benchmarkVisibleData[i] = benchmarkData[benchmarkVisible[i]];
+            benchmarkInstances.Upload(benchmarkVisibleData);
+            instancedLightShader.use();
+            renderSphereInstanced(SPHERE_LODS - 1, benchmarkInstances);
+        }
+
+        // the depth pyramid for the occlusion culling of the next frame
+        hiZCurrent = drawGpuScene && occlusionCulling && hiZShader->isReady();
+        if (hiZCurrent)
+            hiZ.Build(*hiZShader, display_w, display_h);
+
+        auto renderEnd = std::chrono::high_resolution_clock::now();
+        renderCpuMicros = 0.95f * renderCpuMicros + 0.05f * std::chrono::duration<float, std::micro>(renderEnd - renderStart).count();
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         if (gui)
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        assets.EndFrame(); // evicts unused assets beyond the GPU memory budget
+        glState().EndFrame();
         glfwSwapBuffers(window);
     }
 
+    assets.ReleaseGpuResources(); // the asset manager is global and outlives the context
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -418,100 +795,150 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(yoffset);
 }
 
-// renders (and builds at first invocation) a sphere
+// builds the sphere level of detail lod, it has 64 >> lod segments
 // -------------------------------------------------
-unsigned int sphereVAO = 0;
-unsigned int indexCount;
-void renderSphere()
+unsigned int sphereVAO[SPHERE_LODS] = {};
+unsigned int indexCount[SPHERE_LODS];
+void buildSphere(unsigned int lod)
 {
-    if (sphereVAO == 0)
-    {
-        glGenVertexArrays(1, &sphereVAO);
+    glGenVertexArrays(1, &sphereVAO[lod]);
 
-        unsigned int vbo, ebo;
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
+    unsigned int vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
 
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec2> uv;
-        std::vector<glm::vec3> normals;
-        std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uv;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
 
-        const unsigned int X_SEGMENTS = 64;
-        const unsigned int Y_SEGMENTS = 64;
-        const float PI = 3.14159265359;
-        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+    const unsigned int X_SEGMENTS = 64 >> lod;
+    const unsigned int Y_SEGMENTS = 64 >> lod;
+    const float PI = 3.14159265359;
+    for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
+    {
+        for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+        {
+            float xSegment = (float)x / (float)X_SEGMENTS;
+            float ySegment = (float)y / (float)Y_SEGMENTS;
+            float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+            float yPos = std::cos(ySegment * PI);
+            float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
+
+            positions.push_back(glm::vec3(xPos, yPos, zPos));
+            uv.push_back(glm::vec2(xSegment, ySegment));
+            normals.push_back(glm::vec3(xPos, yPos, zPos));
+        }
+    }
+
+    bool oddRow = false;
+    for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+    {
+        if (!oddRow) // even rows: y == 0, y == 2; and so on
         {
             for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
             {
-                float xSegment = (float)x / (float)X_SEGMENTS;
-                float ySegment = (float)y / (float)Y_SEGMENTS;
-                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-                float yPos = std::cos(ySegment * PI);
-                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-                positions.push_back(glm::vec3(xPos, yPos, zPos));
-                uv.push_back(glm::vec2(xSegment, ySegment));
-                normals.push_back(glm::vec3(xPos, yPos, zPos));
+                indices.push_back(y * (X_SEGMENTS + 1) + x);
+                indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
             }
         }
-
-        bool oddRow = false;
-        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+        else
         {
-            if (!oddRow) // even rows: y == 0, y == 2; and so on
+            for (int x = X_SEGMENTS; x >= 0; --x)
             {
-                for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-                {
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                }
+                indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
+                indices.push_back(y * (X_SEGMENTS + 1) + x);
             }
-            else
-            {
-                for (int x = X_SEGMENTS; x >= 0; --x)
-                {
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
-                }
-            }
-            oddRow = !oddRow;
         }
-        indexCount = indices.size();
+        oddRow = !oddRow;
+    }
+    indexCount[lod] = indices.size();
 
-        std::vector<float> data;
-        for (std::size_t i = 0; i < positions.size(); ++i)
+    std::vector<float> data;
+    for (std::size_t i = 0; i < positions.size(); ++i)
+    {
+        data.push_back(positions[i].x);
+        data.push_back(positions[i].y);
+        data.push_back(positions[i].z);
+        if (normals.size() > 0)
         {
-            data.push_back(positions[i].x);
-            data.push_back(positions[i].y);
-            data.push_back(positions[i].z);
-            if (normals.size() > 0)
-            {
-                data.push_back(normals[i].x);
-                data.push_back(normals[i].y);
-                data.push_back(normals[i].z);
-            }
-            if (uv.size() > 0)
-            {
-                data.push_back(uv[i].x);
-                data.push_back(uv[i].y);
-            }
+            data.push_back(normals[i].x);
+            data.push_back(normals[i].y);
+            data.push_back(normals[i].z);
+        }
+        if (uv.size() > 0)
+        {
+            data.push_back(uv[i].x);
+            data.push_back(uv[i].y);
         }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        float stride = (3 + 2 + 3) * sizeof(float);
-        // make sure that this matches the layout in the vertex shader!
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
     }
+    glState().BindVertexArray(sphereVAO[lod]);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    float stride = (3 + 2 + 3) * sizeof(float);
+    // make sure that this matches the layout in the vertex shader!
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+}
+
+// renders (and builds at first invocation) a sphere. Level of detail lod has 64 >> lod segments.
+// -------------------------------------------------
+void renderSphere(unsigned int lod)
+{
+    lod = std::min(lod, SPHERE_LODS - 1);
+    if (sphereVAO[lod] == 0)
+        buildSphere(lod);
+
+    glState().BindVertexArray(sphereVAO[lod]);
+    glDrawElements(GL_TRIANGLE_STRIP, indexCount[lod], GL_UNSIGNED_INT, 0);
+}
+
+// renders all instances of the buffer as spheres with one draw call (builds the sphere at first invocation)
+// -------------------------------------------------
+void renderSphereInstanced(unsigned int lod, const InstanceBuffer &instances)
+{
+    lod = std::min(lod, SPHERE_LODS - 1);
+    if (sphereVAO[lod] == 0)
+        buildSphere(lod);
+
+    glState().BindVertexArray(sphereVAO[lod]);
+    instances.Attach();
+    glDrawElementsInstanced(GL_TRIANGLE_STRIP, indexCount[lod], GL_UNSIGNED_INT, 0, (GLsizei)instances.Count());
+}
+
+// the draw of a sphere for the render queue (builds it at first invocation like renderSphere)
+// -------------------------------------------------
+DrawPacket spherePacket(unsigned int lod)
+{
+    lod = std::min(lod, SPHERE_LODS - 1);
+    if (sphereVAO[lod] == 0)
+        buildSphere(lod);
+    DrawPacket packet;
+    packet.vao = sphereVAO[lod];
+    packet.mode = GL_TRIANGLE_STRIP;
+    packet.count = (GLsizei)indexCount[lod];
+    return packet;
+}
 
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+// the coarsest sphere level whose error stays below maxPixelError pixels on screen. With n segments the
+// largest distance between the polygon and the sphere is radius * (1 - cos(pi / n)).
+// -------------------------------------------------
+unsigned int sphereLod(const glm::vec3 &center, float radius, float maxPixelError)
+{
+    float distance = glm::length(center - camera.Position) - radius;
+    unsigned int lod = 0;
+    while (lod + 1 < SPHERE_LODS)
+    {
+        float error = radius * (1.0f - std::cos(3.14159265359f / (64 >> (lod + 1))));
+        if (camera.ProjectedSize(error, distance, (float)SCR_HEIGHT) > maxPixelError)
+            break;
+        lod++;
+    }
+    return lod;
 }
@@ -5,46 +5,66 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 WorldPos;
 in vec3 Normal;
+in vec4 Tangent; // w: bitangent sign, B = cross(N, T) * w
+flat in vec3 MaterialAlbedo; // from the vertex shader: the material uniforms or the instance
+flat in vec3 MaterialParams; // metallic, roughness, ao
+
+// per frame data (see FrameData in uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    float gamma;
+};
 
 // material parameters
-uniform vec3 Albedo;
-uniform float Metallic;
-uniform float Roughness;
-uniform float AO;
-uniform float gamma;
-// material parameters from Textures
-uniform float useTextures;
+layout (std140) uniform MaterialData
+{
+    vec3 Albedo;
+    float Metallic;
+    float Roughness;
+    float AO;
+    float useTextures; // material parameters from Textures
+};
 uniform sampler2D albedoMap;
 uniform sampler2D normalMap;
 uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 uniform sampler2D aoMap;
 
-// lights
-uniform vec3 lightPositions[4];
-uniform vec3 lightColors[4];
-
-// camera
-uniform vec3 camPos;
+// lights (xyz, see LightData in uniformblocks.h)
+layout (std140) uniform LightData
+{
+    vec4 lightPositions[4];
+    vec4 lightColors[4];
+};
 
 const float PI = 3.14159265359;
 // ----------------------------------------------------------------------------
-// Easy trick to get tangent-normals to world-space to keep PBR code simplified.
-// Don't worry if you don't get what's going on; you generally want to do normal 
-// mapping the usual way for performance anways; I do plan make a note of this 
-// technique somewhere later in the normal mapping tutorial.
+// Tangent space normal to world space with the tangent frame of the mesh (Tangent from the vertex shader). Meshes
+// without tangents fall back to a frame built from the screen space derivatives of position and texture coordinates.
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
-
-    vec3 Q1 = dFdx(WorldPos);
-    vec3 Q2 = dFdy(WorldPos);
-    vec2 st1 = dFdx(TexCoords);
-    vec2 st2 = dFdy(TexCoords);
+    // normal maps are BC5 compressed (only x and y are stored), z is reconstructed from the unit length
+    vec2 tangentXY = texture(normalMap, TexCoords).rg * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(tangentXY, sqrt(max(1.0 - dot(tangentXY, tangentXY), 0.0)));
 
     vec3 N = normalize(Normal);
-    vec3 T = normalize(Q1 * st2.t - Q2 * st1.t);
-    vec3 B = -normalize(cross(N, T));
+    vec3 T = Tangent.xyz - N * dot(N, Tangent.xyz); // orthogonal to N again after interpolation
+    if (dot(T, T) < 1e-8)
+    {
+        vec3 Q1 = dFdx(WorldPos);
+        vec3 Q2 = dFdy(WorldPos);
+        vec2 st1 = dFdx(TexCoords);
+        vec2 st2 = dFdy(TexCoords);
+
+        T = normalize(Q1 * st2.t - Q2 * st1.t);
+        vec3 B = -normalize(cross(N, T));
+        return normalize(mat3(T, B, N) * tangentNormal);
+    }
+    T = normalize(T);
+    vec3 B = cross(N, T) * Tangent.w;
     mat3 TBN = mat3(T, B, N);
 
     return normalize(TBN * tangentNormal);
@@ -93,10 +113,10 @@ void main()
 {
     vec3 N = normalize(Normal);
     vec3 V = normalize(camPos - WorldPos);
-    vec3 albedo = Albedo;
-    float metallic = Metallic;
-    float roughness = Roughness;
-    float ao = AO;
+    vec3 albedo = MaterialAlbedo;
+    float metallic = MaterialParams.x;
+    float roughness = MaterialParams.y;
+    float ao = MaterialParams.z;
 
     if (useTextures > 0)
     {
@@ -120,11 +140,11 @@ void main()
     for (int i = 0; i < 4; ++i)
     {
         // calculate per-light radiance
-        vec3 L = normalize(lightPositions[i] - WorldPos);
+        vec3 L = normalize(lightPositions[i].xyz - WorldPos);
         vec3 H = normalize(V + L);
-        float distance = length(lightPositions[i] - WorldPos);
+        float distance = length(lightPositions[i].xyz - WorldPos);
         float attenuation = 1.0 / (distance * distance);
-        vec3 radiance = lightColors[i] * attenuation;
+        vec3 radiance = lightColors[i].rgb * attenuation;
 
         // Cook-Torrance BRDF
         float NDF = DistributionGGX(N, H, roughness);
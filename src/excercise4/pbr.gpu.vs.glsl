@@ -0,0 +1,64 @@
+#version 430 core
+layout (location = 0) in vec3 aPos; // the arena has the full vertex layout (see MeshArena)
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+layout (location = 11) in uint aObject; // index of the object, the baseInstance of the draw (see GpuScene)
+
+out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+out vec4 Tangent; // w: bitangent sign, B = cross(N, T) * w
+flat out vec3 MaterialAlbedo;
+flat out vec3 MaterialParams; // metallic, roughness, ao
+
+// shared with the other programs, bound by Shader (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    float gamma;
+};
+// material parameters (see MaterialData in uniformblocks.h)
+layout (std140) uniform MaterialData
+{
+    vec3 Albedo;
+    float Metallic;
+    float Roughness;
+    float AO;
+    float useTextures;
+};
+
+// the objects of the scene (see GpuObject in gpuscene.h)
+struct Object
+{
+    mat4 model;
+    vec4 boundsCenter;
+    vec4 boundsExtent;
+    uint count;
+    uint firstIndex;
+    int baseVertex;
+    uint material;
+};
+layout (std430, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+void main()
+{
+    mat4 model = objects[aObject].model;
+    TexCoords = aTexCoords;
+    WorldPos = vec3(model * vec4(aPos, 1.0));
+
+    mat4 normalMatrix = transpose(inverse(model));
+    Normal = mat3(normalMatrix) * aNormal;
+    Tangent = vec4(mat3(model) * aTangent, dot(cross(aNormal, aTangent), aBitangent) < 0.0 ? -1.0 : 1.0);
+
+    MaterialAlbedo = Albedo;
+    MaterialParams = vec3(Metallic, Roughness, AO);
+
+    gl_Position =  projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,68 @@
+#version 460 core
+layout (location = 0) in vec4 aPos;     // compact: unorm position in the mesh AABB, w = bitangent sign
+layout (location = 1) in vec3 aNormal;  // compact: octahedral encoded (xy)
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent; // compact: octahedral encoded (xy)
+layout (location = 4) in vec3 aBitangent; // full layout only, compact stores its sign in aPos.w
+// per instance (see InstanceData in instancing.h)
+layout (location = 5) in mat4 aInstanceModel; // placement of the instance, applied after model
+layout (location = 9) in vec4 aInstanceColor; // albedo
+layout (location = 10) in vec4 aInstanceMaterial; // metallic, roughness, ao
+
+out vec2 TexCoords;
+out vec3 WorldPos;
+out vec3 Normal;
+out vec4 Tangent; // w: bitangent sign, B = cross(N, T) * w
+flat out vec3 MaterialAlbedo;
+flat out vec3 MaterialParams; // metallic, roughness, ao
+
+// shared with the other programs, bound by Shader (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    float gamma;
+};
+uniform mat4 model; // the same for all instances
+
+// compact vertex layout (see CompactVertex in mesh.h)
+uniform bool compactVertices;
+uniform vec3 posMin;
+uniform vec3 posExtent;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 pos = aPos.xyz;
+    vec3 normal = aNormal;
+    vec3 tangent = aTangent;
+    float bitangentSign = dot(cross(aNormal, aTangent), aBitangent) < 0.0 ? -1.0 : 1.0;
+    if (compactVertices)
+    {
+        pos = posMin + aPos.xyz * posExtent;
+        normal = octDecode(aNormal.xy);
+        tangent = octDecode(aTangent.xy);
+        bitangentSign = aPos.w * 2.0 - 1.0;
+    }
+
+    mat4 instanceModel = aInstanceModel * model;
+    TexCoords = aTexCoords;
+    WorldPos = vec3(instanceModel * vec4(pos, 1.0));
+
+    mat4 normalMatrix = transpose(inverse(instanceModel));
+    Normal = mat3(normalMatrix) * normal;
+    Tangent = vec4(mat3(instanceModel) * tangent, bitangentSign);
+
+    MaterialAlbedo = aInstanceColor.rgb;
+    MaterialParams = aInstanceMaterial.xyz;
+
+    gl_Position =  projection * view * vec4(WorldPos, 1.0);
+}
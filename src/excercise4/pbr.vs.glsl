@@ -1,23 +1,72 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;     // compact: unorm position in the mesh AABB, w = bitangent sign
+layout (location = 1) in vec3 aNormal;  // compact: octahedral encoded (xy)
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent; // compact: octahedral encoded (xy)
+layout (location = 4) in vec3 aBitangent; // full layout only, compact stores its sign in aPos.w
 
 out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
+out vec4 Tangent; // w: bitangent sign, B = cross(N, T) * w
+flat out vec3 MaterialAlbedo;
+flat out vec3 MaterialParams; // metallic, roughness, ao
 
-uniform mat4 projection;
-uniform mat4 view;
+// shared with the other programs, bound by Shader (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+    float gamma;
+};
+// material parameters (see MaterialData in uniformblocks.h), the instanced variant takes them per instance
+layout (std140) uniform MaterialData
+{
+    vec3 Albedo;
+    float Metallic;
+    float Roughness;
+    float AO;
+    float useTextures;
+};
 uniform mat4 model;
 
+// compact vertex layout (see CompactVertex in mesh.h)
+uniform bool compactVertices;
+uniform vec3 posMin;
+uniform vec3 posExtent;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main()
 {
+    vec3 pos = aPos.xyz;
+    vec3 normal = aNormal;
+    vec3 tangent = aTangent;
+    float bitangentSign = dot(cross(aNormal, aTangent), aBitangent) < 0.0 ? -1.0 : 1.0;
+    if (compactVertices)
+    {
+        pos = posMin + aPos.xyz * posExtent;
+        normal = octDecode(aNormal.xy);
+        tangent = octDecode(aTangent.xy);
+        bitangentSign = aPos.w * 2.0 - 1.0;
+    }
+
     TexCoords = aTexCoords;
-    WorldPos = vec3(model * vec4(aPos, 1.0));
+    WorldPos = vec3(model * vec4(pos, 1.0));
 
     mat4 normalMatrix = transpose(inverse(model)); // better do this on the CPU only once!
-    Normal = mat3(normalMatrix) * aNormal;
+    Normal = mat3(normalMatrix) * normal;
+    Tangent = vec4(mat3(model) * tangent, bitangentSign);
+
+    MaterialAlbedo = Albedo;
+    MaterialParams = vec3(Metallic, Roughness, AO);
 
     gl_Position =  projection * view * vec4(WorldPos, 1.0);
-}
\ No newline at end of file
+}
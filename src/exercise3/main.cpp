@@ -7,6 +7,7 @@
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+#include <util/glstate.h>
 #include <vector>
 
 // Callback prototypes
@@ -440,20 +441,20 @@ void initOpenGL() {
 
 
 void renderIsland(glm::mat4 view, glm::mat4 projection) {
-    glUseProgram(shaderProgram);
+    glState().UseProgram(shaderProgram);
     glm::mat4 model = glm::mat4(1.0f); // Identity matrix
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-    glBindVertexArray(islandVAO);
+    glState().BindVertexArray(islandVAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
 // Function to render trees
 void renderTree(glm::mat4 view, glm::mat4 projection, glm::vec3 position) {
-    glUseProgram(shaderProgram);
-    glBindVertexArray(treeVAO);
+    glState().UseProgram(shaderProgram);
+    glState().BindVertexArray(treeVAO);
 
     // Scaling factor for leaves
     glm::vec3 leavesScaleFactor(0.75f, 0.75f, 0.75f);
@@ -480,13 +481,13 @@ void renderTree(glm::mat4 view, glm::mat4 projection, glm::vec3 position) {
 }
 
 void renderClouds(glm::mat4 view, glm::mat4 projection) {
-    glUseProgram(shaderProgram);
+    glState().UseProgram(shaderProgram);
     glm::mat4 model = glm::mat4(1.0f);
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-    glBindVertexArray(cloudVAO);
+    glState().BindVertexArray(cloudVAO);
     glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
 }
 
@@ -569,10 +570,11 @@ int main() {
 
         // Render to framebuffer
         if (useFramebuffer1) {
-            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer1);
+            glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer1);
         } else {
-            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2);
+            glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer2);
         }
+        glState().Enable(GL_DEPTH_TEST); // the post passes below turn it off
         glClearColor(0.5f, 0.7f, 1.0f, 1.0f); // Light blue sky
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -586,69 +588,65 @@ int main() {
         renderTree(view, projection, glm::vec3(0.4f, -0.1f, 0.0f));  // Second tree
         renderClouds(view, projection);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // Apply post-processing effects
+        // Apply post-processing effects (all full screen quads without depth test, repeated state is skipped)
         if (showMotionBlur) {
-            glUseProgram(motionBlurShaderProgram);
-            glBindVertexArray(quadVAO);
-            glDisable(GL_DEPTH_TEST);
+            glState().UseProgram(motionBlurShaderProgram);
+            glState().BindVertexArray(quadVAO);
+            glState().Disable(GL_DEPTH_TEST);
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
             glUniform1i(glGetUniformLocation(motionBlurShaderProgram, "currentFrame"), 0);
 
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer2 : textureColorbuffer1);
+            glState().ActiveTexture(GL_TEXTURE1);
+            glState().BindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer2 : textureColorbuffer1);
             glUniform1i(glGetUniformLocation(motionBlurShaderProgram, "previousFrame"), 1);
 
             glDrawArrays(GL_TRIANGLES, 0, 6);
-            glEnable(GL_DEPTH_TEST);
         }
 
         if (showColorCorrection) {
-            glUseProgram(colorCorrectionShaderProgram);
-            glBindVertexArray(quadVAO);
-            glDisable(GL_DEPTH_TEST);
+            glState().UseProgram(colorCorrectionShaderProgram);
+            glState().BindVertexArray(quadVAO);
+            glState().Disable(GL_DEPTH_TEST);
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
             glUniform1i(glGetUniformLocation(colorCorrectionShaderProgram, "screenTexture"), 0);
             glUniform3fv(glGetUniformLocation(colorCorrectionShaderProgram, "colorAdjust"), 1, colorAdjust);
 
             glDrawArrays(GL_TRIANGLES, 0, 6);
-            glEnable(GL_DEPTH_TEST);
         }
 
         if (showVignetting) {
-            glUseProgram(vignettingShaderProgram);
-            glBindVertexArray(quadVAO);
-            glDisable(GL_DEPTH_TEST);
+            glState().UseProgram(vignettingShaderProgram);
+            glState().BindVertexArray(quadVAO);
+            glState().Disable(GL_DEPTH_TEST);
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
             glUniform1i(glGetUniformLocation(vignettingShaderProgram, "screenTexture"), 0);
 
             glDrawArrays(GL_TRIANGLES, 0, 6);
-            glEnable(GL_DEPTH_TEST);
         }
 
                 if (showFilmGrain) {
-            glUseProgram(filmGrainShaderProgram);
-            glBindVertexArray(quadVAO);
-            glDisable(GL_DEPTH_TEST);
+            glState().UseProgram(filmGrainShaderProgram);
+            glState().BindVertexArray(quadVAO);
+            glState().Disable(GL_DEPTH_TEST);
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, useFramebuffer1 ? textureColorbuffer1 : textureColorbuffer2);
             glUniform1i(glGetUniformLocation(filmGrainShaderProgram, "screenTexture"), 0);
 
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, noiseTexture); // Assuming noiseTexture is already created
+            glState().ActiveTexture(GL_TEXTURE1);
+            glState().BindTexture(GL_TEXTURE_2D, noiseTexture); // Assuming noiseTexture is already created
             glUniform1i(glGetUniformLocation(filmGrainShaderProgram, "noiseTexture"), 1);
             glUniform1f(glGetUniformLocation(filmGrainShaderProgram, "grainAmount"), grainAmount);
 
             glDrawArrays(GL_TRIANGLES, 0, 6);
-            glEnable(GL_DEPTH_TEST);
         }
 
         // Start the ImGui frame
@@ -665,6 +663,7 @@ int main() {
         ImGui::Checkbox("Vignetting", &showVignetting);
         ImGui::Checkbox("Film Grain", &showFilmGrain);
         ImGui::SliderFloat("Grain Amount", &grainAmount, 0.0f, 1.0f);
+        ImGui::Text("GL state calls: %d issued, %d skipped", (int)glState().IssuedLastFrame(), (int)glState().SkippedLastFrame());
         ImGui::End();
 
         // Render ImGui
@@ -672,6 +671,7 @@ int main() {
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         // Swap buffers and poll events
+        glState().EndFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
 
@@ -63,15 +63,11 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-
-    // configure global opengl state
-    // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().Enable(GL_DEPTH_TEST);
     // set depth function to less than AND equal for skybox depth trick.
     glDepthFunc(GL_LEQUAL);
     // enable seamless cubemap sampling for lower mip levels in the pre-filter map.
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glState().Enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     // build and compile shaders
     // -------------------------
@@ -112,18 +108,22 @@ int main()
                 ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
                 ImGui::SliderInt("ray depth", &maxDepth, 1, 10); // Edit 1 float using a slider from 0.0f to 1.0f
                 ImGui::Checkbox("animate light", &animateLight);
+                ImGui::Text("GL state calls: %d issued, %d skipped", (int)glState().IssuedLastFrame(), (int)glState().SkippedLastFrame());
 
                 // a Button to reload the shader (so you don't need to recompile the cpp all the time)
                 if (ImGui::Button("reload shaders"))
-                {
                     shader.reload();
-                    shader.use();
-                }
+                if (shader.isReloading())
+                    ImGui::Text("compiling shaders ...");
 
                 ImGui::End();
             }
         }
 
+        // swap in the reloaded shader (saved .glsl files are picked up automatically) once the driver linked it
+        if (shader.update())
+            shader.use();
+
         // render
         // ------
         if (gui)
@@ -136,8 +136,8 @@ int main()
 
         // configure global opengl state
         // -----------------------------
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        glState().Enable(GL_DEPTH_TEST);
+        glState().Disable(GL_BLEND);
 
         // render scene, supplying the convoluted irradiance map to the final shader.
         // ------------------------------------------------------------------------------------------
@@ -167,6 +167,7 @@ int main()
         // -------------------------------------------------------------------------------
         if (gui)
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        glState().EndFrame();
         glfwSwapBuffers(window);
     }
 
@@ -293,7 +294,7 @@ void renderQuad()
         // setup plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
+        glState().BindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -301,7 +302,6 @@ void renderQuad()
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    glState().BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
@@ -0,0 +1,116 @@
+// Load time benchmark for the model loaders, runs without a window (meshes are not uploaded, no textures).
+// Usage: loadbench [model path] [assimp|fast]. Without arguments the helmet is loaded as .obj, .gltf and .glb,
+// and every .obj under ../resources with Assimp and with the parallel OBJ parser (objparser.h). Each load
+// runs in its own process, so that the peak resident set size of one loader does not hide the other.
+// .hdr environments are decoded with stbi_loadf (stb) and with hdrimage.h (fast), the CPU side only.
+#include <util/assets.h>
+#include <util/procstats.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int runBenchmark(const std::string &path, bool fastObj)
+{
+    meshCacheEnabled = false; // always measure the import itself
+    size_t residentBefore = peakResidentBytes();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Model model(path, false, false, true, fastObj ? MESH_PROCESS_FAST_OBJ : 0);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    if (model.meshes.empty())
+    {
+        std::cout << path << ": failed to load" << std::endl;
+        return 1;
+    }
+
+    size_t vertexCount = 0, indexCount = 0;
+    for (auto &mesh : model.meshes)
+    {
+        vertexCount += mesh.vertices.size();
+        indexCount += mesh.indices.size();
+    }
+    const char *loader = isGltfFile(path) ? "gltf.h" : fastObj ? "objparser.h" : "Assimp";
+    std::cout << path << " (" << loader << "): " << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms, "
+              << vertexCount << " vertices, " << indexCount << " indices, peak RSS "
+              << peakResidentBytes() / (1024.0 * 1024.0) << " MB (" << residentBefore / (1024.0 * 1024.0)
+              << " MB before loading)" << std::endl;
+    return 0;
+}
+
+int runHdrBenchmark(const std::string &path, bool fast)
+{
+    size_t residentBefore = peakResidentBytes();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    int width = 0, height = 0, components = 0;
+    size_t bytes = 0;
+    if (fast)
+    {
+        HdrImage image = decodeHdrImage(path, true);
+        width = image.width;
+        height = image.height;
+        bytes = image.isValid() ? image.pixels.size() * sizeof(uint16_t) : 0;
+    }
+    else
+    {
+        stbi_set_flip_vertically_on_load_thread(true);
+        float *data = stbi_loadf(path.c_str(), &width, &height, &components, 0);
+        bytes = data ? (size_t)width * height * components * sizeof(float) : 0;
+        stbi_image_free(data);
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    if (bytes == 0)
+    {
+        std::cout << path << ": failed to load" << std::endl;
+        return 1;
+    }
+
+    std::cout << path << " (" << (fast ? "hdrimage.h, RGB16F" : "stbi_loadf, RGB32F") << "): "
+              << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms, " << width << "x" << height << ", "
+              << bytes / (1024.0 * 1024.0) << " MB of pixels, peak RSS " << peakResidentBytes() / (1024.0 * 1024.0)
+              << " MB (" << residentBefore / (1024.0 * 1024.0) << " MB before loading)" << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && isHdrFile(argv[1]))
+        return runHdrBenchmark(argv[1], argc > 2 && std::strcmp(argv[2], "fast") == 0);
+    if (argc > 1)
+        return runBenchmark(argv[1], argc > 2 && std::strcmp(argv[2], "fast") == 0);
+
+    std::vector<std::string> runs = {"\"../resources/objects/helmet/DamagedHelmet.gltf\"",
+                                     "\"../resources/objects/helmet/DamagedHelmet.glb\""};
+    std::error_code error;
+    for (auto &entry : std::filesystem::recursive_directory_iterator("../resources", error))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        std::string path = "\"" + entry.path().generic_string() + "\"";
+        if (isObjFile(entry.path().string()))
+        {
+            runs.push_back(path + " assimp");
+            runs.push_back(path + " fast");
+        }
+        else if (isHdrFile(entry.path().string()))
+        {
+            runs.push_back(path + " stb");
+            runs.push_back(path + " fast");
+        }
+    }
+
+    int result = 0;
+    for (auto &run : runs)
+    {
+        std::string command = std::string("\"") + argv[0] + "\" " + run;
+#ifdef _WIN32
+        // cmd /c strips the first and the last quote of a command with more than two, quote the whole command once more
+        command = "\"" + command + "\"";
+#endif
+        result |= std::system(command.c_str());
+    }
+    return result != 0;
+}